@@ -1,19 +1,21 @@
-if(NOT ${CMAKE_ARGC} EQUAL 6)
-    message(FATAL_ERROR "usage: cmake -P embed.cmake <target> <template.c.in> <generated.c>")
+if(NOT ${CMAKE_ARGC} EQUAL 7)
+    message(FATAL_ERROR "usage: cmake -P embed.cmake <prefix> <file> <template.c.in> <generated.c>")
 endif()
 
-set(shader "${CMAKE_ARGV3}")
-set(shader-template "${CMAKE_ARGV4}")
-set(shader-source "${CMAKE_ARGV5}")
+set(embed-prefix "${CMAKE_ARGV3}")
+set(embed-file "${CMAKE_ARGV4}")
+set(embed-template "${CMAKE_ARGV5}")
+set(embed-source "${CMAKE_ARGV6}")
 
-get_filename_component(shader-base "${shader}" NAME_WE)
+get_filename_component(embed-base "${embed-file}" NAME_WE)
 
-file(READ ${shader} shader-data HEX)
+file(READ ${embed-file} embed-data HEX)
 string(REPEAT "[0-9a-f]" 2 byte-regex)
 string(REPEAT "[0-9a-f]" 16 line-regex)
-string(REGEX REPLACE "(${line-regex})" "\\1\n    " shader-data "${shader-data}")
-string(REGEX REPLACE "(${byte-regex})" "0x\\1, " shader-data "${shader-data}")
+string(REGEX REPLACE "(${line-regex})" "\\1\n    " embed-data "${embed-data}")
+string(REGEX REPLACE "(${byte-regex})" "0x\\1, " embed-data "${embed-data}")
 
-set(FILENAME "${shader-base}")
-set(DATA "${shader-data}")
-configure_file("${shader-template}" "${shader-source}" @ONLY)
+set(PREFIX "${embed-prefix}")
+set(FILENAME "${embed-base}")
+set(DATA "${embed-data}")
+configure_file("${embed-template}" "${embed-source}" @ONLY)
@@ -0,0 +1,13 @@
+#version 100
+precision mediump float;
+
+uniform sampler2D uTexture;
+uniform vec4 uColor;
+uniform bool uTextured;
+varying vec2 vTexCoord;
+
+void main() {
+    // glyphs are stored as coverage in the red channel
+    float coverage = uTextured ? texture2D(uTexture, vTexCoord).r : 1.0;
+    gl_FragColor = vec4(uColor.rgb, uColor.a * coverage);
+}
@@ -0,0 +1,14 @@
+#version 100
+precision mediump float;
+
+uniform vec2 uScreenSize;
+attribute vec2 aPosition;
+attribute vec2 aTexCoord;
+varying vec2 vTexCoord;
+
+void main() {
+    // positions are in pixels from the top left corner of the window
+    vec2 position = aPosition / uScreenSize * 2.0 - 1.0;
+    gl_Position = vec4(position.x, -position.y, 0.0, 1.0);
+    vTexCoord = aTexCoord;
+}
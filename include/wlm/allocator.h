@@ -0,0 +1,39 @@
+#ifndef WL_MIRROR_ALLOCATOR_H_
+#define WL_MIRROR_ALLOCATOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <wayland-client-protocol.h>
+#include <wlm/egl.h>
+
+#ifdef WITH_GBM
+#include <gbm.h>
+#endif
+
+struct ctx;
+
+#ifndef DRM_FORMAT_MOD_LINEAR
+#define DRM_FORMAT_MOD_LINEAR 0
+#endif
+
+typedef struct ctx_allocator {
+    int drm_fd;
+#ifdef WITH_GBM
+    struct gbm_device * gbm_device;
+#endif
+    int udmabuf_fd;
+
+    // state flags
+    bool available;
+    bool initialized;
+} ctx_allocator_t;
+
+void wlm_allocator_init(struct ctx * ctx);
+
+bool wlm_allocator_dmabuf_create(struct ctx * ctx, dmabuf_t * dmabuf, uint32_t width, uint32_t height, uint32_t drm_format);
+struct wl_buffer * wlm_allocator_dmabuf_to_wl_buffer(struct ctx * ctx, dmabuf_t * dmabuf);
+void wlm_allocator_dmabuf_destroy(dmabuf_t * dmabuf);
+
+void wlm_allocator_cleanup(struct ctx * ctx);
+
+#endif
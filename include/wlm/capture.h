@@ -0,0 +1,63 @@
+#ifndef WL_MIRROR_CAPTURE_H_
+#define WL_MIRROR_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <wayland-client-core.h>
+#include <wlm/event.h>
+#include <wlm/mirror-backends.h>
+
+struct ctx;
+
+// notifications from the capture thread to the main thread
+#define CAPTURE_NOTIFY_EVENTS (1 << 0)
+#define CAPTURE_NOTIFY_FRAME_READY (1 << 1)
+#define CAPTURE_NOTIFY_BACKEND_FAIL (1 << 2)
+#define CAPTURE_NOTIFY_DISPLAY_ERROR (1 << 3)
+
+// single-slot mailbox holding the latest completed frame
+// - the producer replaces the slot and gets back the frame nobody took
+// - the consumer takes the slot and leaves it empty
+typedef struct {
+    _Atomic(void *) latest;
+} frame_mailbox_t;
+
+typedef struct ctx_capture {
+    struct wl_event_queue * queue;
+    pthread_t thread;
+    int wake_fd;
+    event_handler_t notify_handler;
+
+    // shared with the capture thread
+    // - request_params is written with the request and copied before the capture
+    pthread_mutex_t request_lock;
+    mirror_capture_params_t request_params;
+    atomic_bool capture_requested;
+    atomic_bool stopping;
+    atomic_uint notifications;
+
+    // state flags
+    bool running;
+    bool initialized;
+} ctx_capture_t;
+
+void wlm_capture_init(struct ctx * ctx);
+
+void * wlm_capture_wrap_proxy(struct ctx * ctx, void * proxy);
+void wlm_capture_unwrap_proxy(void * wrapper, void * proxy);
+
+void wlm_capture_start(struct ctx * ctx);
+void wlm_capture_stop(struct ctx * ctx);
+bool wlm_capture_running(struct ctx * ctx);
+bool wlm_capture_on_thread(struct ctx * ctx);
+void wlm_capture_request(struct ctx * ctx, const mirror_capture_params_t * params);
+void wlm_capture_notify(struct ctx * ctx, unsigned int notification);
+
+void wlm_capture_mailbox_init(frame_mailbox_t * mailbox);
+void * wlm_capture_mailbox_put(frame_mailbox_t * mailbox, void * frame);
+void * wlm_capture_mailbox_take(frame_mailbox_t * mailbox);
+
+void wlm_capture_cleanup(struct ctx * ctx);
+
+#endif
@@ -11,14 +11,28 @@
 #include <wlm/stream.h>
 #include <wlm/wayland.h>
 #include <wlm/egl.h>
+#include <wlm/hud.h>
+#include <wlm/allocator.h>
+#include <wlm/capture.h>
+#include <wlm/import.h>
 #include <wlm/mirror.h>
+#include <wlm/stats.h>
+#include <wlm/trace.h>
+#include <wlm/perf.h>
 
 typedef struct ctx {
     ctx_opt_t opt;
     ctx_event_t event;
+    ctx_stats_t stats;
+    ctx_trace_t trace;
+    ctx_perf_t perf;
     ctx_stream_t stream;
     ctx_wl_t wl;
     ctx_egl_t egl;
+    ctx_hud_t hud;
+    ctx_allocator_t allocator;
+    ctx_capture_t capture;
+    ctx_import_t import;
     ctx_mirror_t mirror;
 } ctx_t;
 
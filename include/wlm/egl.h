@@ -3,10 +3,13 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <sys/types.h>
 #include <wayland-egl.h>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <wlm/transform.h>
 
 struct ctx;
 
@@ -17,12 +20,54 @@ typedef struct {
     uint32_t drm_format;
     size_t planes;
 
-    int * fds;
-    uint32_t * offsets;
-    uint32_t * strides;
+    int fds[MAX_PLANES];
+    uint32_t offsets[MAX_PLANES];
+    uint32_t strides[MAX_PLANES];
     uint64_t modifier;
 } dmabuf_t;
 
+// compositors cycle through a small swapchain, so few entries cover all buffers
+#define DMABUF_CACHE_SIZE 8
+typedef struct {
+    // buffer identity
+    dev_t devs[MAX_PLANES];
+    ino_t inodes[MAX_PLANES];
+    uint32_t offsets[MAX_PLANES];
+    uint32_t strides[MAX_PLANES];
+    size_t planes;
+    uint32_t width;
+    uint32_t height;
+    uint32_t drm_format;
+    uint64_t modifier;
+
+    // imported objects
+    EGLImage image;
+    GLuint texture;
+
+    // cache state
+    uint64_t last_used;
+    bool valid;
+} dmabuf_cache_entry_t;
+
+// one buffer being filled by us, the others still being read by the driver
+#define UPLOAD_PBO_COUNT 3
+
+// GPU work measured with timer queries
+typedef enum {
+    GPU_TIMER_IMPORT, // first draw sampling a newly imported dmabuf
+    GPU_TIMER_UPLOAD,
+    GPU_TIMER_DRAW,
+    GPU_TIMER_COUNT
+} gpu_timer_t;
+
+// queries in flight per timer, results are read back a few frames later
+#define GPU_TIMER_QUERIES 8
+typedef struct {
+    GLuint queries[GPU_TIMER_QUERIES];
+    uint64_t issued;
+    uint64_t collected;
+} gpu_timer_queries_t;
+
 typedef struct ctx_egl {
     EGLDisplay display;
     EGLContext context;
@@ -33,6 +78,25 @@ typedef struct ctx_egl {
     // extension functions
     PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 
+    // fence sync functions
+    PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+    PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+    PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+    PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
+
+    // timer query functions
+    PFNGLGENQUERIESEXTPROC glGenQueriesEXT;
+    PFNGLDELETEQUERIESEXTPROC glDeleteQueriesEXT;
+    PFNGLBEGINQUERYEXTPROC glBeginQueryEXT;
+    PFNGLENDQUERYEXTPROC glEndQueryEXT;
+    PFNGLGETQUERYOBJECTIVEXTPROC glGetQueryObjectivEXT;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC glGetQueryObjectui64vEXT;
+
+    // OpenGL ES 3.0 functions
+    PFNGLTEXSTORAGE2DEXTPROC glTexStorage2D;
+    PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRange;
+    PFNGLUNMAPBUFFEROESPROC glUnmapBuffer;
+
     // texture size
     uint32_t width;
     uint32_t height;
@@ -41,15 +105,47 @@ typedef struct ctx_egl {
     // gl objects
     GLuint vbo;
     GLuint texture;
+    GLuint current_texture;
     GLuint freeze_texture;
     GLuint freeze_framebuffer;
     GLuint shader_program;
     GLint texture_transform_uniform;
     GLint invert_colors_uniform;
 
+    // shm upload state
+    GLuint upload_pbos[UPLOAD_PBO_COUNT];
+    size_t upload_pbo_sizes[UPLOAD_PBO_COUNT];
+    size_t upload_pbo_index;
+    uint32_t storage_width;
+    uint32_t storage_height;
+    GLenum storage_format;
+    // internal format the driver refused for immutable storage, uploaded with ES2 instead
+    GLenum storage_rejected_format;
+
+    // fence signaled once the GPU finished the last presented frame
+    EGLSyncKHR draw_fence;
+
+    // GPU timer queries
+    // - only one timer query can be active at a time
+    gpu_timer_queries_t gpu_timers[GPU_TIMER_COUNT];
+    gpu_timer_t gpu_timer_current;
+    bool gpu_timer_active;
+    // newly imported texture was not drawn yet
+    bool import_draw_pending;
+
+    // imported dmabuf cache
+    dmabuf_cache_entry_t dmabuf_cache[DMABUF_CACHE_SIZE];
+    uint64_t dmabuf_cache_clock;
+
     // state flags
+    bool gles3;
+    bool fence_sync;
+    bool native_fence_sync;
+    bool timer_query;
+    bool texture_immutable;
     bool texture_region_aware;
     bool texture_initialized;
+    bool dirty;
     bool initialized;
 } ctx_egl_t;
 
@@ -60,7 +156,23 @@ void wlm_egl_resize_viewport(struct ctx * ctx);
 void wlm_egl_resize_window(struct ctx * ctx);
 void wlm_egl_update_uniforms(struct ctx * ctx);
 void wlm_egl_freeze_framebuffer(struct ctx * ctx);
+bool wlm_egl_has_egl_extension(struct ctx * ctx, const char * extension);
+void wlm_egl_fence_draw(struct ctx * ctx);
+bool wlm_egl_draw_pending(struct ctx * ctx);
+int wlm_egl_draw_fence_fd(struct ctx * ctx);
+void wlm_egl_gpu_timer_begin(struct ctx * ctx, gpu_timer_t timer);
+void wlm_egl_gpu_timer_end(struct ctx * ctx, gpu_timer_t timer);
+void wlm_egl_gpu_timer_collect(struct ctx * ctx);
 bool wlm_egl_dmabuf_to_texture(struct ctx * ctx, dmabuf_t * dmabuf);
+EGLImage wlm_egl_dmabuf_create_image(struct ctx * ctx, dmabuf_t * dmabuf);
+bool wlm_egl_dmabuf_cache_key(dmabuf_t * dmabuf, dmabuf_cache_entry_t * key);
+bool wlm_egl_dmabuf_cache_key_equal(const dmabuf_cache_entry_t * entry, const dmabuf_cache_entry_t * key);
+void wlm_egl_use_imported_texture(struct ctx * ctx, GLuint texture, uint32_t drm_format, bool new_image);
+uint32_t wlm_egl_shm_format_bpp(uint32_t shm_format);
+bool wlm_egl_shm_to_texture(struct ctx * ctx,
+    const uint8_t * data, uint32_t width, uint32_t height, uint32_t stride, uint32_t shm_format,
+    const region_t * rects, size_t rect_count
+);
 
 void wlm_egl_cleanup(struct ctx * ctx);
 
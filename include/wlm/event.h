@@ -2,24 +2,58 @@
 #define WL_MIRROR_EVENT_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <sys/epoll.h>
 
 struct ctx;
 
+// handlers ready at the same time are called in priority order
+typedef enum {
+    EVENT_PRIORITY_CONTROL,
+    EVENT_PRIORITY_WAYLAND,
+    EVENT_PRIORITY_RENDER
+} event_priority_t;
+
 typedef struct event_handler {
     struct event_handler * next;
     int fd;
     int events;
-    int timeout_ms;
+    event_priority_t priority;
     void (*on_event)(struct ctx * ctx);
     void (*on_each)(struct ctx * ctx);
+
+    // state flags
+    bool registered;
 } event_handler_t;
 
+// timers fire at an absolute CLOCK_MONOTONIC deadline
+typedef struct event_timer {
+    uint64_t deadline_ns;
+    event_priority_t priority;
+    void (*on_timer)(struct ctx * ctx);
+
+    // position in the timer heap while armed
+    size_t heap_index;
+    bool armed;
+
+    // expired and waiting to be called in the current event loop iteration
+    // - cleared when the timer is rearmed or disarmed before it is called
+    bool pending;
+} event_timer_t;
+
+#define EVENT_MAX_TIMERS 16
+
 typedef struct ctx_event {
     int pollfd;
     event_handler_t * handlers;
 
+    // timer heap ordered by deadline
+    // - the timerfd is armed to the earliest deadline
+    event_handler_t timer_handler;
+    event_timer_t * timers[EVENT_MAX_TIMERS];
+    size_t timers_len;
+
     bool initialized;
 } ctx_event_t;
 
@@ -29,6 +63,12 @@ void wlm_event_cleanup(struct ctx * ctx);
 void wlm_event_add_fd(struct ctx * ctx, event_handler_t * handler);
 void wlm_event_change_fd(struct ctx * ctx, event_handler_t * handler);
 void wlm_event_remove_fd(struct ctx * ctx, event_handler_t * handler);
+
+void wlm_event_timer_init(event_timer_t * timer, event_priority_t priority, void (*on_timer)(struct ctx * ctx));
+void wlm_event_timer_arm(struct ctx * ctx, event_timer_t * timer, uint64_t deadline_ns);
+void wlm_event_timer_disarm(struct ctx * ctx, event_timer_t * timer);
+uint64_t wlm_event_now_ns(void);
+
 void wlm_event_loop(struct ctx * ctx);
 
 #endif
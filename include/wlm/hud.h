@@ -0,0 +1,66 @@
+#ifndef WL_MIRROR_HUD_H_
+#define WL_MIRROR_HUD_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <GLES2/gl2.h>
+#include <wlm/event.h>
+
+struct ctx;
+
+// frame times shown in the graph, one bar each
+#define HUD_GRAPH_SAMPLES 120
+
+// longest text shown in the HUD
+#define HUD_TEXT_LENGTH 160
+
+// interval between text updates
+#define HUD_UPDATE_INTERVAL_NS 500000000ULL
+
+typedef struct ctx_hud {
+    // font glyph layout
+    // - glyphs are placed next to each other in a single row of the atlas
+    int16_t glyph_index[128];
+    uint32_t glyph_count;
+    uint32_t glyph_width;
+    uint32_t glyph_height;
+
+    // gl objects
+    GLuint shader_program;
+    GLuint font_texture;
+    GLuint text_vbo;
+    GLuint graph_vbo;
+    GLint screen_size_uniform;
+    GLint color_uniform;
+    GLint textured_uniform;
+    size_t text_vertices;
+    uint32_t text_columns;
+    uint32_t text_lines;
+
+    // frame time graph
+    float frame_times_ms[HUD_GRAPH_SAMPLES];
+    size_t graph_next;
+    uint64_t last_draw_ns;
+
+    // counters at the last text update
+    event_timer_t update_timer;
+    uint64_t update_ns;
+    uint64_t draws;
+    uint64_t update_draws;
+    uint64_t update_uploads;
+    uint64_t update_latency_count;
+
+    // state flags
+    bool available;
+    bool initialized;
+} ctx_hud_t;
+
+void wlm_hud_init(struct ctx * ctx);
+
+void wlm_hud_update(struct ctx * ctx);
+void wlm_hud_draw(struct ctx * ctx);
+
+void wlm_hud_cleanup(struct ctx * ctx);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef WL_MIRROR_IMPORT_H_
+#define WL_MIRROR_IMPORT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <wlm/event.h>
+#include <wlm/egl.h>
+#include <wlm/capture.h>
+
+struct ctx;
+
+// notifications from the import thread to the main thread
+#define IMPORT_NOTIFY_READY (1 << 0)
+#define IMPORT_NOTIFY_FAILED (1 << 1)
+
+// one texture being imported, one waiting in the mailbox, one picked up but
+// waiting for its import fence, and one being drawn
+// - a texture replaced on screen is free right away, the import thread waits
+//   for the fence of its last draw before importing into it again
+#define IMPORT_TEXTURE_COUNT 4
+
+typedef struct {
+    GLuint texture;
+
+    // signaled once the import finished, waited for by the main thread
+    EGLSyncKHR fence;
+    // signaled once the last draw reading the texture finished, waited for
+    // by the import thread before the texture is reused
+    EGLSyncKHR draw_fence;
+
+    // frame data
+    uint32_t width;
+    uint32_t height;
+    uint32_t drm_format;
+    uint32_t buffer_flags;
+    // image was created for this import instead of taken from the image cache
+    bool new_image;
+    uint64_t timestamp_ns;
+
+    // held from the import until the main thread retires the texture
+    atomic_bool in_use;
+} import_texture_t;
+
+typedef struct ctx_import {
+    EGLContext context;
+    pthread_t thread;
+
+    // extension functions
+    PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+    PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+    PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+    PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
+
+    // pending import job, protected by lock
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    dmabuf_t job;
+    uint32_t job_buffer_flags;
+    uint64_t job_timestamp_ns;
+    bool has_job;
+    bool stopping;
+
+    // import thread state
+    dmabuf_cache_entry_t image_cache[DMABUF_CACHE_SIZE];
+    uint64_t image_cache_clock;
+    import_texture_t textures[IMPORT_TEXTURE_COUNT];
+
+    // handover to the main thread
+    frame_mailbox_t mailbox;
+    event_handler_t notify_handler;
+    atomic_uint notifications;
+    atomic_bool available;
+
+    // main thread state
+    // - pending was picked up but its fence has not signaled yet
+    import_texture_t * pending;
+    import_texture_t * displayed;
+
+    // state flags
+    bool running;
+    bool initialized;
+} ctx_import_t;
+
+void wlm_import_init(struct ctx * ctx);
+
+void wlm_import_start(struct ctx * ctx);
+void wlm_import_stop(struct ctx * ctx);
+bool wlm_import_running(struct ctx * ctx);
+bool wlm_import_submit(struct ctx * ctx, dmabuf_t * dmabuf, uint32_t buffer_flags, uint64_t timestamp_ns);
+import_texture_t * wlm_import_take(struct ctx * ctx);
+void wlm_import_fence_draw(struct ctx * ctx);
+
+void wlm_import_cleanup(struct ctx * ctx);
+
+#endif
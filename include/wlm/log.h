@@ -4,6 +4,7 @@
 #include <stdio.h>
 
 #define wlm_log_debug(ctx, fmt, ...) if ((ctx)->opt.verbose) fprintf(stderr, "debug: " fmt, ##__VA_ARGS__)
+#define wlm_log_info(fmt, ...) fprintf(stderr, "info: " fmt, ##__VA_ARGS__)
 #define wlm_log_warn(fmt, ...) fprintf(stderr, "warning: " fmt, ##__VA_ARGS__)
 #define wlm_log_error(fmt, ...) fprintf(stderr, "error: " fmt, ##__VA_ARGS__)
 
@@ -2,18 +2,58 @@
 #define WL_MIRROR_MIRROR_BACKENDS_H_
 
 #include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <wlm/transform.h>
 
 struct ctx;
+struct output_list_node;
+struct toplevel_list_node;
 
 #define MIRROR_BACKEND_FATAL_FAILCOUNT 10
+#define MIRROR_BACKEND_FATAL_STALLCOUNT 3
+
+// capture source and options of one capture
+// - copied from the mirror state on the main thread when the capture is requested,
+//   the capture thread never reads state that stream mode may change meanwhile
+typedef struct {
+    struct output_list_node * target;
+    struct toplevel_list_node * toplevel;
+    region_t region;
+    bool has_region;
+    bool show_cursor;
+} mirror_capture_params_t;
 
 typedef struct mirror_backend {
-    void (*do_capture)(struct ctx * ctx);
+    const char * name;
+
+    // returns true if a new capture was started
+    // - false if one is still in flight or no capture could be started
+    bool (*do_capture)(struct ctx * ctx, const mirror_capture_params_t * params);
+    void (*do_upload)(struct ctx * ctx);
     void (*do_cleanup)(struct ctx * ctx);
-    size_t fail_count;
+
+    // abandon the capture in flight, the next do_capture starts a new one
+    // - returns true if the compositor failed to answer a request it
+    //   answers right away, as opposed to waiting for new content
+    bool (*do_cancel)(struct ctx * ctx);
+    atomic_size_t fail_count;
+    atomic_size_t cancel_count;
+
+    // capture requested and not finished or canceled yet
+    // - set by the thread dispatching capture events
+    atomic_bool capture_in_flight;
+
+    // capture in flight only completes once the compositor has new content
+    // - set by the thread dispatching capture events, read by the watchdog
+    atomic_bool waiting_for_damage;
+
+    // capture events are dispatched on the capture thread
+    bool capture_thread;
 } mirror_backend_t;
 
 void wlm_mirror_dmabuf_init(struct ctx * ctx);
 void wlm_mirror_screencopy_init(struct ctx * ctx);
+void wlm_mirror_extcopy_init(struct ctx * ctx);
 
 #endif
@@ -2,9 +2,11 @@
 #define WL_MIRROR_MIRROR_DMABUF_H_
 
 #include <stdint.h>
+#include <stdatomic.h>
 #include <wlm/proto/wlr-export-dmabuf-unstable-v1.h>
 #include <wlm/mirror.h>
 #include <wlm/egl.h>
+#include <wlm/capture.h>
 
 typedef enum {
     STATE_WAIT_FRAME,
@@ -14,18 +16,40 @@ typedef enum {
     STATE_CANCELED
 } dmabuf_state_t;
 
+// one frame being received, one waiting in the mailbox, and one being imported
+#define DMABUF_FRAME_COUNT 3
+
+typedef struct {
+    dmabuf_t dmabuf;
+    uint32_t buffer_flags;
+    uint64_t timestamp_ns;
+    atomic_bool in_use;
+} dmabuf_frame_t;
+
 typedef struct {
     mirror_backend_t header;
 
+    // export manager, wrapped onto the capture queue when using a capture thread
+    struct zwlr_export_dmabuf_manager_v1 * dmabuf_manager;
+
     // dmabuf frame object
     struct zwlr_export_dmabuf_frame_v1 * dmabuf_frame;
 
+    // frame slots
+    // - capture_frame is owned by the thread dispatching capture events
+    // - completed frames are handed to the main thread through the mailbox
+    dmabuf_frame_t frames[DMABUF_FRAME_COUNT];
+    dmabuf_frame_t * capture_frame;
+    frame_mailbox_t mailbox;
+    size_t import_fail_count;
+
+    // completed frames are imported on the import thread
+    bool use_import;
+
     // frame data
     uint32_t x;
     uint32_t y;
-    uint32_t buffer_flags;
     uint32_t frame_flags;
-    dmabuf_t dmabuf;
 
     // dmabuf state flags
     dmabuf_state_t state;
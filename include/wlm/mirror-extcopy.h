@@ -0,0 +1,106 @@
+#ifndef WL_MIRROR_MIRROR_EXTCOPY_H_
+#define WL_MIRROR_MIRROR_EXTCOPY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <wlm/mirror.h>
+#include <wlm/egl.h>
+#include <wlm/transform.h>
+#include <wlm/proto/ext-image-capture-source-v1.h>
+#include <wlm/proto/ext-image-copy-capture-v1.h>
+#include <wayland-client.h>
+
+typedef enum {
+    STATE_WAIT_CONSTRAINTS,
+    STATE_WAIT_READY,
+    STATE_READY,
+    STATE_CANCELED
+} extcopy_state_t;
+
+// one buffer being written by the compositor, one holding the newest finished frame,
+// and one still imported as the current texture when using dmabuf buffers
+#define EXTCOPY_BUFFER_COUNT 3
+
+typedef enum {
+    BUFFER_TYPE_SHM,
+    BUFFER_TYPE_DMABUF
+} extcopy_buffer_type_t;
+
+typedef enum {
+    BUFFER_FREE,
+    BUFFER_BUSY,
+    BUFFER_READY,
+    BUFFER_IMPORTED
+} extcopy_buffer_state_t;
+
+typedef struct {
+    struct wl_buffer * buffer;
+    size_t shm_offset;
+    dmabuf_t dmabuf;
+
+    // regions that changed since this buffer was last captured into
+    damage_t stale_damage;
+    bool fully_stale;
+
+    uint64_t timestamp_ns;
+    extcopy_buffer_state_t state;
+} extcopy_buffer_t;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    bool has_shm_format;
+    uint32_t shm_format;
+    bool has_dmabuf_format;
+    uint32_t dmabuf_format;
+} extcopy_constraints_t;
+
+typedef struct {
+    mirror_backend_t header;
+
+    // shm state
+    int shm_fd;
+    size_t shm_size;
+    void * shm_addr;
+
+    // wl_shm objects
+    struct wl_shm_pool * shm_pool;
+
+    // capture session objects
+    struct output_list_node * session_target;
+    struct toplevel_list_node * session_toplevel;
+    bool session_cursor;
+    struct ext_image_capture_source_v1 * capture_source;
+    struct ext_image_copy_capture_session_v1 * capture_session;
+    struct ext_image_copy_capture_frame_v1 * capture_frame;
+
+    // buffer constraints
+    extcopy_constraints_t pending_constraints;
+    extcopy_constraints_t constraints;
+    bool constraints_valid;
+
+    // capture buffers
+    extcopy_buffer_type_t buffer_type;
+    extcopy_buffer_t buffers[EXTCOPY_BUFFER_COUNT];
+    size_t capture_buffer;
+    uint32_t frame_width;
+    uint32_t frame_height;
+    uint32_t frame_stride;
+    uint32_t frame_format;
+    bool dmabuf_failed;
+
+    // damage tracking
+    // - frame_damage is the damage of the frame being captured
+    // - upload_damage is the damage of all frames since the last upload
+    damage_t frame_damage;
+    damage_t upload_damage;
+    bool texture_valid;
+
+    // presentation time of the frame being captured
+    uint64_t frame_timestamp_ns;
+
+    // extcopy state flags
+    extcopy_state_t state;
+} extcopy_mirror_backend_t;
+
+#endif
@@ -2,7 +2,10 @@
 #define WL_MIRROR_MIRROR_SCREENCOPY_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <wlm/mirror.h>
+#include <wlm/egl.h>
+#include <wlm/transform.h>
 #include <wlm/proto/wlr-screencopy-unstable-v1.h>
 #include <wayland-client.h>
 
@@ -15,6 +18,39 @@ typedef enum {
     STATE_CANCELED
 } screencopy_state_t;
 
+// one buffer being written by the compositor, one holding the newest finished frame,
+// and one still imported as the current texture when using dmabuf buffers
+#define SCREENCOPY_BUFFER_COUNT 3
+
+typedef enum {
+    BUFFER_TYPE_SHM,
+    BUFFER_TYPE_DMABUF
+} screencopy_buffer_type_t;
+
+typedef enum {
+    BUFFER_FREE,
+    BUFFER_BUSY,
+    BUFFER_READY,
+    BUFFER_IMPORTED
+} screencopy_buffer_state_t;
+
+typedef struct {
+    struct wl_buffer * buffer;
+    size_t shm_offset;
+    dmabuf_t dmabuf;
+    uint32_t frame_flags;
+    uint64_t timestamp_ns;
+    screencopy_buffer_state_t state;
+} screencopy_buffer_t;
+
+typedef struct {
+    bool offered;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+} screencopy_offer_t;
+
 typedef struct {
     mirror_backend_t header;
 
@@ -25,7 +61,23 @@ typedef struct {
 
     // wl_shm objects
     struct wl_shm_pool * shm_pool;
-    struct wl_buffer * shm_buffer;
+
+    // capture buffers
+    screencopy_buffer_type_t buffer_type;
+    screencopy_buffer_t buffers[SCREENCOPY_BUFFER_COUNT];
+    size_t capture_buffer;
+
+    // buffer offers
+    screencopy_offer_t shm_offer;
+    screencopy_offer_t dmabuf_offer;
+    bool dmabuf_failed;
+
+    // damage tracking
+    // - frame_damage is the damage of the frame being captured
+    // - upload_damage is the damage of all frames since the last upload
+    damage_t frame_damage;
+    damage_t upload_damage;
+    bool texture_valid;
 
     // screencopy frame object
     struct zwlr_screencopy_frame_v1 * screencopy_frame;
@@ -39,6 +91,7 @@ typedef struct {
 
     // screencopy state flags
     screencopy_state_t state;
+    bool copy_with_damage;
 } screencopy_mirror_backend_t;
 
 #endif
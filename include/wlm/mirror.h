@@ -6,17 +6,84 @@
 #include <wayland-client-protocol.h>
 #include <wayland-egl.h>
 #include <EGL/egl.h>
+#include <wlm/event.h>
 #include <wlm/transform.h>
 #include <wlm/mirror-backends.h>
 
 struct ctx;
 struct output_list_node;
+struct toplevel_list_node;
+
+// number of backends tried by the auto backend
+#define MIRROR_AUTO_BACKEND_COUNT 3
+
+typedef struct {
+    const char * name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint32_t frames;
+    uint64_t latency_ns;
+    uint32_t latency_samples;
+
+    // state flags
+    bool measured;
+    bool failed;
+} mirror_benchmark_t;
 
 typedef struct ctx_mirror {
     struct output_list_node * current_target;
+    struct toplevel_list_node * current_toplevel;
     struct wl_callback * frame_callback;
     region_t current_region;
     bool invert_y;
+    bool present_skipped;
+
+    // capture rate limiting
+    event_timer_t capture_timer;
+    uint64_t next_capture_ns;
+    uint32_t frames_since_capture;
+
+    // just-in-time capture scheduling
+    struct wp_presentation_feedback * presentation_feedback;
+    struct wp_commit_timer_v1 * commit_timer;
+    uint64_t last_present_ns;
+    uint64_t last_present_seq;
+    uint64_t refresh_ns;
+    uint64_t capture_start_ns;
+    uint64_t capture_duration_ns;
+
+    // capture watchdog
+    // - timeouts count every abandoned capture
+    // - stalls count captures the compositor stopped answering
+    event_timer_t capture_watchdog;
+    uint64_t capture_timeouts;
+    uint64_t capture_stalls;
+    uint32_t consecutive_stalls;
+
+    // capture timestamp of the frame being presented
+    // - stale frames count frames dropped by --max-frame-age
+    uint64_t frame_timestamp_ns;
+    uint64_t stale_frames;
+
+    // auto backend benchmark
+    // - each backend warms up before its frames are counted
+    // - frames are counted when they are swapped, not when they are received
+    event_timer_t benchmark_timer;
+    mirror_benchmark_t benchmark[MIRROR_AUTO_BACKEND_COUNT];
+    mirror_benchmark_t * benchmark_current;
+    bool benchmark_measuring;
+    bool benchmark_frame_pending;
+    bool benchmarking;
+
+    // deferred presents while the GPU is busy with the previous frame
+    event_handler_t draw_fence_handler;
+
+    // present cost measurement
+    uint64_t measure_start_ns;
+    uint64_t measure_wait_ns;
+    uint64_t measure_max_wait_ns;
+    uint32_t measure_frames;
+    uint32_t measure_deferred;
 
     // backend data
     mirror_backend_t * backend;
@@ -30,8 +97,13 @@ void wlm_mirror_init(struct ctx * ctx);
 void wlm_mirror_backend_init(struct ctx * ctx);
 
 void wlm_mirror_output_removed(struct ctx * ctx, struct output_list_node * node);
+void wlm_mirror_toplevel_removed(struct ctx * ctx, struct toplevel_list_node * node);
 void wlm_mirror_update_title(struct ctx * ctx);
 
+void wlm_mirror_frame_ready(struct ctx * ctx);
+void wlm_mirror_capture_params(struct ctx * ctx, mirror_capture_params_t * params);
+uint64_t wlm_mirror_frame_timestamp(uint32_t sec_hi, uint32_t sec_lo, uint32_t nsec);
+bool wlm_mirror_frame_accept(struct ctx * ctx, uint64_t timestamp_ns);
 void wlm_mirror_backend_fail(struct ctx * ctx);
 void wlm_mirror_cleanup(struct ctx * ctx);
 
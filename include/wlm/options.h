@@ -7,6 +7,7 @@
 
 struct ctx;
 struct output_list_node;
+struct toplevel_list_node;
 
 typedef enum {
     SCALE_FIT,
@@ -22,7 +23,8 @@ typedef enum {
 typedef enum {
     BACKEND_AUTO,
     BACKEND_DMABUF,
-    BACKEND_SCREENCOPY
+    BACKEND_SCREENCOPY,
+    BACKEND_EXTCOPY
 } backend_t;
 
 typedef struct ctx_opt {
@@ -33,13 +35,28 @@ typedef struct ctx_opt {
     bool freeze;
     bool has_region;
     bool fullscreen;
+    bool present_on_change;
+    bool jit_capture;
+    bool capture_thread;
+    bool import_thread;
+    bool gpu_fences;
+    bool measure_sync;
+    bool benchmark_backends;
+    bool hud;
+    bool perf_counters;
+    uint32_t max_fps;
+    uint32_t capture_divider;
+    uint32_t capture_timeout_ms;
+    uint32_t max_frame_age_ms;
     scale_t scaling;
     scale_filter_t scaling_filter;
     backend_t backend;
     transform_t transform;
     region_t region;
     char * output;
+    char * toplevel;
     char * fullscreen_output;
+    char * trace_file;
 } ctx_opt_t;
 
 void wlm_opt_init(struct ctx * ctx);
@@ -47,9 +64,11 @@ void wlm_cleanup_opt(struct ctx * ctx);
 
 bool wlm_opt_parse_scaling(scale_t * scaling, scale_filter_t * scaling_filter, const char * scaling_arg);
 bool wlm_opt_parse_backend(backend_t * backend, const char * backend_arg);
+bool wlm_opt_parse_uint(uint32_t * value, const char * value_arg, bool nonzero);
 bool wlm_opt_parse_transform(transform_t * transform, const char * transform_arg);
 bool wlm_opt_parse_region(region_t * region, char ** output, const char * region_arg);
 bool wlm_opt_find_output(struct ctx * ctx, struct output_list_node ** output_handle, region_t * region_handle);
+bool wlm_opt_find_toplevel(struct ctx * ctx, struct toplevel_list_node ** toplevel_handle);
 
 void wlm_opt_usage(struct ctx * ctx);
 void wlm_opt_version(struct ctx * ctx);
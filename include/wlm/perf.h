@@ -0,0 +1,71 @@
+#ifndef WL_MIRROR_PERF_H_
+#define WL_MIRROR_PERF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+struct ctx;
+
+// stages of the frame path measured with hardware counters
+typedef enum {
+    PERF_STAGE_BACKEND, // capture requests and capture event handlers
+    PERF_STAGE_UPLOAD,  // upload or import of a new frame on the main thread
+    PERF_STAGE_DRAW,
+    PERF_STAGE_SWAP,
+    PERF_STAGE_STREAM,  // parsing and applying stream mode option lines
+    PERF_STAGE_COUNT
+} perf_stage_t;
+
+typedef enum {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_CONTEXT_SWITCHES,
+    PERF_COUNTER_COUNT
+} perf_counter_t;
+
+// counter group of one thread
+// - counters only count the thread that opened them
+// - the whole group is read at once from the first opened counter
+// - slot is the position of a counter in the group read, or -1 if unavailable
+typedef struct {
+    int fds[PERF_COUNTER_COUNT];
+    int slot[PERF_COUNTER_COUNT];
+    int leader_fd;
+    size_t open_count;
+
+    // counts at the start of each running stage, stages may nest
+    uint64_t begin[PERF_STAGE_COUNT][PERF_COUNTER_COUNT];
+    bool active[PERF_STAGE_COUNT];
+} perf_group_t;
+
+// totals of one stage, updated by whichever thread runs the stage
+// - last holds the counts of the most recent sample
+typedef struct {
+    atomic_uint_fast64_t samples;
+    atomic_uint_fast64_t total[PERF_COUNTER_COUNT];
+    atomic_uint_fast64_t last[PERF_COUNTER_COUNT];
+} perf_stage_stats_t;
+
+typedef struct ctx_perf {
+    perf_stage_stats_t stages[PERF_STAGE_COUNT];
+
+    // counter groups are opened by each thread on first use
+    // - closed when the thread exits
+    pthread_key_t group_key;
+
+    bool initialized;
+} ctx_perf_t;
+
+void wlm_perf_init(struct ctx * ctx);
+
+void wlm_perf_begin(struct ctx * ctx, perf_stage_t stage);
+void wlm_perf_end(struct ctx * ctx, perf_stage_t stage);
+void wlm_perf_print(struct ctx * ctx);
+
+void wlm_perf_cleanup(struct ctx * ctx);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef WL_MIRROR_STATS_H_
+#define WL_MIRROR_STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <wlm/event.h>
+
+struct ctx;
+
+// stages of the frame path
+typedef enum {
+    STATS_STAGE_ANSWER,  // capture request to first backend event
+    STATS_STAGE_CAPTURE, // capture request to backend ready event
+    STATS_STAGE_DELIVER, // backend ready event to frame ready on the main thread
+    STATS_STAGE_UPLOAD,  // upload or import of a new frame on the main thread
+    STATS_STAGE_DRAW,
+    STATS_STAGE_SWAP,
+    STATS_STAGE_TOTAL,   // capture request to buffer swap
+    STATS_STAGE_GPU_IMPORT, // GPU time of the first draw of a newly imported dmabuf
+    STATS_STAGE_GPU_UPLOAD, // GPU time of shm texture uploads
+    STATS_STAGE_GPU_DRAW,   // GPU time of drawing the mirrored image, without the HUD
+    STATS_STAGE_COUNT
+} stats_stage_t;
+
+// timestamps set by the thread dispatching capture events
+typedef enum {
+    STATS_MARK_EVENT,
+    STATS_MARK_READY,
+    STATS_MARK_COUNT
+} stats_mark_t;
+
+// rolling window of the most recent stage durations
+#define STATS_WINDOW 1024
+
+typedef struct {
+    uint32_t samples_us[STATS_WINDOW];
+    size_t next;
+    size_t len;
+    uint64_t count;
+} stats_histogram_t;
+
+typedef struct ctx_stats {
+    stats_histogram_t stages[STATS_STAGE_COUNT];
+    _Atomic uint64_t marks[STATS_MARK_COUNT];
+
+    // request time of the newest finished capture
+    uint64_t ready_request_ns;
+
+    // frame counters
+    // - dropped frames were finished but replaced before being drawn
+    uint64_t uploaded_frames;
+    uint64_t drawn_frames;
+    uint64_t last_drawn_upload;
+    atomic_uint_fast64_t dropped_frames;
+
+    // SIGUSR1 prints stats
+    event_handler_t signal_handler;
+
+    bool initialized;
+} ctx_stats_t;
+
+void wlm_stats_init(struct ctx * ctx);
+
+void wlm_stats_mark(struct ctx * ctx, stats_mark_t mark);
+void wlm_stats_frame_dropped(struct ctx * ctx);
+void wlm_stats_frame_uploaded(struct ctx * ctx);
+void wlm_stats_frame_drawn(struct ctx * ctx, uint64_t draw_start_ns, uint64_t swap_start_ns, uint64_t swap_end_ns);
+void wlm_stats_capture_done(struct ctx * ctx, uint64_t request_ns, uint64_t now_ns);
+void wlm_stats_record(struct ctx * ctx, stats_stage_t stage, uint64_t duration_ns);
+void wlm_stats_print(struct ctx * ctx);
+
+void wlm_stats_cleanup(struct ctx * ctx);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef WL_MIRROR_TRACE_H_
+#define WL_MIRROR_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <wlm/event.h>
+
+struct ctx;
+
+// separate tracks in the trace
+// - one per thread, events on a track must be properly nested
+// - backend states overlap with events of any thread and get their own track
+typedef enum {
+    TRACE_TRACK_MAIN,
+    TRACE_TRACK_CAPTURE,
+    TRACE_TRACK_IMPORT,
+    TRACE_TRACK_BACKEND_STATE,
+    TRACE_TRACK_COUNT
+} trace_track_t;
+
+// one begin or end event
+// - sequence is index + 1 once the event is completely written
+typedef struct {
+    _Atomic uint64_t sequence;
+    uint64_t timestamp_ns;
+    const char * name;
+    trace_track_t track;
+    char phase;
+} trace_event_t;
+
+// newest events kept in memory, older events are overwritten
+#define TRACE_RING_SIZE 65536
+
+typedef struct ctx_trace {
+    // ring buffer, allocated when tracing is first enabled
+    trace_event_t * ring;
+    atomic_uint_fast64_t head;
+    uint64_t start;
+    atomic_bool enabled;
+
+    // SIGUSR2 writes the trace file
+    event_handler_t signal_handler;
+
+    bool initialized;
+} ctx_trace_t;
+
+void wlm_trace_init(struct ctx * ctx);
+void wlm_trace_update(struct ctx * ctx);
+void wlm_trace_set_thread(trace_track_t track);
+
+void wlm_trace_begin(struct ctx * ctx, const char * name);
+void wlm_trace_end(struct ctx * ctx, const char * name);
+void wlm_trace_state(struct ctx * ctx, const char * old_state, const char * new_state);
+void wlm_trace_flush(struct ctx * ctx);
+
+void wlm_trace_cleanup(struct ctx * ctx);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef WL_MIRROR_TRANSFORM_H_
 #define WL_MIRROR_TRANSFORM_H_
 
+#include <stddef.h>
 #include <stdbool.h>
 #include <wayland-client-protocol.h>
 #include <wlm/proto/linux-dmabuf-unstable-v1.h>
@@ -31,6 +32,14 @@ typedef struct {
     uint32_t height;
 } region_t;
 
+// damage rectangles are merged into their bounding box beyond this count
+#define MAX_DAMAGE_RECTS 16
+
+typedef struct {
+    size_t count;
+    region_t rects[MAX_DAMAGE_RECTS];
+} damage_t;
+
 typedef struct {
     float data[3][3];
 } mat3_t;
@@ -50,5 +59,10 @@ void wlm_util_viewport_apply_output_transform(uint32_t * width, uint32_t * heigh
 bool wlm_util_region_contains(const region_t * region, const region_t * output);
 void wlm_util_region_scale(region_t * region, double scale);
 void wlm_util_region_clamp(region_t * region, const region_t * output);
+void wlm_util_region_union(region_t * region, const region_t * other);
+
+void wlm_util_damage_clear(damage_t * damage);
+void wlm_util_damage_add(damage_t * damage, const region_t * rect);
+void wlm_util_damage_merge(damage_t * damage, const damage_t * other);
 
 #endif
@@ -6,10 +6,16 @@
 #include <wlm/event.h>
 #include <wlm/proto/viewporter.h>
 #include <wlm/proto/fractional-scale-v1.h>
+#include <wlm/proto/presentation-time.h>
+#include <wlm/proto/commit-timing-v1.h>
 #include <wlm/proto/xdg-shell.h>
 #include <wlm/proto/xdg-output-unstable-v1.h>
+#include <wlm/proto/linux-dmabuf-unstable-v1.h>
 #include <wlm/proto/wlr-export-dmabuf-unstable-v1.h>
 #include <wlm/proto/wlr-screencopy-unstable-v1.h>
+#include <wlm/proto/ext-image-capture-source-v1.h>
+#include <wlm/proto/ext-image-copy-capture-v1.h>
+#include <wlm/proto/ext-foreign-toplevel-list-v1.h>
 
 #ifdef WITH_LIBDECOR
 #include <libdecor.h>
@@ -39,6 +45,15 @@ typedef struct seat_list_node {
     uint32_t seat_id;
 } seat_list_node_t;
 
+typedef struct toplevel_list_node {
+    struct toplevel_list_node * next;
+    struct ctx * ctx;
+    struct ext_foreign_toplevel_handle_v1 * handle;
+    char * title;
+    char * app_id;
+    char * identifier;
+} toplevel_list_node_t;
+
 typedef struct ctx_wl {
     struct wl_display * display;
     struct wl_registry * registry;
@@ -63,12 +78,34 @@ typedef struct ctx_wl {
     // screencopy backend objects
     struct wl_shm * shm;
     struct zwlr_screencopy_manager_v1 * screencopy_manager;
+    struct zwp_linux_dmabuf_v1 * linux_dmabuf;
     uint32_t shm_id;
     uint32_t screencopy_manager_id;
+    uint32_t linux_dmabuf_id;
+
+    // extcopy backend objects
+    struct ext_image_copy_capture_manager_v1 * copy_capture_manager;
+    struct ext_output_image_capture_source_manager_v1 * output_capture_source_manager;
+    uint32_t copy_capture_manager_id;
+    uint32_t output_capture_source_manager_id;
+
+    // toplevel capture objects
+    struct ext_foreign_toplevel_list_v1 * toplevel_list;
+    struct ext_foreign_toplevel_image_capture_source_manager_v1 * toplevel_capture_source_manager;
+    uint32_t toplevel_list_id;
+    uint32_t toplevel_capture_source_manager_id;
+
+    // presentation timing objects
+    struct wp_presentation * presentation;
+    struct wp_commit_timing_manager_v1 * commit_timing_manager;
+    uint32_t presentation_id;
+    uint32_t commit_timing_manager_id;
+    int presentation_clock;
 
     // output list
     output_list_node_t * outputs;
     seat_list_node_t * seats;
+    toplevel_list_node_t * toplevels;
 
     // surface objects
     struct wl_surface * surface;
@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <wlm/context.h>
+#include <wlm/allocator.h>
+#include <wlm/proto/linux-dmabuf-unstable-v1.h>
+
+#if __linux__
+#include <linux/udmabuf.h>
+#endif
+
+#define FOURCC(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+#define UDMABUF_STRIDE_ALIGN 256
+
+// --- helpers ---
+
+static void dmabuf_init_planes(dmabuf_t * dmabuf, size_t planes) {
+    for (size_t i = 0; i < planes; i++) {
+        dmabuf->fds[i] = -1;
+        dmabuf->offsets[i] = 0;
+        dmabuf->strides[i] = 0;
+    }
+
+    dmabuf->planes = planes;
+}
+
+#ifdef WITH_GBM
+// --- gbm allocation ---
+
+static const char * find_render_node(ctx_t * ctx) {
+    // find the render node of the GPU used by EGL
+    // - imported buffers then live on the same GPU as our texture
+    PFNEGLQUERYDISPLAYATTRIBEXTPROC eglQueryDisplayAttribEXT =
+        (PFNEGLQUERYDISPLAYATTRIBEXTPROC)eglGetProcAddress("eglQueryDisplayAttribEXT");
+    PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT =
+        (PFNEGLQUERYDEVICESTRINGEXTPROC)eglGetProcAddress("eglQueryDeviceStringEXT");
+    if (eglQueryDisplayAttribEXT == NULL || eglQueryDeviceStringEXT == NULL) {
+        return NULL;
+    }
+
+    EGLAttrib device;
+    if (eglQueryDisplayAttribEXT(ctx->egl.display, EGL_DEVICE_EXT, &device) != EGL_TRUE) {
+        return NULL;
+    }
+
+    return eglQueryDeviceStringEXT((EGLDeviceEXT)device, EGL_DRM_RENDER_NODE_FILE_EXT);
+}
+
+static bool gbm_dmabuf_create(ctx_t * ctx, dmabuf_t * dmabuf) {
+    struct gbm_bo * bo = gbm_bo_create(ctx->allocator.gbm_device,
+        dmabuf->width, dmabuf->height, dmabuf->drm_format,
+        GBM_BO_USE_RENDERING | GBM_BO_USE_LINEAR
+    );
+    if (bo == NULL) {
+        wlm_log_debug(ctx, "allocator::gbm_dmabuf_create(): failed to create gbm buffer object\n");
+        return false;
+    }
+
+    int planes = gbm_bo_get_plane_count(bo);
+    if (planes <= 0 || planes > MAX_PLANES) {
+        wlm_log_error("allocator::gbm_dmabuf_create(): unsupported plane count %d\n", planes);
+        gbm_bo_destroy(bo);
+        return false;
+    }
+
+    dmabuf_init_planes(dmabuf, planes);
+    for (int i = 0; i < planes; i++) {
+        dmabuf->fds[i] = gbm_bo_get_fd_for_plane(bo, i);
+        dmabuf->offsets[i] = gbm_bo_get_offset(bo, i);
+        dmabuf->strides[i] = gbm_bo_get_stride_for_plane(bo, i);
+    }
+    dmabuf->modifier = gbm_bo_get_modifier(bo);
+
+    // exported dmabuf fds keep the buffer alive
+    gbm_bo_destroy(bo);
+
+    for (int i = 0; i < planes; i++) {
+        if (dmabuf->fds[i] == -1) {
+            wlm_log_error("allocator::gbm_dmabuf_create(): failed to export dmabuf fd\n");
+            wlm_allocator_dmabuf_destroy(dmabuf);
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+#if __linux__
+// --- udmabuf allocation ---
+
+static size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) / align * align;
+}
+
+static bool is_32bpp_format(uint32_t drm_format) {
+    switch (drm_format) {
+        case FOURCC('A', 'R', '2', '4'):
+        case FOURCC('X', 'R', '2', '4'):
+        case FOURCC('A', 'B', '2', '4'):
+        case FOURCC('X', 'B', '2', '4'):
+        case FOURCC('R', 'A', '2', '4'):
+        case FOURCC('R', 'X', '2', '4'):
+        case FOURCC('B', 'A', '2', '4'):
+        case FOURCC('B', 'X', '2', '4'):
+        case FOURCC('A', 'R', '3', '0'):
+        case FOURCC('X', 'R', '3', '0'):
+        case FOURCC('A', 'B', '3', '0'):
+        case FOURCC('X', 'B', '3', '0'):
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool udmabuf_dmabuf_create(ctx_t * ctx, dmabuf_t * dmabuf) {
+    if (!is_32bpp_format(dmabuf->drm_format)) {
+        wlm_log_debug(ctx, "allocator::udmabuf_dmabuf_create(): unsupported format %08x\n", dmabuf->drm_format);
+        return false;
+    }
+
+    uint32_t stride = align_up(dmabuf->width * 4, UDMABUF_STRIDE_ALIGN);
+    size_t size = align_up((size_t)stride * dmabuf->height, sysconf(_SC_PAGESIZE));
+
+    // udmabuf requires a memfd that cannot shrink
+    int memfd = memfd_create("wl-mirror-udmabuf", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd == -1) {
+        wlm_log_error("allocator::udmabuf_dmabuf_create(): failed to create memfd\n");
+        return false;
+    }
+
+    if (ftruncate(memfd, size) == -1 || fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK) == -1) {
+        wlm_log_error("allocator::udmabuf_dmabuf_create(): failed to prepare memfd\n");
+        close(memfd);
+        return false;
+    }
+
+    struct udmabuf_create create = {
+        .memfd = memfd,
+        .flags = UDMABUF_FLAGS_CLOEXEC,
+        .offset = 0,
+        .size = size
+    };
+    int fd = ioctl(ctx->allocator.udmabuf_fd, UDMABUF_CREATE, &create);
+    close(memfd);
+    if (fd == -1) {
+        wlm_log_error("allocator::udmabuf_dmabuf_create(): failed to create udmabuf\n");
+        return false;
+    }
+
+    dmabuf_init_planes(dmabuf, 1);
+    dmabuf->fds[0] = fd;
+    dmabuf->offsets[0] = 0;
+    dmabuf->strides[0] = stride;
+    dmabuf->modifier = DRM_FORMAT_MOD_LINEAR;
+    return true;
+}
+#endif
+
+// --- init_allocator ---
+
+void wlm_allocator_init(ctx_t * ctx) {
+    // initialize context structure
+    ctx->allocator.drm_fd = -1;
+#ifdef WITH_GBM
+    ctx->allocator.gbm_device = NULL;
+#endif
+    ctx->allocator.udmabuf_fd = -1;
+
+    ctx->allocator.available = false;
+    ctx->allocator.initialized = true;
+
+    // allocated buffers can only be shared via linux-dmabuf
+    if (ctx->wl.linux_dmabuf == NULL) {
+        wlm_log_debug(ctx, "allocator::init(): missing linux_dmabuf protocol, dmabuf allocation disabled\n");
+        return;
+    }
+
+#ifdef WITH_GBM
+    // create gbm device on the render node used by EGL
+    const char * render_node = find_render_node(ctx);
+    if (render_node == NULL) {
+        render_node = "/dev/dri/renderD128";
+    }
+
+    ctx->allocator.drm_fd = open(render_node, O_RDWR | O_CLOEXEC);
+    if (ctx->allocator.drm_fd == -1) {
+        wlm_log_debug(ctx, "allocator::init(): failed to open render node %s\n", render_node);
+    } else {
+        ctx->allocator.gbm_device = gbm_create_device(ctx->allocator.drm_fd);
+        if (ctx->allocator.gbm_device == NULL) {
+            wlm_log_debug(ctx, "allocator::init(): failed to create gbm device\n");
+        } else {
+            wlm_log_debug(ctx, "allocator::init(): using gbm on %s\n", render_node);
+            ctx->allocator.available = true;
+        }
+    }
+#endif
+
+#if __linux__
+    // udmabuf as fallback without a usable GPU
+    ctx->allocator.udmabuf_fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+    if (ctx->allocator.udmabuf_fd == -1) {
+        wlm_log_debug(ctx, "allocator::init(): failed to open /dev/udmabuf\n");
+    } else {
+        wlm_log_debug(ctx, "allocator::init(): using udmabuf\n");
+        ctx->allocator.available = true;
+    }
+#endif
+}
+
+// --- dmabuf_create ---
+
+bool wlm_allocator_dmabuf_create(ctx_t * ctx, dmabuf_t * dmabuf, uint32_t width, uint32_t height, uint32_t drm_format) {
+    dmabuf->width = width;
+    dmabuf->height = height;
+    dmabuf->drm_format = drm_format;
+    dmabuf->planes = 0;
+    dmabuf->modifier = 0;
+
+    if (!ctx->allocator.available) {
+        return false;
+    }
+
+#ifdef WITH_GBM
+    if (ctx->allocator.gbm_device != NULL && gbm_dmabuf_create(ctx, dmabuf)) {
+        return true;
+    }
+#endif
+
+#if __linux__
+    if (ctx->allocator.udmabuf_fd != -1 && udmabuf_dmabuf_create(ctx, dmabuf)) {
+        return true;
+    }
+#endif
+
+    return false;
+}
+
+// --- dmabuf_to_wl_buffer ---
+
+struct wl_buffer * wlm_allocator_dmabuf_to_wl_buffer(ctx_t * ctx, dmabuf_t * dmabuf) {
+    struct zwp_linux_buffer_params_v1 * params = zwp_linux_dmabuf_v1_create_params(ctx->wl.linux_dmabuf);
+    if (params == NULL) {
+        wlm_log_error("allocator::dmabuf_to_wl_buffer(): failed to create buffer params\n");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < dmabuf->planes; i++) {
+        zwp_linux_buffer_params_v1_add(params,
+            dmabuf->fds[i], i, dmabuf->offsets[i], dmabuf->strides[i],
+            (uint32_t)(dmabuf->modifier >> 32), (uint32_t)dmabuf->modifier
+        );
+    }
+
+    struct wl_buffer * buffer = zwp_linux_buffer_params_v1_create_immed(params,
+        dmabuf->width, dmabuf->height, dmabuf->drm_format, 0
+    );
+    zwp_linux_buffer_params_v1_destroy(params);
+
+    return buffer;
+}
+
+// --- dmabuf_destroy ---
+
+void wlm_allocator_dmabuf_destroy(dmabuf_t * dmabuf) {
+    for (size_t i = 0; i < dmabuf->planes; i++) {
+        if (dmabuf->fds[i] != -1) close(dmabuf->fds[i]);
+    }
+
+    dmabuf->planes = 0;
+    dmabuf->modifier = 0;
+}
+
+// --- cleanup_allocator ---
+
+void wlm_allocator_cleanup(ctx_t * ctx) {
+    if (!ctx->allocator.initialized) return;
+
+    wlm_log_debug(ctx, "allocator::cleanup(): destroying allocator objects\n");
+
+#ifdef WITH_GBM
+    if (ctx->allocator.gbm_device != NULL) gbm_device_destroy(ctx->allocator.gbm_device);
+#endif
+    if (ctx->allocator.drm_fd != -1) close(ctx->allocator.drm_fd);
+    if (ctx->allocator.udmabuf_fd != -1) close(ctx->allocator.udmabuf_fd);
+
+    ctx->allocator.initialized = false;
+}
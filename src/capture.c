@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <wlm/context.h>
+#include <wlm/capture.h>
+
+// --- helpers ---
+
+static void signal_fd(int fd) {
+    uint64_t count = 1;
+    if (write(fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+        wlm_log_error("capture::signal_fd(): failed to signal eventfd\n");
+    }
+}
+
+static void drain_fd(int fd) {
+    uint64_t count;
+    while (read(fd, &count, sizeof count) > 0);
+}
+
+// --- capture thread ---
+
+static void * capture_thread_main(void * data) {
+    ctx_t * ctx = (ctx_t *)data;
+    struct wl_display * display = ctx->wl.display;
+    struct wl_event_queue * queue = ctx->capture.queue;
+    wlm_trace_set_thread(TRACE_TRACK_CAPTURE);
+
+    while (!atomic_load(&ctx->capture.stopping)) {
+        // start requested capture before waiting for events
+        // - the backend dispatches all capture events on this thread
+        if (atomic_exchange(&ctx->capture.capture_requested, false)) {
+            // target and options may change on the main thread while capturing
+            pthread_mutex_lock(&ctx->capture.request_lock);
+            mirror_capture_params_t params = ctx->capture.request_params;
+            pthread_mutex_unlock(&ctx->capture.request_lock);
+
+            wlm_perf_begin(ctx, PERF_STAGE_BACKEND);
+            ctx->mirror.backend->do_capture(ctx, &params);
+            wlm_perf_end(ctx, PERF_STAGE_BACKEND);
+        }
+
+        // dispatch events queued by other readers before reading
+        while (wl_display_prepare_read_queue(display, queue) != 0) {
+            wlm_perf_begin(ctx, PERF_STAGE_BACKEND);
+            int result = wl_display_dispatch_queue_pending(display, queue);
+            wlm_perf_end(ctx, PERF_STAGE_BACKEND);
+            if (result == -1) {
+                wlm_log_error("capture::thread(): failed to dispatch capture events\n");
+                wlm_capture_notify(ctx, CAPTURE_NOTIFY_DISPLAY_ERROR);
+                return NULL;
+            }
+        }
+
+        if (wl_display_flush(display) == -1 && errno != EAGAIN) {
+            wlm_log_error("capture::thread(): failed to flush display\n");
+            wl_display_cancel_read(display);
+            wlm_capture_notify(ctx, CAPTURE_NOTIFY_DISPLAY_ERROR);
+            return NULL;
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = wl_display_get_fd(display), .events = POLLIN, .revents = 0 },
+            { .fd = ctx->capture.wake_fd, .events = POLLIN, .revents = 0 }
+        };
+        if (poll(fds, 2, -1) == -1) {
+            wl_display_cancel_read(display);
+            if (errno == EINTR) continue;
+
+            wlm_log_error("capture::thread(): failed to poll display\n");
+            wlm_capture_notify(ctx, CAPTURE_NOTIFY_DISPLAY_ERROR);
+            return NULL;
+        }
+
+        if (fds[0].revents & (POLLERR | POLLHUP)) {
+            wl_display_cancel_read(display);
+            wlm_capture_notify(ctx, CAPTURE_NOTIFY_DISPLAY_ERROR);
+            return NULL;
+        } else if (fds[0].revents & POLLIN) {
+            if (wl_display_read_events(display) == -1) {
+                wlm_capture_notify(ctx, CAPTURE_NOTIFY_DISPLAY_ERROR);
+                return NULL;
+            }
+
+            // events for the main queue are dispatched by the main thread
+            wlm_capture_notify(ctx, CAPTURE_NOTIFY_EVENTS);
+        } else {
+            wl_display_cancel_read(display);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            drain_fd(ctx->capture.wake_fd);
+        }
+
+        // only capture events are dispatched on this queue, so this measures the backend
+        wlm_perf_begin(ctx, PERF_STAGE_BACKEND);
+        int result = wl_display_dispatch_queue_pending(display, queue);
+        wlm_perf_end(ctx, PERF_STAGE_BACKEND);
+        if (result == -1) {
+            wlm_log_error("capture::thread(): failed to dispatch capture events\n");
+            wlm_capture_notify(ctx, CAPTURE_NOTIFY_DISPLAY_ERROR);
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+// --- main thread event handlers ---
+
+static void on_capture_notify(ctx_t * ctx) {
+    drain_fd(ctx->capture.notify_handler.fd);
+
+    unsigned int notifications = atomic_exchange(&ctx->capture.notifications, 0);
+    if (notifications & CAPTURE_NOTIFY_DISPLAY_ERROR) {
+        ctx->wl.closing = true;
+        return;
+    }
+
+    if (notifications & CAPTURE_NOTIFY_EVENTS) {
+        if (wl_display_dispatch_pending(ctx->wl.display) == -1) {
+            ctx->wl.closing = true;
+        }
+
+#ifdef WITH_LIBDECOR
+        if (libdecor_dispatch(ctx->wl.libdecor_context, 0) < 0) {
+            ctx->wl.closing = true;
+        }
+#endif
+    }
+
+    if (ctx->wl.closing) return;
+
+    if (notifications & CAPTURE_NOTIFY_BACKEND_FAIL) {
+        wlm_mirror_backend_fail(ctx);
+    } else if (notifications & CAPTURE_NOTIFY_FRAME_READY) {
+        wlm_mirror_frame_ready(ctx);
+    }
+}
+
+static void on_capture_each(ctx_t * ctx) {
+    if (!ctx->capture.running) return;
+
+    // the main thread no longer reads the display, but still sends requests
+    wl_display_flush(ctx->wl.display);
+}
+
+// --- init_capture ---
+
+void wlm_capture_init(ctx_t * ctx) {
+    // initialize context structure
+    ctx->capture.queue = NULL;
+    ctx->capture.wake_fd = -1;
+
+    ctx->capture.notify_handler.next = NULL;
+    ctx->capture.notify_handler.fd = -1;
+    ctx->capture.notify_handler.events = EPOLLIN;
+    ctx->capture.notify_handler.priority = EVENT_PRIORITY_WAYLAND;
+    ctx->capture.notify_handler.on_event = on_capture_notify;
+    ctx->capture.notify_handler.on_each = on_capture_each;
+
+    pthread_mutex_init(&ctx->capture.request_lock, NULL);
+    ctx->capture.request_params = (mirror_capture_params_t){ 0 };
+    atomic_init(&ctx->capture.capture_requested, false);
+    atomic_init(&ctx->capture.stopping, false);
+    atomic_init(&ctx->capture.notifications, 0);
+
+    ctx->capture.running = false;
+    ctx->capture.initialized = true;
+
+    // create eventfds for waking the capture and main threads
+    ctx->capture.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ctx->capture.wake_fd == -1) {
+        wlm_log_error("capture::init(): failed to create wake eventfd\n");
+        wlm_exit_fail(ctx);
+    }
+
+    ctx->capture.notify_handler.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ctx->capture.notify_handler.fd == -1) {
+        wlm_log_error("capture::init(): failed to create notify eventfd\n");
+        wlm_exit_fail(ctx);
+    }
+
+    wlm_event_add_fd(ctx, &ctx->capture.notify_handler);
+}
+
+// --- wrap_proxy ---
+
+void * wlm_capture_wrap_proxy(ctx_t * ctx, void * proxy) {
+    if (!ctx->opt.capture_thread) return proxy;
+
+    // capture queue is only created once a backend wants to use it
+    if (ctx->capture.queue == NULL) {
+        ctx->capture.queue = wl_display_create_queue(ctx->wl.display);
+        if (ctx->capture.queue == NULL) {
+            wlm_log_error("capture::wrap_proxy(): failed to create capture event queue\n");
+            return proxy;
+        }
+    }
+
+    // objects created through the wrapper deliver their events on the capture queue
+    struct wl_proxy * wrapper = wl_proxy_create_wrapper(proxy);
+    if (wrapper == NULL) {
+        wlm_log_error("capture::wrap_proxy(): failed to create proxy wrapper\n");
+        return proxy;
+    }
+
+    wl_proxy_set_queue(wrapper, ctx->capture.queue);
+    return wrapper;
+}
+
+void wlm_capture_unwrap_proxy(void * wrapper, void * proxy) {
+    if (wrapper == NULL || wrapper == proxy) return;
+
+    wl_proxy_wrapper_destroy(wrapper);
+}
+
+// --- start_capture ---
+
+void wlm_capture_start(ctx_t * ctx) {
+    if (!ctx->capture.initialized) return;
+    if (ctx->capture.running) return;
+    if (ctx->capture.queue == NULL) return;
+    if (ctx->mirror.backend == NULL || !ctx->mirror.backend->capture_thread) return;
+
+    wlm_log_debug(ctx, "capture::start(): starting capture thread\n");
+
+    atomic_store(&ctx->capture.capture_requested, false);
+    atomic_store(&ctx->capture.stopping, false);
+
+    // capture thread becomes the only reader of the display fd
+    // - the main thread dispatches its own queue when notified
+    wlm_event_remove_fd(ctx, &ctx->wl.event_handler);
+
+    if (pthread_create(&ctx->capture.thread, NULL, capture_thread_main, (void *)ctx) != 0) {
+        wlm_log_error("capture::start(): failed to create capture thread\n");
+        wlm_event_add_fd(ctx, &ctx->wl.event_handler);
+        wlm_exit_fail(ctx);
+    }
+
+    ctx->capture.running = true;
+}
+
+// --- stop_capture ---
+
+void wlm_capture_stop(ctx_t * ctx) {
+    if (!ctx->capture.initialized) return;
+    if (!ctx->capture.running) return;
+
+    atomic_store(&ctx->capture.stopping, true);
+
+    // capture thread exits on its own after the current dispatch
+    if (wlm_capture_on_thread(ctx)) return;
+
+    wlm_log_debug(ctx, "capture::stop(): stopping capture thread\n");
+
+    signal_fd(ctx->capture.wake_fd);
+    pthread_join(ctx->capture.thread, NULL);
+    ctx->capture.running = false;
+
+    // frame and failure notifications refer to the stopped capture
+    // - failures happen again and frames are requested again on the next capture
+    unsigned int notifications = atomic_exchange(&ctx->capture.notifications, 0);
+    if (notifications & CAPTURE_NOTIFY_DISPLAY_ERROR) {
+        ctx->wl.closing = true;
+    }
+
+    // main thread reads the display again
+    wlm_event_add_fd(ctx, &ctx->wl.event_handler);
+    if (wl_display_dispatch_pending(ctx->wl.display) == -1) {
+        ctx->wl.closing = true;
+    }
+}
+
+// --- capture thread state ---
+
+bool wlm_capture_running(ctx_t * ctx) {
+    return ctx->capture.running;
+}
+
+bool wlm_capture_on_thread(ctx_t * ctx) {
+    return ctx->capture.running && pthread_equal(pthread_self(), ctx->capture.thread);
+}
+
+// --- request_capture ---
+
+void wlm_capture_request(ctx_t * ctx, const mirror_capture_params_t * params) {
+    pthread_mutex_lock(&ctx->capture.request_lock);
+    ctx->capture.request_params = *params;
+    pthread_mutex_unlock(&ctx->capture.request_lock);
+
+    atomic_store(&ctx->capture.capture_requested, true);
+    signal_fd(ctx->capture.wake_fd);
+}
+
+// --- notify ---
+
+void wlm_capture_notify(ctx_t * ctx, unsigned int notification) {
+    atomic_fetch_or(&ctx->capture.notifications, notification);
+    signal_fd(ctx->capture.notify_handler.fd);
+}
+
+// --- frame mailbox ---
+
+void wlm_capture_mailbox_init(frame_mailbox_t * mailbox) {
+    atomic_init(&mailbox->latest, NULL);
+}
+
+void * wlm_capture_mailbox_put(frame_mailbox_t * mailbox, void * frame) {
+    return atomic_exchange(&mailbox->latest, frame);
+}
+
+void * wlm_capture_mailbox_take(frame_mailbox_t * mailbox) {
+    return atomic_exchange(&mailbox->latest, NULL);
+}
+
+// --- cleanup_capture ---
+
+void wlm_capture_cleanup(ctx_t * ctx) {
+    if (!ctx->capture.initialized) return;
+
+    wlm_log_debug(ctx, "capture::cleanup(): destroying capture objects\n");
+
+    wlm_capture_stop(ctx);
+
+    if (ctx->capture.notify_handler.fd != -1) {
+        wlm_event_remove_fd(ctx, &ctx->capture.notify_handler);
+        close(ctx->capture.notify_handler.fd);
+    }
+    if (ctx->capture.wake_fd != -1) close(ctx->capture.wake_fd);
+    if (ctx->capture.queue != NULL) wl_event_queue_destroy(ctx->capture.queue);
+    pthread_mutex_destroy(&ctx->capture.request_lock);
+
+    ctx->capture.initialized = false;
+}
@@ -5,6 +5,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
 #include <wlm/context.h>
 #include <wlm/egl.h>
 #include <wlm/transform.h>
@@ -12,6 +14,23 @@
 #include <wlm/glsl/vertex_shader.h>
 #include <wlm/glsl/fragment_shader.h>
 
+// OpenGL ES 3.0 definitions not provided by the GLES2 headers
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#ifndef GL_UNPACK_ROW_LENGTH
+#define GL_UNPACK_ROW_LENGTH 0x0CF2
+#endif
+
+// a lost context may report errors forever, so stop clearing after this many
+#define GL_ERROR_DRAIN_LIMIT 16
+
 // --- buffers ---
 
 static const float vertex_array[] = {
@@ -25,12 +44,12 @@ static const float vertex_array[] = {
 
 // --- has_extension ---
 
-static bool has_extension(const char * extension) {
+static bool extension_in_list(const char * extensions, const char * extension) {
     size_t ext_len = strlen(extension);
+    if (extensions == NULL) return false;
 
     // try to find extension in extension list
-    const char * extensions = (const char *)glGetString(GL_EXTENSIONS);
-    char * match = strstr(extensions, extension);
+    const char * match = strstr(extensions, extension);
 
     // verify match was not a substring of another extension
     bool found = (
@@ -42,6 +61,27 @@ static bool has_extension(const char * extension) {
     return found;
 }
 
+static bool has_extension(const char * extension) {
+    return extension_in_list((const char *)glGetString(GL_EXTENSIONS), extension);
+}
+
+bool wlm_egl_has_egl_extension(ctx_t * ctx, const char * extension) {
+    return extension_in_list(eglQueryString(ctx->egl.display, EGL_EXTENSIONS), extension);
+}
+
+// --- set_texture_filter ---
+
+static void set_texture_filter(ctx_t * ctx, GLuint texture) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (ctx->opt.scaling_filter == SCALE_FILTER_LINEAR) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    } else {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+}
+
 // --- init_egl ---
 
 void wlm_egl_init(ctx_t * ctx) {
@@ -53,6 +93,19 @@ void wlm_egl_init(ctx_t * ctx) {
     ctx->egl.window = EGL_NO_SURFACE;
 
     ctx->egl.glEGLImageTargetTexture2DOES = NULL;
+    ctx->egl.eglCreateSyncKHR = NULL;
+    ctx->egl.eglDestroySyncKHR = NULL;
+    ctx->egl.eglClientWaitSyncKHR = NULL;
+    ctx->egl.eglDupNativeFenceFDANDROID = NULL;
+    ctx->egl.glGenQueriesEXT = NULL;
+    ctx->egl.glDeleteQueriesEXT = NULL;
+    ctx->egl.glBeginQueryEXT = NULL;
+    ctx->egl.glEndQueryEXT = NULL;
+    ctx->egl.glGetQueryObjectivEXT = NULL;
+    ctx->egl.glGetQueryObjectui64vEXT = NULL;
+    ctx->egl.glTexStorage2D = NULL;
+    ctx->egl.glMapBufferRange = NULL;
+    ctx->egl.glUnmapBuffer = NULL;
 
     ctx->egl.width = 1;
     ctx->egl.height = 1;
@@ -60,14 +113,49 @@ void wlm_egl_init(ctx_t * ctx) {
 
     ctx->egl.vbo = 0;
     ctx->egl.texture = 0;
+    ctx->egl.current_texture = 0;
     ctx->egl.freeze_texture = 0;
     ctx->egl.freeze_framebuffer = 0;
     ctx->egl.shader_program = 0;
     ctx->egl.texture_transform_uniform = 0;
     ctx->egl.invert_colors_uniform = 0;
 
+    for (size_t i = 0; i < UPLOAD_PBO_COUNT; i++) {
+        ctx->egl.upload_pbos[i] = 0;
+        ctx->egl.upload_pbo_sizes[i] = 0;
+    }
+    ctx->egl.upload_pbo_index = 0;
+    ctx->egl.storage_width = 0;
+    ctx->egl.storage_height = 0;
+    ctx->egl.storage_format = 0;
+    ctx->egl.storage_rejected_format = 0;
+
+    ctx->egl.draw_fence = EGL_NO_SYNC_KHR;
+
+    for (size_t i = 0; i < GPU_TIMER_COUNT; i++) {
+        for (size_t j = 0; j < GPU_TIMER_QUERIES; j++) {
+            ctx->egl.gpu_timers[i].queries[j] = 0;
+        }
+        ctx->egl.gpu_timers[i].issued = 0;
+        ctx->egl.gpu_timers[i].collected = 0;
+    }
+    ctx->egl.gpu_timer_current = GPU_TIMER_IMPORT;
+    ctx->egl.gpu_timer_active = false;
+    ctx->egl.import_draw_pending = false;
+
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        ctx->egl.dmabuf_cache[i].valid = false;
+    }
+    ctx->egl.dmabuf_cache_clock = 0;
+
+    ctx->egl.gles3 = false;
+    ctx->egl.fence_sync = false;
+    ctx->egl.native_fence_sync = false;
+    ctx->egl.timer_query = false;
+    ctx->egl.texture_immutable = false;
     ctx->egl.texture_region_aware = false;
     ctx->egl.texture_initialized = false;
+    ctx->egl.dirty = true;
     ctx->egl.initialized = true;
 
     // create egl display
@@ -117,13 +205,22 @@ void wlm_egl_init(ctx_t * ctx) {
     // create egl surface
     ctx->egl.surface = eglCreateWindowSurface(ctx->egl.display, ctx->egl.config, (EGLNativeWindowType)ctx->egl.window, NULL);
 
-    // create egl context with support for OpenGL ES 2.0
+    // create egl context with support for OpenGL ES 3.0
+    // - for immutable texture storage and asynchronous uploads
     EGLint context_attribs[] = {
-        EGL_CONTEXT_MAJOR_VERSION, 2,
+        EGL_CONTEXT_MAJOR_VERSION, 3,
         EGL_CONTEXT_MINOR_VERSION, 0,
         EGL_NONE
     };
     ctx->egl.context = eglCreateContext(ctx->egl.display, ctx->egl.config, EGL_NO_CONTEXT, context_attribs);
+    if (ctx->egl.context != EGL_NO_CONTEXT) {
+        ctx->egl.gles3 = true;
+    } else {
+        // fall back to OpenGL ES 2.0
+        wlm_log_debug(ctx, "egl::init(): failed to create OpenGL ES 3.0 context, falling back to OpenGL ES 2.0\n");
+        context_attribs[1] = 2;
+        ctx->egl.context = eglCreateContext(ctx->egl.display, ctx->egl.config, EGL_NO_CONTEXT, context_attribs);
+    }
     if (ctx->egl.context == EGL_NO_CONTEXT) {
         wlm_log_error("egl::init(): failed to create EGL context\n");
         wlm_exit_fail(ctx);
@@ -150,6 +247,71 @@ void wlm_egl_init(ctx_t * ctx) {
         wlm_exit_fail(ctx);
     }
 
+    // find OpenGL ES 3.0 functions
+    if (ctx->egl.gles3) {
+        ctx->egl.glTexStorage2D = (PFNGLTEXSTORAGE2DEXTPROC)eglGetProcAddress("glTexStorage2D");
+        ctx->egl.glMapBufferRange = (PFNGLMAPBUFFERRANGEEXTPROC)eglGetProcAddress("glMapBufferRange");
+        ctx->egl.glUnmapBuffer = (PFNGLUNMAPBUFFEROESPROC)eglGetProcAddress("glUnmapBuffer");
+        if (ctx->egl.glTexStorage2D == NULL || ctx->egl.glMapBufferRange == NULL || ctx->egl.glUnmapBuffer == NULL) {
+            wlm_log_debug(ctx, "egl::init(): failed to get OpenGL ES 3.0 functions, using OpenGL ES 2.0 upload path\n");
+            ctx->egl.gles3 = false;
+        }
+    }
+
+    // find fence sync functions
+    // - EGL_KHR_fence_sync: for checking if the GPU finished the last frame without blocking
+    // - EGL_ANDROID_native_fence_sync: for waiting on the last frame in the event loop
+    if (wlm_egl_has_egl_extension(ctx, "EGL_KHR_fence_sync")) {
+        ctx->egl.eglCreateSyncKHR = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+        ctx->egl.eglDestroySyncKHR = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+        ctx->egl.eglClientWaitSyncKHR = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+        ctx->egl.fence_sync = (
+            ctx->egl.eglCreateSyncKHR != NULL &&
+            ctx->egl.eglDestroySyncKHR != NULL &&
+            ctx->egl.eglClientWaitSyncKHR != NULL
+        );
+    }
+    if (ctx->egl.fence_sync && wlm_egl_has_egl_extension(ctx, "EGL_ANDROID_native_fence_sync")) {
+        ctx->egl.eglDupNativeFenceFDANDROID = (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress("eglDupNativeFenceFDANDROID");
+        ctx->egl.native_fence_sync = ctx->egl.eglDupNativeFenceFDANDROID != NULL;
+    }
+    wlm_log_debug(ctx, "egl::init(): fence sync %s, native fence sync %s\n",
+        ctx->egl.fence_sync ? "available" : "unavailable",
+        ctx->egl.native_fence_sync ? "available" : "unavailable"
+    );
+
+    // find timer query functions
+    // - GL_EXT_disjoint_timer_query: for measuring GPU time of imports, uploads, and draws
+    if (has_extension("GL_EXT_disjoint_timer_query")) {
+        ctx->egl.glGenQueriesEXT = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+        ctx->egl.glDeleteQueriesEXT = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+        ctx->egl.glBeginQueryEXT = (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+        ctx->egl.glEndQueryEXT = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+        ctx->egl.glGetQueryObjectivEXT = (PFNGLGETQUERYOBJECTIVEXTPROC)eglGetProcAddress("glGetQueryObjectivEXT");
+        ctx->egl.glGetQueryObjectui64vEXT = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+        ctx->egl.timer_query = (
+            ctx->egl.glGenQueriesEXT != NULL &&
+            ctx->egl.glDeleteQueriesEXT != NULL &&
+            ctx->egl.glBeginQueryEXT != NULL &&
+            ctx->egl.glEndQueryEXT != NULL &&
+            ctx->egl.glGetQueryObjectivEXT != NULL &&
+            ctx->egl.glGetQueryObjectui64vEXT != NULL
+        );
+    }
+    wlm_log_debug(ctx, "egl::init(): timer queries %s\n", ctx->egl.timer_query ? "available" : "unavailable");
+
+    // create timer queries
+    if (ctx->egl.timer_query) {
+        for (size_t i = 0; i < GPU_TIMER_COUNT; i++) {
+            ctx->egl.glGenQueriesEXT(GPU_TIMER_QUERIES, ctx->egl.gpu_timers[i].queries);
+        }
+    }
+
+    // create pixel unpack buffers for asynchronous uploads
+    if (ctx->egl.gles3) {
+        glGenBuffers(UPLOAD_PBO_COUNT, ctx->egl.upload_pbos);
+    }
+
     // create vertex buffer object
     glGenBuffers(1, &ctx->egl.vbo);
     glBindBuffer(GL_ARRAY_BUFFER, ctx->egl.vbo);
@@ -157,25 +319,12 @@ void wlm_egl_init(ctx_t * ctx) {
 
     // create texture and set scaling mode
     glGenTextures(1, &ctx->egl.texture);
-    glBindTexture(GL_TEXTURE_2D, ctx->egl.texture);
-    if (ctx->opt.scaling_filter == SCALE_FILTER_LINEAR) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    }
+    set_texture_filter(ctx, ctx->egl.texture);
+    ctx->egl.current_texture = ctx->egl.texture;
 
     // create freeze texture and set scaling mode
     glGenTextures(1, &ctx->egl.freeze_texture);
-    glBindTexture(GL_TEXTURE_2D, ctx->egl.freeze_texture);
-    if (ctx->opt.scaling_filter == SCALE_FILTER_LINEAR) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    }
+    set_texture_filter(ctx, ctx->egl.freeze_texture);
 
     // create freeze framebuffer
     glGenFramebuffers(1, &ctx->egl.freeze_framebuffer);
@@ -259,17 +408,35 @@ void wlm_egl_init(ctx_t * ctx) {
         wlm_log_error("egl::init(): failed to swap buffers\n");
         wlm_exit_fail(ctx);
     }
+    ctx->egl.dirty = false;
 }
 
 // --- draw_texture ---
 
 void wlm_egl_draw_texture(ctx_t *ctx) {
-    glBindTexture(GL_TEXTURE_2D, ctx->opt.freeze ? ctx->egl.freeze_texture : ctx->egl.texture);
+    // binding an EGLImage queues no GPU work, the driver does it on first use
+    // - the first draw sampling a newly created image is timed as import instead
+    // - the HUD is not part of either stage
+    gpu_timer_t timer = GPU_TIMER_DRAW;
+    if (ctx->egl.import_draw_pending && !ctx->opt.freeze) timer = GPU_TIMER_IMPORT;
+    ctx->egl.import_draw_pending = false;
+
+    wlm_egl_gpu_timer_collect(ctx);
+    wlm_egl_gpu_timer_begin(ctx, timer);
+
+    glBindTexture(GL_TEXTURE_2D, ctx->opt.freeze ? ctx->egl.freeze_texture : ctx->egl.current_texture);
     glClear(GL_COLOR_BUFFER_BIT);
 
     if (ctx->egl.texture_initialized) {
         glDrawArrays(GL_TRIANGLES, 0, 6);
     }
+
+    wlm_egl_gpu_timer_end(ctx, timer);
+
+    // draw HUD over the mirrored image
+    if (ctx->hud.initialized) {
+        wlm_hud_draw(ctx);
+    }
 }
 
 // --- resize_viewport
@@ -285,7 +452,8 @@ void wlm_egl_resize_viewport(ctx_t * ctx) {
     uint32_t view_height = win_height;
 
     // rotate texture dimensions by output transform
-    if (ctx->egl.texture_initialized) {
+    // - toplevel captures are never transformed
+    if (ctx->egl.texture_initialized && ctx->mirror.current_target != NULL) {
         wlm_util_viewport_apply_output_transform(&tex_width, &tex_height, ctx->mirror.current_target->transform);
     }
 
@@ -374,7 +542,9 @@ void wlm_egl_resize_viewport(ctx_t * ctx) {
             wlm_util_mat3_apply_region_transform(&texture_transform, &clamp_region, &output_region);
         }
 
-        wlm_util_mat3_apply_output_transform(&texture_transform, ctx->mirror.current_target->transform);
+        if (ctx->mirror.current_target != NULL) {
+            wlm_util_mat3_apply_output_transform(&texture_transform, ctx->mirror.current_target->transform);
+        }
         wlm_util_mat3_apply_invert_y(&texture_transform, ctx->mirror.invert_y);
     }
 
@@ -382,6 +552,7 @@ void wlm_egl_resize_viewport(ctx_t * ctx) {
     // - GL matrices are stored in column-major order, so transpose the matrix
     wlm_util_mat3_transpose(&texture_transform);
     glUniformMatrix3fv(ctx->egl.texture_transform_uniform, 1, false, (float *)texture_transform.data);
+    ctx->egl.dirty = true;
 }
 
 // --- resize_window ---
@@ -402,6 +573,7 @@ void wlm_egl_resize_window(ctx_t * ctx) {
         wlm_log_error("egl::resize_window(): failed to swap buffers\n");
         wlm_exit_fail(ctx);
     }
+    ctx->egl.dirty = false;
 }
 
 // --- update_uniforms ---
@@ -415,22 +587,12 @@ void wlm_egl_update_uniforms(ctx_t * ctx) {
     glUniform1i(ctx->egl.invert_colors_uniform, invert_colors);
 
     // set texture scaling mode
-    glBindTexture(GL_TEXTURE_2D, ctx->egl.texture);
-    if (ctx->opt.scaling_filter == SCALE_FILTER_LINEAR) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    }
-
-    glBindTexture(GL_TEXTURE_2D, ctx->egl.freeze_texture);
-    if (ctx->opt.scaling_filter == SCALE_FILTER_LINEAR) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    set_texture_filter(ctx, ctx->egl.texture);
+    set_texture_filter(ctx, ctx->egl.freeze_texture);
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        if (ctx->egl.dmabuf_cache[i].valid) {
+            set_texture_filter(ctx, ctx->egl.dmabuf_cache[i].texture);
+        }
     }
 }
 
@@ -438,9 +600,107 @@ void wlm_egl_update_uniforms(ctx_t * ctx) {
 
 void wlm_egl_freeze_framebuffer(struct ctx * ctx) {
     glBindFramebuffer(GL_FRAMEBUFFER, ctx->egl.freeze_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ctx->egl.current_texture, 0);
     glBindTexture(GL_TEXTURE_2D, ctx->egl.freeze_texture);
     glCopyTexImage2D(GL_TEXTURE_2D, 0, ctx->egl.format, 0, 0, ctx->egl.width, ctx->egl.height, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ctx->egl.dirty = true;
+}
+
+// --- draw_fence ---
+
+void wlm_egl_fence_draw(ctx_t * ctx) {
+    if (!ctx->egl.fence_sync) return;
+
+    if (ctx->egl.draw_fence != EGL_NO_SYNC_KHR) {
+        ctx->egl.eglDestroySyncKHR(ctx->egl.display, ctx->egl.draw_fence);
+        ctx->egl.draw_fence = EGL_NO_SYNC_KHR;
+    }
+
+    // native fences can be exported as sync file and polled in the event loop
+    EGLenum type = ctx->egl.native_fence_sync ? EGL_SYNC_NATIVE_FENCE_ANDROID : EGL_SYNC_FENCE_KHR;
+    ctx->egl.draw_fence = ctx->egl.eglCreateSyncKHR(ctx->egl.display, type, NULL);
+    if (ctx->egl.draw_fence == EGL_NO_SYNC_KHR) {
+        wlm_log_error("egl::fence_draw(): failed to create fence: error = %x\n", eglGetError());
+        return;
+    }
+
+    // native fence only gets a sync file once it is flushed
+    glFlush();
+}
+
+bool wlm_egl_draw_pending(ctx_t * ctx) {
+    if (ctx->egl.draw_fence == EGL_NO_SYNC_KHR) return false;
+
+    EGLint status = ctx->egl.eglClientWaitSyncKHR(ctx->egl.display, ctx->egl.draw_fence, 0, 0);
+    if (status == EGL_TIMEOUT_EXPIRED_KHR) {
+        return true;
+    }
+
+    ctx->egl.eglDestroySyncKHR(ctx->egl.display, ctx->egl.draw_fence);
+    ctx->egl.draw_fence = EGL_NO_SYNC_KHR;
+    return false;
+}
+
+int wlm_egl_draw_fence_fd(ctx_t * ctx) {
+    if (!ctx->egl.native_fence_sync || ctx->egl.draw_fence == EGL_NO_SYNC_KHR) return -1;
+
+    // sync file becomes readable once the fence has signaled
+    int fd = ctx->egl.eglDupNativeFenceFDANDROID(ctx->egl.display, ctx->egl.draw_fence);
+    return fd == EGL_NO_NATIVE_FENCE_FD_ANDROID ? -1 : fd;
+}
+
+// --- gpu_timer ---
+
+static const stats_stage_t gpu_timer_stages[GPU_TIMER_COUNT] = {
+    [GPU_TIMER_IMPORT] = STATS_STAGE_GPU_IMPORT,
+    [GPU_TIMER_UPLOAD] = STATS_STAGE_GPU_UPLOAD,
+    [GPU_TIMER_DRAW] = STATS_STAGE_GPU_DRAW
+};
+
+void wlm_egl_gpu_timer_begin(ctx_t * ctx, gpu_timer_t timer) {
+    if (!ctx->egl.timer_query || ctx->egl.gpu_timer_active) return;
+
+    // skip measuring instead of waiting for old results
+    gpu_timer_queries_t * queries = &ctx->egl.gpu_timers[timer];
+    if (queries->issued - queries->collected == GPU_TIMER_QUERIES) return;
+
+    ctx->egl.glBeginQueryEXT(GL_TIME_ELAPSED_EXT, queries->queries[queries->issued % GPU_TIMER_QUERIES]);
+    ctx->egl.gpu_timer_current = timer;
+    ctx->egl.gpu_timer_active = true;
+}
+
+void wlm_egl_gpu_timer_end(ctx_t * ctx, gpu_timer_t timer) {
+    if (!ctx->egl.gpu_timer_active || ctx->egl.gpu_timer_current != timer) return;
+
+    ctx->egl.glEndQueryEXT(GL_TIME_ELAPSED_EXT);
+    ctx->egl.gpu_timers[timer].issued++;
+    ctx->egl.gpu_timer_active = false;
+}
+
+void wlm_egl_gpu_timer_collect(ctx_t * ctx) {
+    if (!ctx->egl.timer_query) return;
+
+    // results are meaningless if the GPU was reset or changed clocks in between
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+
+    for (size_t i = 0; i < GPU_TIMER_COUNT; i++) {
+        gpu_timer_queries_t * queries = &ctx->egl.gpu_timers[i];
+
+        // queries complete in order, stop at the first one still pending
+        while (queries->collected < queries->issued) {
+            GLuint query = queries->queries[queries->collected % GPU_TIMER_QUERIES];
+            GLint available = 0;
+            ctx->egl.glGetQueryObjectivEXT(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+            if (!available) break;
+
+            GLuint64 elapsed_ns = 0;
+            ctx->egl.glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT_EXT, &elapsed_ns);
+            if (!disjoint) wlm_stats_record(ctx, gpu_timer_stages[i], elapsed_ns);
+            queries->collected++;
+        }
+    }
 }
 
 // --- dmabuf_to_texture ---
@@ -485,18 +745,12 @@ static const EGLAttrib modifier_high_attribs[] = {
 };
 _Static_assert(ARRAY_LENGTH(modifier_high_attribs) == MAX_PLANES, "modifier_high_attribs has incorrect length");
 
-bool wlm_egl_dmabuf_to_texture(ctx_t * ctx, dmabuf_t * dmabuf) {
-    if (dmabuf->planes > MAX_PLANES) {
-        wlm_log_error("egl::dmabuf_to_texture(): too many planes, got %zd, can support at most %d\n", dmabuf->planes, MAX_PLANES);
-        return false;
-    }
+// size, format, five attributes per plane, and terminator
+#define DMABUF_IMAGE_ATTRIBS_LENGTH (6 + 10 * MAX_PLANES + 1)
 
+EGLImage wlm_egl_dmabuf_create_image(ctx_t * ctx, dmabuf_t * dmabuf) {
     int i = 0;
-    EGLAttrib * image_attribs = malloc((6 + 10 * dmabuf->planes + 1) * sizeof (EGLAttrib));
-    if (image_attribs == NULL) {
-        wlm_log_error("egl::dmabuf_to_texture(): failed to allocate EGL image attribs\n");
-        return false;
-    }
+    EGLAttrib image_attribs[DMABUF_IMAGE_ATTRIBS_LENGTH];
 
     image_attribs[i++] = EGL_WIDTH;
     image_attribs[i++] = dmabuf->width;
@@ -521,21 +775,499 @@ bool wlm_egl_dmabuf_to_texture(ctx_t * ctx, dmabuf_t * dmabuf) {
     image_attribs[i++] = EGL_NONE;
 
     // create EGLImage from dmabuf with attribute array
-    EGLImage frame_image = eglCreateImage(ctx->egl.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, image_attribs);
-    free(image_attribs);
+    wlm_trace_begin(ctx, "egl_import");
+    EGLImage image = eglCreateImage(ctx->egl.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, image_attribs);
+    wlm_trace_end(ctx, "egl_import");
+
+    if (image == EGL_NO_IMAGE) {
+        wlm_log_error("egl::dmabuf_create_image(): failed to create EGL image from dmabuf: error = %x\n", eglGetError());
+    }
+
+    return image;
+}
+
+// --- dmabuf_cache ---
+
+static void dmabuf_cache_evict(ctx_t * ctx, dmabuf_cache_entry_t * entry) {
+    if (!entry->valid) return;
+
+    if (ctx->egl.current_texture == entry->texture) ctx->egl.current_texture = ctx->egl.texture;
+    if (entry->texture != 0) glDeleteTextures(1, &entry->texture);
+    if (entry->image != EGL_NO_IMAGE) eglDestroyImage(ctx->egl.display, entry->image);
+
+    entry->texture = 0;
+    entry->image = EGL_NO_IMAGE;
+    entry->valid = false;
+}
+
+static void dmabuf_cache_flush(ctx_t * ctx) {
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        dmabuf_cache_evict(ctx, &ctx->egl.dmabuf_cache[i]);
+    }
+}
+
+bool wlm_egl_dmabuf_cache_key(dmabuf_t * dmabuf, dmabuf_cache_entry_t * key) {
+    // identify buffers by the inode of their dmabuf fds
+    // - the inode stays unique while the cached EGLImage references the buffer
+    for (size_t i = 0; i < dmabuf->planes; i++) {
+        struct stat st;
+        if (fstat(dmabuf->fds[i], &st) == -1) {
+            return false;
+        }
+
+        key->devs[i] = st.st_dev;
+        key->inodes[i] = st.st_ino;
+        key->offsets[i] = dmabuf->offsets[i];
+        key->strides[i] = dmabuf->strides[i];
+    }
+
+    key->planes = dmabuf->planes;
+    key->width = dmabuf->width;
+    key->height = dmabuf->height;
+    key->drm_format = dmabuf->drm_format;
+    key->modifier = dmabuf->modifier;
+    return true;
+}
+
+bool wlm_egl_dmabuf_cache_key_equal(const dmabuf_cache_entry_t * entry, const dmabuf_cache_entry_t * key) {
+    if (
+        entry->planes != key->planes ||
+        entry->width != key->width ||
+        entry->height != key->height ||
+        entry->drm_format != key->drm_format ||
+        entry->modifier != key->modifier
+    ) {
+        return false;
+    }
+
+    for (size_t i = 0; i < key->planes; i++) {
+        if (
+            entry->devs[i] != key->devs[i] ||
+            entry->inodes[i] != key->inodes[i] ||
+            entry->offsets[i] != key->offsets[i] ||
+            entry->strides[i] != key->strides[i]
+        ) {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-    if (frame_image == EGL_NO_IMAGE) {
-        wlm_log_error("egl::dmabuf_to_texture(): failed to create EGL image from dmabuf: error = %x\n", eglGetError());
+static dmabuf_cache_entry_t * dmabuf_cache_lookup(ctx_t * ctx, const dmabuf_cache_entry_t * key) {
+    dmabuf_cache_entry_t * found = NULL;
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        dmabuf_cache_entry_t * entry = &ctx->egl.dmabuf_cache[i];
+        if (!entry->valid) continue;
+
+        // drop all entries when the frame size or format changes
+        // - the compositor has replaced its swapchain
+        if (entry->width != key->width || entry->height != key->height || entry->drm_format != key->drm_format) {
+            wlm_log_debug(ctx, "egl::dmabuf_cache_lookup(): frame parameters changed, flushing cache\n");
+            dmabuf_cache_flush(ctx);
+            return NULL;
+        }
+
+        if (wlm_egl_dmabuf_cache_key_equal(entry, key)) {
+            found = entry;
+        }
+    }
+
+    return found;
+}
+
+static dmabuf_cache_entry_t * dmabuf_cache_insert(ctx_t * ctx, const dmabuf_cache_entry_t * key) {
+    // reuse a free entry or evict the least recently used one
+    dmabuf_cache_entry_t * entry = &ctx->egl.dmabuf_cache[0];
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        dmabuf_cache_entry_t * candidate = &ctx->egl.dmabuf_cache[i];
+        if (!candidate->valid) {
+            entry = candidate;
+            break;
+        } else if (candidate->last_used < entry->last_used) {
+            entry = candidate;
+        }
+    }
+
+    dmabuf_cache_evict(ctx, entry);
+    *entry = *key;
+    entry->image = EGL_NO_IMAGE;
+    entry->texture = 0;
+    entry->last_used = 0;
+    entry->valid = false;
+    return entry;
+}
+
+static GLint gl_format_from_drm(uint32_t drm_format);
+
+bool wlm_egl_dmabuf_to_texture(ctx_t * ctx, dmabuf_t * dmabuf) {
+    if (dmabuf->planes > MAX_PLANES) {
+        wlm_log_error("egl::dmabuf_to_texture(): too many planes, got %zd, can support at most %d\n", dmabuf->planes, MAX_PLANES);
+        return false;
+    }
+
+    dmabuf_cache_entry_t key;
+    if (!wlm_egl_dmabuf_cache_key(dmabuf, &key)) {
+        wlm_log_error("egl::dmabuf_to_texture(): failed to stat dmabuf fd\n");
         return false;
     }
 
-    // convert EGLImage to GL texture
+    // import buffer only if it was not seen before
+    dmabuf_cache_entry_t * entry = dmabuf_cache_lookup(ctx, &key);
+    if (entry == NULL) {
+        EGLImage image = wlm_egl_dmabuf_create_image(ctx, dmabuf);
+        if (image == EGL_NO_IMAGE) {
+            return false;
+        }
+
+        entry = dmabuf_cache_insert(ctx, &key);
+        entry->image = image;
+
+        // convert EGLImage to GL texture
+        glGenTextures(1, &entry->texture);
+        set_texture_filter(ctx, entry->texture);
+        ctx->egl.glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+        entry->valid = true;
+        ctx->egl.import_draw_pending = true;
+    }
+
+    entry->last_used = ++ctx->egl.dmabuf_cache_clock;
+    ctx->egl.format = gl_format_from_drm(dmabuf->drm_format);
+    ctx->egl.current_texture = entry->texture;
+    ctx->egl.dirty = true;
+
+    return true;
+}
+
+// --- use_imported_texture ---
+
+void wlm_egl_use_imported_texture(ctx_t * ctx, GLuint texture, uint32_t drm_format, bool new_image) {
+    // texture was imported on the shared import context
+    // - scaling filter may have changed since it was created
+    set_texture_filter(ctx, texture);
+    ctx->egl.format = gl_format_from_drm(drm_format);
+    if (new_image) ctx->egl.import_draw_pending = true;
+    ctx->egl.current_texture = texture;
+    ctx->egl.dirty = true;
+}
+
+// --- shm_to_texture ---
+
+typedef struct {
+    uint32_t shm_format;
+    uint32_t bpp;
+    GLint gl_format;
+    GLint gl_type;
+    GLenum gl_internal_format;
+} shm_gl_format_t;
+
+static const shm_gl_format_t shm_gl_formats[] = {
+    {
+        .shm_format = WL_SHM_FORMAT_ARGB8888,
+        .bpp = 32,
+        .gl_format = GL_BGRA_EXT,
+        .gl_type = GL_UNSIGNED_BYTE,
+        .gl_internal_format = GL_BGRA8_EXT,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_XRGB8888,
+        .bpp = 32,
+        .gl_format = GL_BGRA_EXT,
+        .gl_type = GL_UNSIGNED_BYTE,
+        .gl_internal_format = GL_BGRA8_EXT,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_XBGR8888,
+        .bpp = 32,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_BYTE,
+        .gl_internal_format = GL_RGBA8_OES,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_ABGR8888,
+        .bpp = 32,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_BYTE,
+        .gl_internal_format = GL_RGBA8_OES,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_BGR888,
+        .bpp = 24,
+        .gl_format = GL_RGB,
+        .gl_type = GL_UNSIGNED_BYTE,
+        .gl_internal_format = GL_RGB8_OES,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_RGBX4444,
+        .bpp = 16,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_SHORT_4_4_4_4,
+        .gl_internal_format = GL_RGBA4,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_RGBA4444,
+        .bpp = 16,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_SHORT_4_4_4_4,
+        .gl_internal_format = GL_RGBA4,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_RGBX5551,
+        .bpp = 16,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_SHORT_5_5_5_1,
+        .gl_internal_format = GL_RGB5_A1,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_RGBA5551,
+        .bpp = 16,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_SHORT_5_5_5_1,
+        .gl_internal_format = GL_RGB5_A1,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_RGB565,
+        .bpp = 16,
+        .gl_format = GL_RGB,
+        .gl_type = GL_UNSIGNED_SHORT_5_6_5,
+        .gl_internal_format = GL_RGB565,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_XBGR2101010,
+        .bpp = 32,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_INT_2_10_10_10_REV_EXT,
+        .gl_internal_format = GL_RGB10_A2_EXT,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_ABGR2101010,
+        .bpp = 32,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_UNSIGNED_INT_2_10_10_10_REV_EXT,
+        .gl_internal_format = GL_RGB10_A2_EXT,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_XBGR16161616F,
+        .bpp = 64,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_HALF_FLOAT_OES,
+        .gl_internal_format = 0,
+    },
+    {
+        .shm_format = WL_SHM_FORMAT_ABGR16161616F,
+        .bpp = 64,
+        .gl_format = GL_RGBA,
+        .gl_type = GL_HALF_FLOAT_OES,
+        .gl_internal_format = 0,
+    },
+    {
+        .shm_format = -1U,
+        .bpp = -1U,
+        .gl_format = -1,
+        .gl_type = -1,
+        .gl_internal_format = 0
+    }
+};
+
+static const shm_gl_format_t * shm_gl_format_from_shm(uint32_t shm_format) {
+    const shm_gl_format_t * format = shm_gl_formats;
+    while (format->shm_format != -1U) {
+        if (format->shm_format == shm_format) {
+            return format;
+        }
+
+        format++;
+    }
+
+    return NULL;
+}
+
+// drm fourccs of the two formats wl_shm numbers differently
+#define DRM_FOURCC_ARGB8888 0x34325241
+#define DRM_FOURCC_XRGB8888 0x34325258
+
+static GLint gl_format_from_drm(uint32_t drm_format) {
+    // other wl_shm formats are defined as their drm fourcc
+    uint32_t shm_format = drm_format;
+    if (drm_format == DRM_FOURCC_ARGB8888) shm_format = WL_SHM_FORMAT_ARGB8888;
+    if (drm_format == DRM_FOURCC_XRGB8888) shm_format = WL_SHM_FORMAT_XRGB8888;
+
+    // formats without a GL upload format are still readable as RGBA
+    const shm_gl_format_t * format = shm_gl_format_from_shm(shm_format);
+    return format != NULL ? format->gl_format : GL_RGBA;
+}
+
+uint32_t wlm_egl_shm_format_bpp(uint32_t shm_format) {
+    const shm_gl_format_t * format = shm_gl_format_from_shm(shm_format);
+    if (format == NULL) {
+        return 0;
+    }
+
+    return format->bpp;
+}
+
+static void recreate_texture(ctx_t * ctx) {
+    // immutable texture storage cannot be respecified, replace the texture object
+    GLuint old_texture = ctx->egl.texture;
+    glGenTextures(1, &ctx->egl.texture);
+    set_texture_filter(ctx, ctx->egl.texture);
+    if (ctx->egl.current_texture == old_texture) ctx->egl.current_texture = ctx->egl.texture;
+    glDeleteTextures(1, &old_texture);
+
+    ctx->egl.texture_immutable = false;
+}
+
+static bool upload_rects_pbo(ctx_t * ctx,
+    const shm_gl_format_t * format, const uint8_t * data, uint32_t stride,
+    const region_t * rects, size_t rect_count
+) {
+    uint32_t pixel_size = format->bpp / 8;
+    if (rect_count == 0) {
+        return true;
+    }
+
+    // copy the rows spanned by all rectangles at once, keeping the source stride
+    // - rectangles are uploaded straight from their position in that copy
+    uint32_t min_y = rects[0].y;
+    uint32_t max_y = rects[0].y + rects[0].height;
+    for (size_t i = 1; i < rect_count; i++) {
+        if (rects[i].y < min_y) min_y = rects[i].y;
+        if (rects[i].y + rects[i].height > max_y) max_y = rects[i].y + rects[i].height;
+    }
+
+    size_t total_size = (size_t)(max_y - min_y) * stride;
+    if (total_size == 0) {
+        return true;
+    }
+
+    // cycle through pixel unpack buffers so the driver can still read the previous ones
+    size_t index = ctx->egl.upload_pbo_index;
+    ctx->egl.upload_pbo_index = (index + 1) % UPLOAD_PBO_COUNT;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ctx->egl.upload_pbos[index]);
+    if (ctx->egl.upload_pbo_sizes[index] < total_size) {
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, total_size, NULL, GL_STREAM_DRAW);
+        ctx->egl.upload_pbo_sizes[index] = total_size;
+    }
+
+    uint8_t * dest = ctx->egl.glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+        0, total_size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT
+    );
+    if (dest == NULL) {
+        wlm_log_error("egl::upload_rects_pbo(): failed to map pixel unpack buffer\n");
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+
+    memcpy(dest, data + (size_t)min_y * stride, total_size);
+    ctx->egl.glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    // upload from buffer offsets instead of client memory
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / pixel_size);
+    for (size_t i = 0; i < rect_count; i++) {
+        const region_t * rect = &rects[i];
+        size_t offset = (size_t)(rect->y - min_y) * stride + (size_t)rect->x * pixel_size;
+        glTexSubImage2D(GL_TEXTURE_2D,
+            0, rect->x, rect->y, rect->width, rect->height,
+            format->gl_format, format->gl_type, (const void *)(uintptr_t)offset
+        );
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+bool wlm_egl_shm_to_texture(ctx_t * ctx,
+    const uint8_t * data, uint32_t width, uint32_t height, uint32_t stride, uint32_t shm_format,
+    const region_t * rects, size_t rect_count
+) {
+    // find correct texture format
+    const shm_gl_format_t * format = shm_gl_format_from_shm(shm_format);
+    if (format == NULL) {
+        wlm_log_error("egl::shm_to_texture(): failed to find GL format for shm format\n");
+        return false;
+    }
+
+    uint32_t pixel_size = format->bpp / 8;
+    bool use_storage = (
+        ctx->egl.gles3 && format->gl_internal_format != 0 &&
+        format->gl_internal_format != ctx->egl.storage_rejected_format
+    );
+    GLenum storage_format = use_storage ? format->gl_internal_format : (GLenum)format->gl_format;
+
+    // (re)allocate texture storage only when size or format change
+    // - new storage always needs a complete upload
+    wlm_egl_gpu_timer_begin(ctx, GPU_TIMER_UPLOAD);
     glBindTexture(GL_TEXTURE_2D, ctx->egl.texture);
-    ctx->egl.glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, frame_image);
+    if (
+        ctx->egl.storage_width != width ||
+        ctx->egl.storage_height != height ||
+        ctx->egl.storage_format != storage_format
+    ) {
+        if (ctx->egl.texture_immutable) {
+            recreate_texture(ctx);
+        }
+
+        if (use_storage) {
+            // clear stale errors so only errors from glTexStorage2D are seen
+            for (size_t i = 0; i < GL_ERROR_DRAIN_LIMIT && glGetError() != GL_NO_ERROR; i++);
+            ctx->egl.glTexStorage2D(GL_TEXTURE_2D, 1, format->gl_internal_format, width, height);
+            if (glGetError() == GL_NO_ERROR) {
+                ctx->egl.texture_immutable = true;
+            } else {
+                // don't retry on every frame, later frames must match the fallback storage format
+                wlm_log_debug(ctx, "egl::shm_to_texture(): failed to allocate immutable texture storage, using OpenGL ES 2.0 upload path\n");
+                ctx->egl.storage_rejected_format = format->gl_internal_format;
+                use_storage = false;
+                storage_format = format->gl_format;
+            }
+        }
+
+        ctx->egl.storage_width = width;
+        ctx->egl.storage_height = height;
+        ctx->egl.storage_format = storage_format;
+        rects = NULL;
+    }
+
+    region_t full_rect = { .x = 0, .y = 0, .width = width, .height = height };
+    if (use_storage) {
+        // upload through pixel unpack buffers
+        if (rects == NULL) {
+            rects = &full_rect;
+            rect_count = 1;
+        }
 
-    // destroy temporary image
-    eglDestroyImage(ctx->egl.display, frame_image);
+        if (!upload_rects_pbo(ctx, format, data, stride, rects, rect_count)) {
+            wlm_egl_gpu_timer_end(ctx, GPU_TIMER_UPLOAD);
+            return false;
+        }
+    } else {
+        // upload directly from client memory
+        glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / pixel_size);
+        if (rects == NULL) {
+            glTexImage2D(GL_TEXTURE_2D,
+                0, format->gl_format, width, height,
+                0, format->gl_format, format->gl_type, data
+            );
+        } else {
+            for (size_t i = 0; i < rect_count; i++) {
+                const region_t * rect = &rects[i];
+                glTexSubImage2D(GL_TEXTURE_2D,
+                    0, rect->x, rect->y, rect->width, rect->height,
+                    format->gl_format, format->gl_type,
+                    data + (size_t)rect->y * stride + (size_t)rect->x * pixel_size
+                );
+            }
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+    }
+    wlm_egl_gpu_timer_end(ctx, GPU_TIMER_UPLOAD);
 
+    ctx->egl.format = format->gl_format;
+    ctx->egl.current_texture = ctx->egl.texture;
+    ctx->egl.dirty = true;
     return true;
 }
 
@@ -546,10 +1278,18 @@ void wlm_egl_cleanup(ctx_t *ctx) {
 
     wlm_log_debug(ctx, "egl::cleanup(): destroying EGL objects\n");
 
+    dmabuf_cache_flush(ctx);
+    if (ctx->egl.draw_fence != EGL_NO_SYNC_KHR) ctx->egl.eglDestroySyncKHR(ctx->egl.display, ctx->egl.draw_fence);
+    if (ctx->egl.timer_query) {
+        for (size_t i = 0; i < GPU_TIMER_COUNT; i++) {
+            ctx->egl.glDeleteQueriesEXT(GPU_TIMER_QUERIES, ctx->egl.gpu_timers[i].queries);
+        }
+    }
     if (ctx->egl.shader_program != 0) glDeleteProgram(ctx->egl.shader_program);
     if (ctx->egl.freeze_framebuffer != 0) glDeleteFramebuffers(1, &ctx->egl.freeze_framebuffer);
     if (ctx->egl.freeze_texture != 0) glDeleteTextures(1, &ctx->egl.freeze_texture);
     if (ctx->egl.texture != 0) glDeleteTextures(1, &ctx->egl.texture);
+    if (ctx->egl.gles3) glDeleteBuffers(UPLOAD_PBO_COUNT, ctx->egl.upload_pbos);
     if (ctx->egl.vbo != 0) glDeleteBuffers(1, &ctx->egl.vbo);
     if (ctx->egl.context != EGL_NO_CONTEXT) eglDestroyContext(ctx->egl.display, ctx->egl.context);
     if (ctx->egl.surface != EGL_NO_SURFACE) eglDestroySurface(ctx->egl.display, ctx->egl.surface);
@@ -1,6 +1,8 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
 #include <wlm/context.h>
 #include <wlm/event.h>
 
@@ -35,18 +37,128 @@ static void call_each_handler(ctx_t * ctx) {
 }
 
 
-static event_handler_t * min_timeout(ctx_t * ctx) {
-    event_handler_t * min = NULL;
-    event_handler_t * cur = ctx->event.handlers;
-    while (cur != NULL) {
-        if (cur->timeout_ms != -1) {
-            if (min == NULL || cur->timeout_ms < min->timeout_ms) min = cur;
+// --- timer heap ---
+
+static bool timer_before(const event_timer_t * a, const event_timer_t * b) {
+    return a->deadline_ns < b->deadline_ns;
+}
+
+static void heap_swap(ctx_t * ctx, size_t i, size_t j) {
+    event_timer_t * tmp = ctx->event.timers[i];
+    ctx->event.timers[i] = ctx->event.timers[j];
+    ctx->event.timers[j] = tmp;
+
+    ctx->event.timers[i]->heap_index = i;
+    ctx->event.timers[j]->heap_index = j;
+}
+
+static void heap_sift_up(ctx_t * ctx, size_t i) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!timer_before(ctx->event.timers[i], ctx->event.timers[parent])) break;
+
+        heap_swap(ctx, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(ctx_t * ctx, size_t i) {
+    size_t len = ctx->event.timers_len;
+    while (true) {
+        size_t min = i;
+        size_t left = 2 * i + 1;
+        size_t right = 2 * i + 2;
+        if (left < len && timer_before(ctx->event.timers[left], ctx->event.timers[min])) min = left;
+        if (right < len && timer_before(ctx->event.timers[right], ctx->event.timers[min])) min = right;
+        if (min == i) break;
+
+        heap_swap(ctx, i, min);
+        i = min;
+    }
+}
+
+static void heap_remove(ctx_t * ctx, event_timer_t * timer) {
+    size_t i = timer->heap_index;
+    size_t last = --ctx->event.timers_len;
+    if (i != last) {
+        heap_swap(ctx, i, last);
+        heap_sift_down(ctx, i);
+        heap_sift_up(ctx, i);
+    }
+
+    ctx->event.timers[last] = NULL;
+    timer->armed = false;
+}
+
+static void update_timerfd(ctx_t * ctx) {
+    // zero disarms the timerfd
+    // - deadlines in the past expire right away
+    struct itimerspec timer = {
+        .it_interval = { .tv_sec = 0, .tv_nsec = 0 },
+        .it_value = { .tv_sec = 0, .tv_nsec = 0 }
+    };
+    if (ctx->event.timers_len > 0) {
+        uint64_t deadline_ns = ctx->event.timers[0]->deadline_ns;
+        if (deadline_ns == 0) deadline_ns = 1;
+
+        timer.it_value.tv_sec = deadline_ns / 1000000000;
+        timer.it_value.tv_nsec = deadline_ns % 1000000000;
+    }
+
+    if (timerfd_settime(ctx->event.timer_handler.fd, TFD_TIMER_ABSTIME, &timer, NULL) == -1) {
+        wlm_log_error("event::update_timerfd(): failed to arm timerfd\n");
+        wlm_exit_fail(ctx);
+    }
+}
+
+// --- timers ---
+
+uint64_t wlm_event_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void wlm_event_timer_init(event_timer_t * timer, event_priority_t priority, void (*on_timer)(ctx_t * ctx)) {
+    timer->deadline_ns = 0;
+    timer->priority = priority;
+    timer->on_timer = on_timer;
+    timer->heap_index = 0;
+    timer->armed = false;
+    timer->pending = false;
+}
+
+void wlm_event_timer_arm(ctx_t * ctx, event_timer_t * timer, uint64_t deadline_ns) {
+    timer->pending = false;
+    if (timer->armed) {
+        // move armed timer to its new deadline
+        timer->deadline_ns = deadline_ns;
+        heap_sift_down(ctx, timer->heap_index);
+        heap_sift_up(ctx, timer->heap_index);
+    } else {
+        if (ctx->event.timers_len == EVENT_MAX_TIMERS) {
+            wlm_log_error("event::timer_arm(): too many armed timers\n");
+            wlm_exit_fail(ctx);
         }
 
-        cur = cur->next;
+        size_t i = ctx->event.timers_len++;
+        timer->deadline_ns = deadline_ns;
+        timer->heap_index = i;
+        timer->armed = true;
+        ctx->event.timers[i] = timer;
+        heap_sift_up(ctx, i);
     }
 
-    return min;
+    update_timerfd(ctx);
+}
+
+void wlm_event_timer_disarm(ctx_t * ctx, event_timer_t * timer) {
+    // expired timer must not be called after being disarmed in the same iteration
+    timer->pending = false;
+    if (!timer->armed) return;
+
+    heap_remove(ctx, timer);
+    update_timerfd(ctx);
 }
 
 void wlm_event_add_fd(ctx_t * ctx, event_handler_t * handler) {
@@ -60,6 +172,7 @@ void wlm_event_add_fd(ctx_t * ctx, event_handler_t * handler) {
     }
 
     add_handler(ctx, handler);
+    handler->registered = true;
 }
 
 void wlm_event_change_fd(ctx_t * ctx, event_handler_t * handler) {
@@ -80,36 +193,113 @@ void wlm_event_remove_fd(ctx_t * ctx, event_handler_t * handler) {
 
     remove_handler(ctx, handler->fd);
     handler->next = NULL;
+    handler->registered = false;
 }
 
+// --- event loop ---
+
+typedef struct {
+    event_priority_t priority;
+    event_handler_t * handler;
+    event_timer_t * timer;
+} ready_event_t;
+
 #define MAX_EVENTS 10
+#define MAX_READY_EVENTS (MAX_EVENTS + EVENT_MAX_TIMERS)
+
+static size_t collect_timers(ctx_t * ctx, ready_event_t * ready, size_t num_ready) {
+    uint64_t expirations;
+    if (read(ctx->event.timer_handler.fd, &expirations, sizeof expirations) == -1 && errno != EAGAIN) {
+        wlm_log_error("event::collect_timers(): failed to read timerfd\n");
+    }
+
+    // pop every expired timer, not only the one the timerfd was armed for
+    uint64_t now = wlm_event_now_ns();
+    while (ctx->event.timers_len > 0 && ctx->event.timers[0]->deadline_ns <= now) {
+        event_timer_t * timer = ctx->event.timers[0];
+        heap_remove(ctx, timer);
+        timer->pending = true;
+
+        ready[num_ready++] = (ready_event_t){ .priority = timer->priority, .handler = NULL, .timer = timer };
+    }
+
+    update_timerfd(ctx);
+    return num_ready;
+}
+
+static void sort_ready(ready_event_t * ready, size_t num_ready) {
+    // stable insertion sort, there are only a few ready events
+    for (size_t i = 1; i < num_ready; i++) {
+        ready_event_t cur = ready[i];
+        size_t j = i;
+        while (j > 0 && ready[j - 1].priority > cur.priority) {
+            ready[j] = ready[j - 1];
+            j--;
+        }
+        ready[j] = cur;
+    }
+}
+
 void wlm_event_loop(ctx_t * ctx) {
     struct epoll_event events[MAX_EVENTS];
+    ready_event_t ready[MAX_READY_EVENTS];
     int num_events;
 
-    event_handler_t * timeout_handler;
-    int timeout_ms;
-
-    timeout_handler = min_timeout(ctx);
-    timeout_ms = timeout_handler == NULL ? -1 : timeout_handler->timeout_ms;
+    while (!ctx->wl.closing) {
+        num_events = epoll_wait(ctx->event.pollfd, events, MAX_EVENTS, -1);
+        if (num_events == -1 && errno == EINTR) {
+            continue;
+        } else if (num_events == -1) {
+            wlm_log_error("event::loop(): failed to wait for events\n");
+            break;
+        }
 
-    while ((num_events = epoll_wait(ctx->event.pollfd, events, MAX_EVENTS, timeout_ms)) != -1 && !ctx->wl.closing) {
+        // collect ready handlers and expired timers
+        size_t num_ready = 0;
         for (int i = 0; i < num_events; i++) {
             event_handler_t * handler = (event_handler_t *)events[i].data.ptr;
-            handler->on_event(ctx);
+            if (handler == &ctx->event.timer_handler) {
+                num_ready = collect_timers(ctx, ready, num_ready);
+            } else {
+                ready[num_ready++] = (ready_event_t){ .priority = handler->priority, .handler = handler, .timer = NULL };
+            }
         }
 
-        if (num_events == 0 && timeout_handler != NULL) {
-            timeout_handler->on_event(ctx);
+        // handle control input and wayland events before rendering
+        sort_ready(ready, num_ready);
+        for (size_t i = 0; i < num_ready && !ctx->wl.closing; i++) {
+            if (ready[i].handler != NULL) {
+                // handler may have been removed by an earlier handler
+                if (!ready[i].handler->registered) continue;
+                ready[i].handler->on_event(ctx);
+            } else {
+                // timer may have been rearmed or disarmed by an earlier handler
+                if (!ready[i].timer->pending) continue;
+                ready[i].timer->pending = false;
+                ready[i].timer->on_timer(ctx);
+            }
         }
 
-        timeout_handler = min_timeout(ctx);
-        timeout_ms = timeout_handler == NULL ? -1 : timeout_handler->timeout_ms;
         call_each_handler(ctx);
     }
 }
 
 void wlm_event_init(ctx_t * ctx) {
+    ctx->event.pollfd = -1;
+    ctx->event.handlers = NULL;
+
+    ctx->event.timer_handler.next = NULL;
+    ctx->event.timer_handler.fd = -1;
+    ctx->event.timer_handler.events = EPOLLIN;
+    ctx->event.timer_handler.priority = EVENT_PRIORITY_CONTROL;
+    ctx->event.timer_handler.on_event = NULL;
+    ctx->event.timer_handler.on_each = NULL;
+    ctx->event.timer_handler.registered = false;
+    for (size_t i = 0; i < EVENT_MAX_TIMERS; i++) {
+        ctx->event.timers[i] = NULL;
+    }
+    ctx->event.timers_len = 0;
+
     ctx->event.pollfd = epoll_create(1);
     if (ctx->event.pollfd == -1) {
         wlm_log_error("event::init(): failed to create epoll instance\n");
@@ -117,10 +307,18 @@ void wlm_event_init(ctx_t * ctx) {
         return;
     }
 
-    ctx->event.handlers = NULL;
     ctx->event.initialized = true;
+
+    // create timerfd shared by all timers
+    ctx->event.timer_handler.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ctx->event.timer_handler.fd == -1) {
+        wlm_log_error("event::init(): failed to create timerfd\n");
+        wlm_exit_fail(ctx);
+    }
+    wlm_event_add_fd(ctx, &ctx->event.timer_handler);
 }
 
 void wlm_event_cleanup(ctx_t * ctx) {
+    if (ctx->event.timer_handler.fd != -1) close(ctx->event.timer_handler.fd);
     close(ctx->event.pollfd);
 }
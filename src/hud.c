@@ -0,0 +1,500 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <wlm/context.h>
+#include <wlm/hud.h>
+#include <wlm/glsl/hud_vertex_shader.h>
+#include <wlm/glsl/hud_fragment_shader.h>
+#include <wlm/font/hud.h>
+
+// layout in HUD pixels, scaled by an integer factor on screen
+#define HUD_MARGIN 4
+#define HUD_PADDING 3
+#define HUD_GRAPH_HEIGHT 24
+#define HUD_LINE_SPACING 2
+#define HUD_GLYPH_SPACING 1
+
+// two triangles per quad, position and texture coordinate per vertex
+#define QUAD_FLOATS (6 * 4)
+
+// panel and reference line before the graph bars
+#define GRAPH_QUADS (2 + HUD_GRAPH_SAMPLES)
+
+// --- font loading ---
+
+static bool parse_glyph_name(const char * name, unsigned char * c) {
+    if (strcmp(name, "space") == 0) {
+        *c = ' ';
+        return true;
+    } else if (strlen(name) == 1 && (unsigned char)name[0] < 128) {
+        *c = (unsigned char)name[0];
+        return true;
+    } else {
+        return false;
+    }
+}
+
+static uint8_t * load_font(ctx_t * ctx, const char * font) {
+    // glyph pixels, one glyph after another until the atlas layout is known
+    uint8_t * glyphs = NULL;
+    uint32_t rows_left = 0;
+    uint8_t * row = NULL;
+    size_t line_number = 0;
+
+    const char * next = font;
+    while (*next != '\0') {
+        const char * line = next;
+        size_t length = strcspn(line, "\n");
+        next = line[length] == '\n' ? line + length + 1 : line + length;
+        line_number++;
+
+        // comments and empty lines are only allowed between glyphs
+        if (rows_left == 0 && (length == 0 || line[0] == ';')) continue;
+
+        char buffer[64];
+        if (length >= sizeof buffer) goto invalid;
+        memcpy(buffer, line, length);
+        buffer[length] = '\0';
+
+        if (rows_left > 0) {
+            // one row of the current glyph
+            if (length != ctx->hud.glyph_width) goto invalid;
+            for (size_t x = 0; x < length; x++) {
+                if (buffer[x] != 'X' && buffer[x] != '.') goto invalid;
+                row[x] = buffer[x] == 'X' ? 0xff : 0x00;
+            }
+
+            row += ctx->hud.glyph_width;
+            rows_left--;
+            continue;
+        }
+
+        uint32_t width, height;
+        char name[16];
+        unsigned char c;
+        if (sscanf(buffer, "size %u %u", &width, &height) == 2) {
+            if (glyphs != NULL || width == 0 || height == 0 || width > 32 || height > 32) goto invalid;
+            ctx->hud.glyph_width = width;
+            ctx->hud.glyph_height = height;
+
+            glyphs = calloc(128, width * height);
+            if (glyphs == NULL) {
+                wlm_log_error("hud::load_font(): failed to allocate glyphs\n");
+                return NULL;
+            }
+        } else if (sscanf(buffer, "glyph %15s", name) == 1 && parse_glyph_name(name, &c)) {
+            if (glyphs == NULL || ctx->hud.glyph_index[c] != -1) goto invalid;
+            ctx->hud.glyph_index[c] = ctx->hud.glyph_count;
+            row = glyphs + ctx->hud.glyph_count * ctx->hud.glyph_width * ctx->hud.glyph_height;
+            rows_left = ctx->hud.glyph_height;
+            ctx->hud.glyph_count++;
+        } else {
+            goto invalid;
+        }
+    }
+
+    if (glyphs == NULL || rows_left > 0 || ctx->hud.glyph_count == 0) goto invalid;
+
+    // lay out glyphs next to each other in a single row
+    uint32_t atlas_width = ctx->hud.glyph_count * ctx->hud.glyph_width;
+    uint8_t * atlas = malloc(atlas_width * ctx->hud.glyph_height);
+    if (atlas == NULL) {
+        wlm_log_error("hud::load_font(): failed to allocate font atlas\n");
+        free(glyphs);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < ctx->hud.glyph_count; i++) {
+        for (uint32_t y = 0; y < ctx->hud.glyph_height; y++) {
+            memcpy(
+                atlas + y * atlas_width + i * ctx->hud.glyph_width,
+                glyphs + (i * ctx->hud.glyph_height + y) * ctx->hud.glyph_width,
+                ctx->hud.glyph_width
+            );
+        }
+    }
+
+    free(glyphs);
+    return atlas;
+
+invalid:
+    wlm_log_error("hud::load_font(): invalid font data on line %zu\n", line_number);
+    free(glyphs);
+    return NULL;
+}
+
+// --- gl helpers ---
+
+static GLuint compile_shader(GLenum type, const char * source, const char * name) {
+    GLint success;
+    char errorLog[1024] = { 0 };
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (success != GL_TRUE) {
+        glGetShaderInfoLog(shader, sizeof errorLog, NULL, errorLog);
+        errorLog[strcspn(errorLog, "\n")] = '\0';
+        wlm_log_error("hud::init(): failed to compile %s shader: %s\n", name, errorLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static void set_vertex_layout(void) {
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (float), (void *)(0 * sizeof (float)));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof (float), (void *)(2 * sizeof (float)));
+}
+
+static float * emit_quad(float * out, float x, float y, float width, float height, float u0, float u1) {
+    const float quad[] = {
+        x,         y + height, u0, 1.0,
+        x + width, y + height, u1, 1.0,
+        x,         y,          u0, 0.0,
+        x,         y,          u0, 0.0,
+        x + width, y + height, u1, 1.0,
+        x + width, y,          u1, 0.0
+    };
+    memcpy(out, quad, sizeof quad);
+    return out + QUAD_FLOATS;
+}
+
+static uint32_t hud_scale(ctx_t * ctx) {
+    uint32_t scale = ceil(ctx->wl.scale * 2);
+    return scale > 0 ? scale : 1;
+}
+
+// --- text ---
+
+static void set_text(ctx_t * ctx, const char * text) {
+    float vertices[HUD_TEXT_LENGTH * QUAD_FLOATS];
+    float * out = vertices;
+
+    float advance = ctx->hud.glyph_width + HUD_GLYPH_SPACING;
+    float line_height = ctx->hud.glyph_height + HUD_LINE_SPACING;
+    float glyph_u = 1.0 / ctx->hud.glyph_count;
+
+    uint32_t column = 0;
+    uint32_t line = 0;
+    ctx->hud.text_columns = 0;
+    for (const char * c = text; *c != '\0' && out < vertices + HUD_TEXT_LENGTH * QUAD_FLOATS; c++) {
+        if (*c == '\n') {
+            column = 0;
+            line++;
+            continue;
+        }
+
+        // characters without a glyph leave a gap
+        unsigned char upper = toupper((unsigned char)*c);
+        int16_t index = upper < 128 ? ctx->hud.glyph_index[upper] : -1;
+        if (index >= 0) {
+            out = emit_quad(out,
+                HUD_MARGIN + HUD_PADDING + column * advance, HUD_MARGIN + HUD_PADDING + line * line_height,
+                ctx->hud.glyph_width, ctx->hud.glyph_height,
+                index * glyph_u, (index + 1) * glyph_u
+            );
+        }
+
+        column++;
+        if (column > ctx->hud.text_columns) ctx->hud.text_columns = column;
+    }
+
+    ctx->hud.text_lines = line + 1;
+    ctx->hud.text_vertices = (out - vertices) / 4;
+
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->hud.text_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (out - vertices) * sizeof (float), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->egl.vbo);
+}
+
+static void update_text(ctx_t * ctx, uint64_t now_ns) {
+    double elapsed_s = (now_ns - ctx->hud.update_ns) / 1000000000.0;
+    uint64_t uploads = ctx->stats.uploaded_frames;
+    double capture_fps = elapsed_s > 0 ? (uploads - ctx->hud.update_uploads) / elapsed_s : 0;
+    double present_fps = elapsed_s > 0 ? (ctx->hud.draws - ctx->hud.update_draws) / elapsed_s : 0;
+
+    // average capture to present latency of the frames drawn since the last update
+    stats_histogram_t * total = &ctx->stats.stages[STATS_STAGE_TOTAL];
+    uint64_t samples = total->count - ctx->hud.update_latency_count;
+    if (samples > total->len) samples = total->len;
+    uint64_t latency_sum_us = 0;
+    for (uint64_t i = 0; i < samples; i++) {
+        latency_sum_us += total->samples_us[(total->next + STATS_WINDOW - 1 - i) % STATS_WINDOW];
+    }
+
+    char latency[16] = "N/A";
+    if (samples > 0) snprintf(latency, sizeof latency, "%.1f MS", latency_sum_us / 1000.0 / samples);
+
+    char text[HUD_TEXT_LENGTH];
+    snprintf(text, sizeof text,
+        "%s%s\n"
+        "CAPTURE %5.1f FPS\n"
+        "PRESENT %5.1f FPS\n"
+        "LATENCY %s\n"
+        "DROPPED %llu",
+        ctx->mirror.backend != NULL ? ctx->mirror.backend->name : "no backend",
+        ctx->opt.freeze ? " - frozen" : "",
+        capture_fps, present_fps, latency,
+        (unsigned long long)atomic_load(&ctx->stats.dropped_frames)
+    );
+    set_text(ctx, text);
+
+    ctx->hud.update_ns = now_ns;
+    ctx->hud.update_draws = ctx->hud.draws;
+    ctx->hud.update_uploads = uploads;
+    ctx->hud.update_latency_count = total->count;
+}
+
+// --- timer event handlers ---
+
+static void on_update_timer(ctx_t * ctx) {
+    uint64_t now = wlm_event_now_ns();
+    update_text(ctx, now);
+
+    // redraw even if nothing else changed
+    ctx->egl.dirty = true;
+    wlm_event_timer_arm(ctx, &ctx->hud.update_timer, now + HUD_UPDATE_INTERVAL_NS);
+}
+
+// --- init_hud ---
+
+void wlm_hud_init(ctx_t * ctx) {
+    // initialize context structure
+    for (size_t i = 0; i < 128; i++) {
+        ctx->hud.glyph_index[i] = -1;
+    }
+    ctx->hud.glyph_count = 0;
+    ctx->hud.glyph_width = 0;
+    ctx->hud.glyph_height = 0;
+
+    ctx->hud.shader_program = 0;
+    ctx->hud.font_texture = 0;
+    ctx->hud.text_vbo = 0;
+    ctx->hud.graph_vbo = 0;
+    ctx->hud.screen_size_uniform = 0;
+    ctx->hud.color_uniform = 0;
+    ctx->hud.textured_uniform = 0;
+    ctx->hud.text_vertices = 0;
+    ctx->hud.text_columns = 0;
+    ctx->hud.text_lines = 0;
+
+    for (size_t i = 0; i < HUD_GRAPH_SAMPLES; i++) {
+        ctx->hud.frame_times_ms[i] = 0;
+    }
+    ctx->hud.graph_next = 0;
+    ctx->hud.last_draw_ns = 0;
+
+    wlm_event_timer_init(&ctx->hud.update_timer, EVENT_PRIORITY_RENDER, on_update_timer);
+    ctx->hud.update_ns = 0;
+    ctx->hud.draws = 0;
+    ctx->hud.update_draws = 0;
+    ctx->hud.update_uploads = 0;
+    ctx->hud.update_latency_count = 0;
+
+    ctx->hud.available = false;
+    ctx->hud.initialized = true;
+
+    // the HUD is optional, failures only disable it
+    uint8_t * atlas = load_font(ctx, wlm_font_hud);
+    if (atlas == NULL) {
+        wlm_log_warn("hud::init(): failed to load HUD font, HUD unavailable\n");
+        return;
+    }
+
+    // upload font atlas
+    // - glyph coverage is stored in every color channel
+    glGenTextures(1, &ctx->hud.font_texture);
+    glBindTexture(GL_TEXTURE_2D, ctx->hud.font_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE,
+        ctx->hud.glyph_count * ctx->hud.glyph_width, ctx->hud.glyph_height, 0,
+        GL_LUMINANCE, GL_UNSIGNED_BYTE, atlas
+    );
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    free(atlas);
+
+    // create vertex buffers
+    // - text is rewritten on every text update
+    // - the graph is rewritten on every draw
+    glGenBuffers(1, &ctx->hud.text_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->hud.text_vbo);
+    glBufferData(GL_ARRAY_BUFFER, HUD_TEXT_LENGTH * QUAD_FLOATS * sizeof (float), NULL, GL_DYNAMIC_DRAW);
+    glGenBuffers(1, &ctx->hud.graph_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->hud.graph_vbo);
+    glBufferData(GL_ARRAY_BUFFER, GRAPH_QUADS * QUAD_FLOATS * sizeof (float), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->egl.vbo);
+
+    // compile shaders
+    GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, wlm_glsl_hud_vertex_shader, "vertex");
+    if (vertex_shader == 0) {
+        wlm_log_warn("hud::init(): HUD unavailable\n");
+        return;
+    }
+
+    GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, wlm_glsl_hud_fragment_shader, "fragment");
+    if (fragment_shader == 0) {
+        wlm_log_warn("hud::init(): HUD unavailable\n");
+        glDeleteShader(vertex_shader);
+        return;
+    }
+
+    // create shader program with the vertex layout of the mirror shader
+    GLint success;
+    ctx->hud.shader_program = glCreateProgram();
+    glAttachShader(ctx->hud.shader_program, vertex_shader);
+    glAttachShader(ctx->hud.shader_program, fragment_shader);
+    glBindAttribLocation(ctx->hud.shader_program, 0, "aPosition");
+    glBindAttribLocation(ctx->hud.shader_program, 1, "aTexCoord");
+    glLinkProgram(ctx->hud.shader_program);
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+    glGetProgramiv(ctx->hud.shader_program, GL_LINK_STATUS, &success);
+    if (success != GL_TRUE) {
+        wlm_log_error("hud::init(): failed to link shader program\n");
+        wlm_log_warn("hud::init(): HUD unavailable\n");
+        return;
+    }
+
+    ctx->hud.screen_size_uniform = glGetUniformLocation(ctx->hud.shader_program, "uScreenSize");
+    ctx->hud.color_uniform = glGetUniformLocation(ctx->hud.shader_program, "uColor");
+    ctx->hud.textured_uniform = glGetUniformLocation(ctx->hud.shader_program, "uTextured");
+    glUseProgram(ctx->egl.shader_program);
+
+    ctx->hud.available = true;
+    wlm_hud_update(ctx);
+}
+
+// --- update ---
+
+void wlm_hud_update(ctx_t * ctx) {
+    ctx->egl.dirty = true;
+
+    if (!ctx->opt.hud) {
+        wlm_event_timer_disarm(ctx, &ctx->hud.update_timer);
+        return;
+    } else if (!ctx->hud.available) {
+        wlm_log_warn("hud::update(): HUD unavailable\n");
+        return;
+    } else if (ctx->hud.update_timer.armed) {
+        return;
+    }
+
+    // start a new graph and measurement period
+    for (size_t i = 0; i < HUD_GRAPH_SAMPLES; i++) {
+        ctx->hud.frame_times_ms[i] = 0;
+    }
+    ctx->hud.graph_next = 0;
+    ctx->hud.last_draw_ns = 0;
+
+    uint64_t now = wlm_event_now_ns();
+    ctx->hud.update_ns = now;
+    ctx->hud.update_draws = ctx->hud.draws;
+    ctx->hud.update_uploads = ctx->stats.uploaded_frames;
+    ctx->hud.update_latency_count = ctx->stats.stages[STATS_STAGE_TOTAL].count;
+    update_text(ctx, now);
+
+    wlm_event_timer_arm(ctx, &ctx->hud.update_timer, now + HUD_UPDATE_INTERVAL_NS);
+}
+
+// --- draw ---
+
+void wlm_hud_draw(ctx_t * ctx) {
+    if (!ctx->opt.hud || !ctx->hud.available) return;
+
+    // present interval of the previous frame
+    uint64_t now = wlm_event_now_ns();
+    if (ctx->hud.last_draw_ns != 0) {
+        ctx->hud.frame_times_ms[ctx->hud.graph_next] = (now - ctx->hud.last_draw_ns) / 1000000.0;
+        ctx->hud.graph_next = (ctx->hud.graph_next + 1) % HUD_GRAPH_SAMPLES;
+    }
+    ctx->hud.last_draw_ns = now;
+    ctx->hud.draws++;
+
+    // panel around the text and the graph
+    float text_width = ctx->hud.text_columns * (ctx->hud.glyph_width + HUD_GLYPH_SPACING);
+    float text_height = ctx->hud.text_lines * (ctx->hud.glyph_height + HUD_LINE_SPACING);
+    float content_width = text_width > HUD_GRAPH_SAMPLES ? text_width : HUD_GRAPH_SAMPLES;
+    float graph_x = HUD_MARGIN + HUD_PADDING;
+    float graph_y = HUD_MARGIN + HUD_PADDING + text_height;
+
+    float vertices[GRAPH_QUADS * QUAD_FLOATS];
+    float * out = vertices;
+    out = emit_quad(out, HUD_MARGIN, HUD_MARGIN,
+        content_width + 2 * HUD_PADDING, text_height + HUD_GRAPH_HEIGHT + 2 * HUD_PADDING, 0, 0
+    );
+
+    // the graph spans two refresh intervals, the line marks one
+    double refresh_ms = ctx->mirror.refresh_ns != 0 ? ctx->mirror.refresh_ns / 1000000.0 : 1000.0 / 60;
+    out = emit_quad(out, graph_x, graph_y + HUD_GRAPH_HEIGHT / 2, HUD_GRAPH_SAMPLES, 1, 0, 0);
+    for (size_t i = 0; i < HUD_GRAPH_SAMPLES; i++) {
+        float frame_time_ms = ctx->hud.frame_times_ms[(ctx->hud.graph_next + i) % HUD_GRAPH_SAMPLES];
+        float height = fminf(frame_time_ms / (2 * refresh_ms), 1) * HUD_GRAPH_HEIGHT;
+        out = emit_quad(out, graph_x + i, graph_y + HUD_GRAPH_HEIGHT - height, 1, height, 0, 0);
+    }
+
+    // draw over the whole window, not only the mirrored image
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    uint32_t win_width = round(ctx->wl.width * ctx->wl.scale);
+    uint32_t win_height = round(ctx->wl.height * ctx->wl.scale);
+    float scale = hud_scale(ctx);
+    glViewport(0, 0, win_width, win_height);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(ctx->hud.shader_program);
+    glUniform2f(ctx->hud.screen_size_uniform, win_width / scale, win_height / scale);
+
+    // panel, graph bars, reference line
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->hud.graph_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof vertices, vertices);
+    set_vertex_layout();
+    glUniform1i(ctx->hud.textured_uniform, false);
+    glUniform4f(ctx->hud.color_uniform, 0.0, 0.0, 0.0, 0.6);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glUniform4f(ctx->hud.color_uniform, 0.3, 0.9, 0.3, 0.9);
+    glDrawArrays(GL_TRIANGLES, 12, 6 * HUD_GRAPH_SAMPLES);
+    glUniform4f(ctx->hud.color_uniform, 1.0, 1.0, 1.0, 0.5);
+    glDrawArrays(GL_TRIANGLES, 6, 6);
+
+    // text
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->hud.text_vbo);
+    set_vertex_layout();
+    glBindTexture(GL_TEXTURE_2D, ctx->hud.font_texture);
+    glUniform1i(ctx->hud.textured_uniform, true);
+    glUniform4f(ctx->hud.color_uniform, 1.0, 1.0, 1.0, 1.0);
+    glDrawArrays(GL_TRIANGLES, 0, ctx->hud.text_vertices);
+
+    // restore mirror draw state
+    glDisable(GL_BLEND);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glUseProgram(ctx->egl.shader_program);
+    glBindBuffer(GL_ARRAY_BUFFER, ctx->egl.vbo);
+    set_vertex_layout();
+}
+
+// --- cleanup_hud ---
+
+void wlm_hud_cleanup(ctx_t * ctx) {
+    if (!ctx->hud.initialized) return;
+
+    wlm_log_debug(ctx, "hud::cleanup(): destroying HUD objects\n");
+
+    wlm_event_timer_disarm(ctx, &ctx->hud.update_timer);
+    if (ctx->hud.shader_program != 0) glDeleteProgram(ctx->hud.shader_program);
+    if (ctx->hud.font_texture != 0) glDeleteTextures(1, &ctx->hud.font_texture);
+    if (ctx->hud.text_vbo != 0) glDeleteBuffers(1, &ctx->hud.text_vbo);
+    if (ctx->hud.graph_vbo != 0) glDeleteBuffers(1, &ctx->hud.graph_vbo);
+
+    ctx->hud.available = false;
+    ctx->hud.initialized = false;
+}
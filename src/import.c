@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <wlm/context.h>
+#include <wlm/import.h>
+
+// --- helpers ---
+
+static void notify_main(ctx_t * ctx, unsigned int notification) {
+    atomic_fetch_or(&ctx->import.notifications, notification);
+
+    uint64_t count = 1;
+    if (write(ctx->import.notify_handler.fd, &count, sizeof count) == -1 && errno != EAGAIN) {
+        wlm_log_error("import::notify_main(): failed to signal eventfd\n");
+    }
+}
+
+static void texture_release(ctx_t * ctx, import_texture_t * texture) {
+    if (texture->fence != EGL_NO_SYNC_KHR) {
+        ctx->import.eglDestroySyncKHR(ctx->egl.display, texture->fence);
+        texture->fence = EGL_NO_SYNC_KHR;
+    }
+
+    // texture may be reimported by the import thread from here on
+    atomic_store(&texture->in_use, false);
+}
+
+// --- image cache ---
+
+static EGLImage image_cache_get(ctx_t * ctx, dmabuf_t * dmabuf, bool * created) {
+    // compositors cycle through a small swapchain, images are reused like on the main thread
+    // - destroying an image does not affect textures still using it
+    dmabuf_cache_entry_t key;
+    if (!wlm_egl_dmabuf_cache_key(dmabuf, &key)) {
+        wlm_log_error("import::image_cache_get(): failed to stat dmabuf fd\n");
+        return EGL_NO_IMAGE;
+    }
+
+    dmabuf_cache_entry_t * entry = &ctx->import.image_cache[0];
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        dmabuf_cache_entry_t * candidate = &ctx->import.image_cache[i];
+        if (candidate->valid && wlm_egl_dmabuf_cache_key_equal(candidate, &key)) {
+            candidate->last_used = ++ctx->import.image_cache_clock;
+            *created = false;
+            return candidate->image;
+        }
+
+        // remember a free entry or the least recently used one
+        if (!entry->valid) continue;
+        if (!candidate->valid || candidate->last_used < entry->last_used) entry = candidate;
+    }
+
+    EGLImage image = wlm_egl_dmabuf_create_image(ctx, dmabuf);
+    if (image == EGL_NO_IMAGE) {
+        return EGL_NO_IMAGE;
+    }
+
+    if (entry->valid) eglDestroyImage(ctx->egl.display, entry->image);
+    *entry = key;
+    entry->image = image;
+    entry->texture = 0;
+    entry->last_used = ++ctx->import.image_cache_clock;
+    entry->valid = true;
+    *created = true;
+    return image;
+}
+
+static void image_cache_flush(ctx_t * ctx) {
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        dmabuf_cache_entry_t * entry = &ctx->import.image_cache[i];
+        if (entry->valid) eglDestroyImage(ctx->egl.display, entry->image);
+
+        entry->image = EGL_NO_IMAGE;
+        entry->valid = false;
+    }
+}
+
+// --- import thread ---
+
+static import_texture_t * texture_acquire(ctx_t * ctx) {
+    for (size_t i = 0; i < IMPORT_TEXTURE_COUNT; i++) {
+        import_texture_t * texture = &ctx->import.textures[i];
+        if (atomic_exchange(&texture->in_use, true)) continue;
+
+        // texture may still be read by the last draw on the main context
+        // - blocks only this thread, the main thread keeps drawing
+        if (texture->draw_fence != EGL_NO_SYNC_KHR) {
+            ctx->import.eglClientWaitSyncKHR(ctx->egl.display, texture->draw_fence, 0, EGL_FOREVER_KHR);
+            ctx->import.eglDestroySyncKHR(ctx->egl.display, texture->draw_fence);
+            texture->draw_fence = EGL_NO_SYNC_KHR;
+        }
+
+        return texture;
+    }
+
+    return NULL;
+}
+
+static bool import_dmabuf(ctx_t * ctx, dmabuf_t * dmabuf, uint32_t buffer_flags, uint64_t timestamp_ns) {
+    import_texture_t * texture = texture_acquire(ctx);
+    if (texture == NULL) {
+        // main thread holds every texture, drop this frame
+        wlm_log_debug(ctx, "import::import_dmabuf(): no free texture, dropping frame\n");
+        wlm_stats_frame_dropped(ctx);
+        return true;
+    }
+
+    bool new_image = false;
+    EGLImage image = image_cache_get(ctx, dmabuf, &new_image);
+    if (image == EGL_NO_IMAGE) {
+        texture_release(ctx, texture);
+        return false;
+    }
+
+    // convert EGLImage to GL texture
+    glBindTexture(GL_TEXTURE_2D, texture->texture);
+    ctx->egl.glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // fence must be flushed before another context can wait for it
+    texture->fence = ctx->import.eglCreateSyncKHR(ctx->egl.display, EGL_SYNC_FENCE_KHR, NULL);
+    glFlush();
+    if (texture->fence == EGL_NO_SYNC_KHR) {
+        wlm_log_error("import::import_dmabuf(): failed to create fence\n");
+        texture_release(ctx, texture);
+        return false;
+    }
+
+    texture->width = dmabuf->width;
+    texture->height = dmabuf->height;
+    texture->drm_format = dmabuf->drm_format;
+    texture->buffer_flags = buffer_flags;
+    texture->new_image = new_image;
+    texture->timestamp_ns = timestamp_ns;
+
+    // replace a texture the main thread did not pick up yet
+    import_texture_t * dropped = wlm_capture_mailbox_put(&ctx->import.mailbox, texture);
+    if (dropped != NULL) {
+        wlm_stats_frame_dropped(ctx);
+        texture_release(ctx, dropped);
+    }
+
+    return true;
+}
+
+static void * import_thread_main(void * data) {
+    ctx_t * ctx = (ctx_t *)data;
+    wlm_trace_set_thread(TRACE_TRACK_IMPORT);
+
+    // shared context is only ever current on this thread
+    if (eglMakeCurrent(ctx->egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, ctx->import.context) != EGL_TRUE) {
+        wlm_log_error("import::thread(): failed to activate shared EGL context\n");
+        atomic_store(&ctx->import.available, false);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < IMPORT_TEXTURE_COUNT; i++) {
+        glGenTextures(1, &ctx->import.textures[i].texture);
+    }
+
+    while (true) {
+        pthread_mutex_lock(&ctx->import.lock);
+        while (!ctx->import.has_job && !ctx->import.stopping) {
+            pthread_cond_wait(&ctx->import.cond, &ctx->import.lock);
+        }
+
+        if (ctx->import.stopping) {
+            pthread_mutex_unlock(&ctx->import.lock);
+            break;
+        }
+
+        dmabuf_t job = ctx->import.job;
+        uint32_t buffer_flags = ctx->import.job_buffer_flags;
+        uint64_t timestamp_ns = ctx->import.job_timestamp_ns;
+        ctx->import.job.planes = 0;
+        ctx->import.has_job = false;
+        pthread_mutex_unlock(&ctx->import.lock);
+
+        wlm_trace_begin(ctx, "import");
+        bool success = import_dmabuf(ctx, &job, buffer_flags, timestamp_ns);
+        wlm_trace_end(ctx, "import");
+        wlm_allocator_dmabuf_destroy(&job);
+
+        notify_main(ctx, success ? IMPORT_NOTIFY_READY : IMPORT_NOTIFY_FAILED);
+    }
+
+    // main thread no longer draws any imported texture
+    for (size_t i = 0; i < IMPORT_TEXTURE_COUNT; i++) {
+        import_texture_t * texture = &ctx->import.textures[i];
+        texture_release(ctx, texture);
+        if (texture->draw_fence != EGL_NO_SYNC_KHR) {
+            ctx->import.eglClientWaitSyncKHR(ctx->egl.display, texture->draw_fence, 0, EGL_FOREVER_KHR);
+            ctx->import.eglDestroySyncKHR(ctx->egl.display, texture->draw_fence);
+            texture->draw_fence = EGL_NO_SYNC_KHR;
+        }
+        if (texture->texture != 0) glDeleteTextures(1, &texture->texture);
+        texture->texture = 0;
+    }
+    image_cache_flush(ctx);
+
+    eglMakeCurrent(ctx->egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    return NULL;
+}
+
+// --- main thread event handlers ---
+
+static void on_import_notify(ctx_t * ctx) {
+    uint64_t count;
+    while (read(ctx->import.notify_handler.fd, &count, sizeof count) > 0);
+
+    unsigned int notifications = atomic_exchange(&ctx->import.notifications, 0);
+    if (ctx->mirror.backend == NULL) return;
+
+    if (notifications & IMPORT_NOTIFY_FAILED) {
+        wlm_log_error("import::on_notify(): failed to import dmabuf\n");
+        ctx->mirror.backend->fail_count++;
+    }
+
+    // continue capture pipeline once the import is done
+    wlm_mirror_frame_ready(ctx);
+}
+
+// --- init_import ---
+
+void wlm_import_init(ctx_t * ctx) {
+    // initialize context structure
+    ctx->import.context = EGL_NO_CONTEXT;
+
+    ctx->import.eglCreateSyncKHR = NULL;
+    ctx->import.eglDestroySyncKHR = NULL;
+    ctx->import.eglClientWaitSyncKHR = NULL;
+    ctx->import.eglWaitSyncKHR = NULL;
+
+    pthread_mutex_init(&ctx->import.lock, NULL);
+    pthread_cond_init(&ctx->import.cond, NULL);
+    ctx->import.job.planes = 0;
+    ctx->import.job_buffer_flags = 0;
+    ctx->import.job_timestamp_ns = 0;
+    ctx->import.has_job = false;
+    ctx->import.stopping = false;
+
+    for (size_t i = 0; i < DMABUF_CACHE_SIZE; i++) {
+        ctx->import.image_cache[i].image = EGL_NO_IMAGE;
+        ctx->import.image_cache[i].valid = false;
+    }
+    ctx->import.image_cache_clock = 0;
+
+    for (size_t i = 0; i < IMPORT_TEXTURE_COUNT; i++) {
+        import_texture_t * texture = &ctx->import.textures[i];
+        texture->texture = 0;
+        texture->fence = EGL_NO_SYNC_KHR;
+        texture->draw_fence = EGL_NO_SYNC_KHR;
+        texture->width = 0;
+        texture->height = 0;
+        texture->drm_format = 0;
+        texture->buffer_flags = 0;
+        texture->new_image = false;
+        texture->timestamp_ns = 0;
+        atomic_init(&texture->in_use, false);
+    }
+
+    wlm_capture_mailbox_init(&ctx->import.mailbox);
+
+    ctx->import.notify_handler.next = NULL;
+    ctx->import.notify_handler.fd = -1;
+    ctx->import.notify_handler.events = EPOLLIN;
+    ctx->import.notify_handler.priority = EVENT_PRIORITY_RENDER;
+    ctx->import.notify_handler.on_event = on_import_notify;
+    ctx->import.notify_handler.on_each = NULL;
+    atomic_init(&ctx->import.notifications, 0);
+    atomic_init(&ctx->import.available, false);
+
+    ctx->import.pending = NULL;
+    ctx->import.displayed = NULL;
+
+    ctx->import.running = false;
+    ctx->import.initialized = true;
+
+    // create eventfd for waking the main thread
+    ctx->import.notify_handler.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (ctx->import.notify_handler.fd == -1) {
+        wlm_log_error("import::init(): failed to create notify eventfd\n");
+        wlm_exit_fail(ctx);
+    }
+
+    wlm_event_add_fd(ctx, &ctx->import.notify_handler);
+}
+
+// --- start_import ---
+
+void wlm_import_start(ctx_t * ctx) {
+    if (!ctx->import.initialized) return;
+    if (ctx->import.running) return;
+
+    // check for needed extensions
+    // - EGL_KHR_fence_sync: for knowing when an import finished on the GPU
+    // - EGL_KHR_surfaceless_context: for making the shared context current without a surface
+    if (!wlm_egl_has_egl_extension(ctx, "EGL_KHR_fence_sync") || !wlm_egl_has_egl_extension(ctx, "EGL_KHR_surfaceless_context")) {
+        wlm_log_warn("import::start(): missing EGL_KHR_fence_sync or EGL_KHR_surfaceless_context, importing on the main thread\n");
+        return;
+    }
+
+    // get pointers to functions provided by extensions
+    // - eglWaitSyncKHR: optional, lets the GPU wait for the import instead of polling the fence
+    ctx->import.eglCreateSyncKHR = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    ctx->import.eglDestroySyncKHR = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    ctx->import.eglClientWaitSyncKHR = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+    if (wlm_egl_has_egl_extension(ctx, "EGL_KHR_wait_sync")) {
+        ctx->import.eglWaitSyncKHR = (PFNEGLWAITSYNCKHRPROC)eglGetProcAddress("eglWaitSyncKHR");
+    }
+    if (ctx->import.eglCreateSyncKHR == NULL || ctx->import.eglDestroySyncKHR == NULL || ctx->import.eglClientWaitSyncKHR == NULL) {
+        wlm_log_warn("import::start(): failed to get fence functions, importing on the main thread\n");
+        return;
+    }
+
+    // create context sharing textures with the main context
+    EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, ctx->egl.gles3 ? 3 : 2,
+        EGL_CONTEXT_MINOR_VERSION, 0,
+        EGL_NONE
+    };
+    ctx->import.context = eglCreateContext(ctx->egl.display, ctx->egl.config, ctx->egl.context, context_attribs);
+    if (ctx->import.context == EGL_NO_CONTEXT) {
+        wlm_log_warn("import::start(): failed to create shared EGL context, importing on the main thread\n");
+        return;
+    }
+
+    wlm_log_debug(ctx, "import::start(): starting import thread\n");
+
+    ctx->import.stopping = false;
+    atomic_store(&ctx->import.available, true);
+    if (pthread_create(&ctx->import.thread, NULL, import_thread_main, (void *)ctx) != 0) {
+        wlm_log_error("import::start(): failed to create import thread\n");
+        atomic_store(&ctx->import.available, false);
+        eglDestroyContext(ctx->egl.display, ctx->import.context);
+        ctx->import.context = EGL_NO_CONTEXT;
+        return;
+    }
+
+    ctx->import.running = true;
+}
+
+bool wlm_import_running(ctx_t * ctx) {
+    return ctx->import.running && atomic_load(&ctx->import.available);
+}
+
+// --- submit ---
+
+bool wlm_import_submit(ctx_t * ctx, dmabuf_t * dmabuf, uint32_t buffer_flags, uint64_t timestamp_ns) {
+    if (!wlm_import_running(ctx)) return false;
+
+    pthread_mutex_lock(&ctx->import.lock);
+
+    // import thread did not pick up the previous frame yet
+    if (ctx->import.has_job) {
+        wlm_stats_frame_dropped(ctx);
+        wlm_allocator_dmabuf_destroy(&ctx->import.job);
+    }
+
+    // import thread owns the dmabuf fds from here on
+    ctx->import.job = *dmabuf;
+    ctx->import.job_buffer_flags = buffer_flags;
+    ctx->import.job_timestamp_ns = timestamp_ns;
+    ctx->import.has_job = true;
+    pthread_cond_signal(&ctx->import.cond);
+
+    pthread_mutex_unlock(&ctx->import.lock);
+    return true;
+}
+
+// --- take ---
+
+import_texture_t * wlm_import_take(ctx_t * ctx) {
+    if (!ctx->import.running) return NULL;
+
+    // a newer import replaces one still waiting for its fence
+    import_texture_t * newest = wlm_capture_mailbox_take(&ctx->import.mailbox);
+    if (newest != NULL) {
+        if (ctx->import.pending != NULL) {
+            wlm_stats_frame_dropped(ctx);
+            texture_release(ctx, ctx->import.pending);
+        }
+        ctx->import.pending = newest;
+
+        // keep presenting the last texture instead of a stale one
+        if (!wlm_mirror_frame_accept(ctx, newest->timestamp_ns)) {
+            texture_release(ctx, newest);
+            ctx->import.pending = NULL;
+        }
+    }
+
+    import_texture_t * texture = ctx->import.pending;
+    if (texture == NULL) return NULL;
+
+    // let the GPU wait for the import if possible, otherwise only poll the fence
+    // - an unfinished import keeps the previous texture on screen instead of stalling
+    if (ctx->import.eglWaitSyncKHR != NULL) {
+        ctx->import.eglWaitSyncKHR(ctx->egl.display, texture->fence, 0);
+    } else if (ctx->import.eglClientWaitSyncKHR(ctx->egl.display, texture->fence, 0, 0) == EGL_TIMEOUT_EXPIRED_KHR) {
+        return NULL;
+    }
+
+    ctx->import.eglDestroySyncKHR(ctx->egl.display, texture->fence);
+    texture->fence = EGL_NO_SYNC_KHR;
+
+    // texture drawn until now may still be read by the GPU
+    // - the import thread waits for its draw fence before reusing it
+    if (ctx->import.displayed != NULL) texture_release(ctx, ctx->import.displayed);
+    ctx->import.displayed = texture;
+    ctx->import.pending = NULL;
+
+    return texture;
+}
+
+// --- fence_draw ---
+
+void wlm_import_fence_draw(ctx_t * ctx) {
+    if (!ctx->import.running) return;
+
+    import_texture_t * texture = ctx->import.displayed;
+    if (texture == NULL) return;
+
+    // only the newest draw reading the texture matters
+    if (texture->draw_fence != EGL_NO_SYNC_KHR) {
+        ctx->import.eglDestroySyncKHR(ctx->egl.display, texture->draw_fence);
+    }
+
+    // fence must be flushed before another context can wait for it
+    texture->draw_fence = ctx->import.eglCreateSyncKHR(ctx->egl.display, EGL_SYNC_FENCE_KHR, NULL);
+    glFlush();
+    if (texture->draw_fence == EGL_NO_SYNC_KHR) {
+        // reusing the texture without a fence could corrupt this frame, finish it now
+        wlm_log_error("import::fence_draw(): failed to create fence\n");
+        glFinish();
+    }
+}
+
+// --- stop_import ---
+
+void wlm_import_stop(ctx_t * ctx) {
+    if (!ctx->import.running) return;
+
+    wlm_log_debug(ctx, "import::stop(): stopping import thread\n");
+
+    // stop drawing textures owned by the import thread
+    for (size_t i = 0; i < IMPORT_TEXTURE_COUNT; i++) {
+        if (ctx->egl.current_texture == ctx->import.textures[i].texture) {
+            ctx->egl.current_texture = ctx->egl.texture;
+        }
+    }
+
+    pthread_mutex_lock(&ctx->import.lock);
+    ctx->import.stopping = true;
+    pthread_cond_signal(&ctx->import.cond);
+    pthread_mutex_unlock(&ctx->import.lock);
+    pthread_join(ctx->import.thread, NULL);
+
+    // import thread released every texture and its image cache on exit
+    if (ctx->import.has_job) wlm_allocator_dmabuf_destroy(&ctx->import.job);
+    ctx->import.has_job = false;
+    wlm_capture_mailbox_take(&ctx->import.mailbox);
+    ctx->import.pending = NULL;
+    ctx->import.displayed = NULL;
+
+    eglDestroyContext(ctx->egl.display, ctx->import.context);
+    ctx->import.context = EGL_NO_CONTEXT;
+
+    atomic_store(&ctx->import.available, false);
+    atomic_store(&ctx->import.notifications, 0);
+    ctx->import.running = false;
+}
+
+// --- cleanup_import ---
+
+void wlm_import_cleanup(ctx_t * ctx) {
+    if (!ctx->import.initialized) return;
+
+    wlm_log_debug(ctx, "import::cleanup(): destroying import objects\n");
+
+    wlm_import_stop(ctx);
+
+    if (ctx->import.has_job) wlm_allocator_dmabuf_destroy(&ctx->import.job);
+    if (ctx->import.context != EGL_NO_CONTEXT) eglDestroyContext(ctx->egl.display, ctx->import.context);
+    if (ctx->import.notify_handler.fd != -1) {
+        wlm_event_remove_fd(ctx, &ctx->import.notify_handler);
+        close(ctx->import.notify_handler.fd);
+    }
+    pthread_cond_destroy(&ctx->import.cond);
+    pthread_mutex_destroy(&ctx->import.lock);
+
+    ctx->import.initialized = false;
+}
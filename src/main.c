@@ -8,9 +8,16 @@ void wlm_cleanup(ctx_t * ctx) {
     wlm_log_debug(ctx, "main::cleanup(): deallocating resources\n");
 
     if (ctx->mirror.initialized) wlm_mirror_cleanup(ctx);
+    if (ctx->capture.initialized) wlm_capture_cleanup(ctx);
+    if (ctx->import.initialized) wlm_import_cleanup(ctx);
+    if (ctx->allocator.initialized) wlm_allocator_cleanup(ctx);
+    if (ctx->hud.initialized) wlm_hud_cleanup(ctx);
     if (ctx->egl.initialized) wlm_egl_cleanup(ctx);
     if (ctx->wl.initialized) wlm_wayland_cleanup(ctx);
     if (ctx->stream.initialized) wlm_stream_cleanup(ctx);
+    if (ctx->perf.initialized) wlm_perf_cleanup(ctx);
+    if (ctx->trace.initialized) wlm_trace_cleanup(ctx);
+    if (ctx->stats.initialized) wlm_stats_cleanup(ctx);
     if (ctx->event.initialized) wlm_event_cleanup(ctx);
 
     wlm_cleanup_opt(ctx);
@@ -25,13 +32,23 @@ int main(int argc, char ** argv) {
     ctx_t ctx = { 0 };
 
     ctx.event.initialized = false;
+    ctx.stats.initialized = false;
+    ctx.trace.initialized = false;
+    ctx.perf.initialized = false;
     ctx.stream.initialized = false;
     ctx.wl.initialized = false;
     ctx.egl.initialized = false;
+    ctx.hud.initialized = false;
+    ctx.allocator.initialized = false;
+    ctx.capture.initialized = false;
+    ctx.import.initialized = false;
     ctx.mirror.initialized = false;
 
     wlm_opt_init(&ctx);
     wlm_event_init(&ctx);
+    wlm_stats_init(&ctx);
+    wlm_trace_init(&ctx);
+    wlm_perf_init(&ctx);
 
     if (argc > 0) {
         // skip program name
@@ -50,6 +67,18 @@ int main(int argc, char ** argv) {
     wlm_log_debug(&ctx, "main::main(): initializing EGL\n");
     wlm_egl_init(&ctx);
 
+    wlm_log_debug(&ctx, "main::main(): initializing HUD\n");
+    wlm_hud_init(&ctx);
+
+    wlm_log_debug(&ctx, "main::main(): initializing allocator\n");
+    wlm_allocator_init(&ctx);
+
+    wlm_log_debug(&ctx, "main::main(): initializing import\n");
+    wlm_import_init(&ctx);
+
+    wlm_log_debug(&ctx, "main::main(): initializing capture\n");
+    wlm_capture_init(&ctx);
+
     wlm_log_debug(&ctx, "main::main(): initializing mirror\n");
     wlm_mirror_init(&ctx);
 
@@ -6,6 +6,53 @@
 #include <EGL/eglext.h>
 #include <wlm/proto/linux-dmabuf-unstable-v1.h>
 
+// --- state tracking ---
+
+// waiting states are shown as slices in the trace
+static const char * state_names[] = {
+    [STATE_WAIT_FRAME] = "dmabuf::wait_frame",
+    [STATE_WAIT_OBJECTS] = "dmabuf::wait_objects",
+    [STATE_WAIT_READY] = "dmabuf::wait_ready",
+    [STATE_READY] = NULL,
+    [STATE_CANCELED] = NULL
+};
+
+static void set_state(ctx_t * ctx, dmabuf_mirror_backend_t * backend, dmabuf_state_t state) {
+    wlm_trace_state(ctx, state_names[backend->state], state_names[state]);
+    atomic_store(&backend->header.capture_in_flight, state != STATE_READY && state != STATE_CANCELED);
+    atomic_store(&backend->header.waiting_for_damage, state == STATE_WAIT_FRAME);
+    backend->state = state;
+}
+
+static void frame_release(dmabuf_frame_t * frame) {
+    // close dmabuf file descriptors
+    for (unsigned int i = 0; i < frame->dmabuf.planes; i++) {
+        if (frame->dmabuf.fds[i] != -1) close(frame->dmabuf.fds[i]);
+    }
+
+    frame->dmabuf.width = 0;
+    frame->dmabuf.height = 0;
+    frame->dmabuf.drm_format = 0;
+    frame->dmabuf.planes = 0;
+    frame->dmabuf.modifier = 0;
+    frame->buffer_flags = 0;
+    frame->timestamp_ns = 0;
+
+    // slot may be reused by the capture thread from here on
+    atomic_store(&frame->in_use, false);
+}
+
+static dmabuf_frame_t * frame_acquire(dmabuf_mirror_backend_t * backend) {
+    for (size_t i = 0; i < DMABUF_FRAME_COUNT; i++) {
+        dmabuf_frame_t * frame = &backend->frames[i];
+        if (!atomic_exchange(&frame->in_use, true)) {
+            return frame;
+        }
+    }
+
+    return NULL;
+}
+
 static void dmabuf_frame_cleanup(dmabuf_mirror_backend_t * backend) {
     // destroy dmabuf frame object
     if (backend->dmabuf_frame != NULL) {
@@ -13,31 +60,20 @@ static void dmabuf_frame_cleanup(dmabuf_mirror_backend_t * backend) {
         backend->dmabuf_frame = NULL;
     }
 
-    // close dmabuf file descriptors
-    for (unsigned int i = 0; i < backend->dmabuf.planes; i++) {
-        if (backend->dmabuf.fds[i] != -1) close(backend->dmabuf.fds[i]);
+    // release incomplete frame
+    if (backend->capture_frame != NULL) {
+        frame_release(backend->capture_frame);
+        backend->capture_frame = NULL;
     }
-
-    free(backend->dmabuf.fds);
-    free(backend->dmabuf.offsets);
-    free(backend->dmabuf.strides);
-
-    backend->dmabuf.width = 0;
-    backend->dmabuf.height = 0;
-    backend->dmabuf.drm_format = 0;
-    backend->dmabuf.planes = 0;
-    backend->dmabuf.fds = NULL;
-    backend->dmabuf.offsets = NULL;
-    backend->dmabuf.strides = NULL;
-    backend->dmabuf.modifier = 0;
 }
 
-static void backend_cancel(dmabuf_mirror_backend_t * backend) {
+static void backend_cancel(ctx_t * ctx, dmabuf_mirror_backend_t * backend) {
     wlm_log_error("mirror-dmabuf::backend_cancel(): cancelling capture due to error\n");
 
     dmabuf_frame_cleanup(backend);
-    backend->state = STATE_CANCELED;
+    set_state(ctx, backend, STATE_CANCELED);
     backend->header.fail_count++;
+    backend->header.cancel_count++;
 }
 
 // --- dmabuf_frame event handlers ---
@@ -52,13 +88,14 @@ static void on_frame(
     dmabuf_mirror_backend_t * backend = (dmabuf_mirror_backend_t *)ctx->mirror.backend;
 
     wlm_log_debug(ctx, "mirror-dmabuf::on_frame(): received %dx%d frame with %d objects\n", width, height, num_objects);
+    wlm_stats_mark(ctx, STATS_MARK_EVENT);
     if (backend->state != STATE_WAIT_FRAME) {
         wlm_log_error("mirror-dmabuf::on_frame(): got frame while in state %d\n", backend->state);
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
         return;
     } else if (num_objects > MAX_PLANES) {
         wlm_log_error("mirror-dmabuf::on_frame(): got frame with more than %d objects\n", MAX_PLANES);
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
         return;
     }
 
@@ -82,37 +119,32 @@ static void on_frame(
         fprintf(stderr, "}\n");
     }
 
-    backend->dmabuf.planes = 0;
-    backend->dmabuf.fds = malloc(num_objects * sizeof (int));
-    backend->dmabuf.offsets = malloc(num_objects * sizeof (uint32_t));
-    backend->dmabuf.strides = malloc(num_objects * sizeof (uint32_t));
-    backend->dmabuf.modifier = ((uint64_t)mod_high << 32) | mod_low;
-    if (backend->dmabuf.fds == NULL || backend->dmabuf.offsets == NULL) {
-        wlm_log_error("mirror-dmabuf::on_frame(): failed to allocate dmabuf storage\n");
-        backend_cancel(backend);
-        return;
-    }
+    // dmabuf storage is fixed size, num_objects was checked against MAX_PLANES
+    dmabuf_t * dmabuf = &backend->capture_frame->dmabuf;
+    dmabuf->modifier = ((uint64_t)mod_high << 32) | mod_low;
 
     // save dmabuf frame info
     backend->x = x;
     backend->y = y;
-    backend->buffer_flags = buffer_flags;
     backend->frame_flags = frame_flags;
-    backend->dmabuf.width = width;
-    backend->dmabuf.height = height;
-    backend->dmabuf.drm_format = format;
-    backend->dmabuf.planes = num_objects;
+    backend->capture_frame->buffer_flags = buffer_flags;
+    dmabuf->width = width;
+    dmabuf->height = height;
+    dmabuf->drm_format = format;
+    dmabuf->planes = num_objects;
 
     wlm_log_debug(ctx, "mirror-dmabuf::on_frame(): w=%d h=%d gl_format=%x drm_format=%08x drm_modifier=%016lx\n",
-        backend->dmabuf.width, backend->dmabuf.height, GL_RGB8_OES, backend->dmabuf.drm_format, backend->dmabuf.modifier
+        dmabuf->width, dmabuf->height, GL_RGB8_OES, dmabuf->drm_format, dmabuf->modifier
     );
 
     for (size_t i = 0; i < num_objects; i++) {
-        backend->dmabuf.fds[i] = -1;
+        dmabuf->fds[i] = -1;
+        dmabuf->offsets[i] = 0;
+        dmabuf->strides[i] = 0;
     }
 
     // update dmabuf frame state machine
-    backend->state = STATE_WAIT_OBJECTS;
+    set_state(ctx, backend, STATE_WAIT_OBJECTS);
     backend->processed_objects = 0;
 
     (void)frame;
@@ -132,23 +164,25 @@ static void on_object(
     if (backend->state != STATE_WAIT_OBJECTS) {
         wlm_log_error("mirror-dmabuf::on_object(): got object while in state %d\n", backend->state);
         close(fd);
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
         return;
-    } else if (index >= backend->dmabuf.planes) {
+    }
+
+    dmabuf_t * dmabuf = &backend->capture_frame->dmabuf;
+    if (index >= dmabuf->planes) {
         wlm_log_error("mirror-dmabuf::on_object(): got object with out-of-bounds index %d\n", index);
         close(fd);
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
         return;
     }
 
-
-    backend->dmabuf.fds[index] = fd;
-    backend->dmabuf.offsets[index] = offset;
-    backend->dmabuf.strides[index] = stride;
+    dmabuf->fds[index] = fd;
+    dmabuf->offsets[index] = offset;
+    dmabuf->strides[index] = stride;
 
     backend->processed_objects++;
-    if (backend->processed_objects == backend->dmabuf.planes) {
-        backend->state = STATE_WAIT_READY;
+    if (backend->processed_objects == dmabuf->planes) {
+        set_state(ctx, backend, STATE_WAIT_READY);
     }
 
     (void)frame;
@@ -164,43 +198,43 @@ static void on_ready(
     dmabuf_mirror_backend_t * backend = (dmabuf_mirror_backend_t *)ctx->mirror.backend;
 
     wlm_log_debug(ctx, "mirror-dmabuf::on_ready(): frame is ready\n");
+    wlm_stats_mark(ctx, STATS_MARK_READY);
     if (backend->state != STATE_WAIT_READY) {
         wlm_log_error("dmabuf_frame: got ready while in state %d\n", backend->state);
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
         return;
     }
 
-    if (!wlm_egl_dmabuf_to_texture(ctx, &backend->dmabuf)) {
-        wlm_log_error("mirror-dmabuf::on_ready(): failed to import dmabuf\n");
-        backend_cancel(backend);
-    }
+    // hand frame over to the main thread
+    // - a frame the main thread did not pick up yet is dropped
+    dmabuf_frame_t * ready_frame = backend->capture_frame;
+    ready_frame->timestamp_ns = wlm_mirror_frame_timestamp(sec_hi, sec_lo, nsec);
+    backend->capture_frame = NULL;
+    dmabuf_frame_cleanup(backend);
 
-    ctx->egl.format = GL_RGB8_OES; // FIXME: find out actual format
-    ctx->egl.texture_region_aware = false;
-    ctx->egl.texture_initialized = true;
+    // import thread takes over the dmabuf fds and notifies the main thread when done
+    if (backend->use_import && wlm_import_submit(ctx, &ready_frame->dmabuf, ready_frame->buffer_flags, ready_frame->timestamp_ns)) {
+        ready_frame->dmabuf.planes = 0;
+        frame_release(ready_frame);
 
-    // set buffer flags only if changed
-    bool invert_y = backend->buffer_flags & ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_Y_INVERT;
-    if (ctx->mirror.invert_y != invert_y) {
-        ctx->mirror.invert_y = invert_y;
-        wlm_egl_update_uniforms(ctx);
+        set_state(ctx, backend, STATE_READY);
+        backend->header.fail_count = 0;
+        return;
     }
 
-    // set texture size and aspect ratio only if changed
-    if (backend->dmabuf.width != ctx->egl.width || backend->dmabuf.height != ctx->egl.height) {
-        ctx->egl.width = backend->dmabuf.width;
-        ctx->egl.height = backend->dmabuf.height;
-        wlm_egl_resize_viewport(ctx);
+    dmabuf_frame_t * dropped = wlm_capture_mailbox_put(&backend->mailbox, ready_frame);
+    if (dropped != NULL) {
+        wlm_stats_frame_dropped(ctx);
+        frame_release(dropped);
     }
 
-    dmabuf_frame_cleanup(backend);
-    backend->state = STATE_READY;
+    set_state(ctx, backend, STATE_READY);
     backend->header.fail_count = 0;
 
+    // request next frame without waiting for the next frame callback
+    wlm_mirror_frame_ready(ctx);
+
     (void)frame;
-    (void)sec_hi;
-    (void)sec_lo;
-    (void)nsec;
 }
 
 static void on_cancel(
@@ -213,7 +247,8 @@ static void on_cancel(
     wlm_log_debug(ctx, "mirror-dmabuf::on_cancel(): frame was canceled\n");
 
     dmabuf_frame_cleanup(backend);
-    backend->state = STATE_CANCELED;
+    set_state(ctx, backend, STATE_CANCELED);
+    backend->header.cancel_count++;
 
     switch (reason) {
         case ZWLR_EXPORT_DMABUF_FRAME_V1_CANCEL_REASON_PERMANENT:
@@ -248,28 +283,42 @@ static const struct zwlr_export_dmabuf_frame_v1_listener dmabuf_frame_listener =
 
 // --- backend event handlers ---
 
-static void do_capture(ctx_t * ctx) {
+static bool do_capture(ctx_t * ctx, const mirror_capture_params_t * params) {
     dmabuf_mirror_backend_t * backend = (dmabuf_mirror_backend_t *)ctx->mirror.backend;
 
+    // target may have been switched to a toplevel in stream mode
+    if (params->target == NULL) {
+        wlm_log_error("mirror-dmabuf::do_capture(): toplevel capture not supported\n");
+        wlm_mirror_backend_fail(ctx);
+        return false;
+    }
+
     if (backend->state == STATE_READY || backend->state == STATE_CANCELED) {
         // clear frame state for next frame
         backend->x = 0;
         backend->y = 0;
-        backend->buffer_flags = 0;
         backend->frame_flags = 0;
         dmabuf_frame_cleanup(backend);
 
-        backend->state = STATE_WAIT_FRAME;
+        // every slot is still waiting to be imported
+        // - the next upload frees a slot and the next frame callback retries
+        backend->capture_frame = frame_acquire(backend);
+        if (backend->capture_frame == NULL) {
+            wlm_log_debug(ctx, "mirror-dmabuf::do_capture(): no free frame slot\n");
+            return false;
+        }
+
+        set_state(ctx, backend, STATE_WAIT_FRAME);
         backend->processed_objects = 0;
 
         // create wlr_dmabuf_export_frame
         backend->dmabuf_frame = zwlr_export_dmabuf_manager_v1_capture_output(
-            ctx->wl.dmabuf_manager, ctx->opt.show_cursor, ctx->mirror.current_target->output
+            backend->dmabuf_manager, params->show_cursor, params->target->output
         );
         if (backend->dmabuf_frame == NULL) {
             wlm_log_error("mirror-dmabuf::do_capture(): failed to create wlr_dmabuf_export_frame\n");
             wlm_mirror_backend_fail(ctx);
-            return;
+            return false;
         }
 
         // add wlr_dmabuf_export_frame event listener
@@ -278,8 +327,86 @@ static void do_capture(ctx_t * ctx) {
         // - for ready event
         // - for cancel event
         zwlr_export_dmabuf_frame_v1_add_listener(backend->dmabuf_frame, &dmabuf_frame_listener, (void *)ctx);
+        return true;
+    }
+
+    return false;
+}
+
+static bool do_cancel(ctx_t * ctx) {
+    dmabuf_mirror_backend_t * backend = (dmabuf_mirror_backend_t *)ctx->mirror.backend;
+
+    if (backend->state == STATE_READY || backend->state == STATE_CANCELED) {
+        return false;
+    }
+
+    // frame is sent on the next output commit, objects and ready follow right after
+    bool stuck = backend->state != STATE_WAIT_FRAME;
+
+    wlm_log_debug(ctx, "mirror-dmabuf::do_cancel(): abandoning capture\n");
+
+    dmabuf_frame_cleanup(backend);
+    set_state(ctx, backend, STATE_CANCELED);
+    return stuck;
+}
+
+static void update_texture_params(ctx_t * ctx, uint32_t width, uint32_t height, uint32_t buffer_flags) {
+    ctx->egl.texture_region_aware = false;
+    ctx->egl.texture_initialized = true;
+
+    // set buffer flags only if changed
+    bool invert_y = buffer_flags & ZWP_LINUX_BUFFER_PARAMS_V1_FLAGS_Y_INVERT;
+    if (ctx->mirror.invert_y != invert_y) {
+        ctx->mirror.invert_y = invert_y;
+        wlm_egl_update_uniforms(ctx);
+    }
+
+    // set texture size and aspect ratio only if changed
+    if (width != ctx->egl.width || height != ctx->egl.height) {
+        ctx->egl.width = width;
+        ctx->egl.height = height;
+        wlm_egl_resize_viewport(ctx);
+    }
+}
+
+static void do_upload(ctx_t * ctx) {
+    dmabuf_mirror_backend_t * backend = (dmabuf_mirror_backend_t *)ctx->mirror.backend;
+
+    // use newest texture finished by the import thread, if any
+    if (backend->use_import) {
+        import_texture_t * texture = wlm_import_take(ctx);
+        if (texture != NULL) {
+            wlm_egl_use_imported_texture(ctx, texture->texture, texture->drm_format, texture->new_image);
+            update_texture_params(ctx, texture->width, texture->height, texture->buffer_flags);
+        }
+    }
+
+    // import newest completed frame, if any
+    dmabuf_frame_t * frame = wlm_capture_mailbox_take(&backend->mailbox);
+    if (frame == NULL) return;
+
+    // keep presenting the last frame instead of a stale one
+    if (!wlm_mirror_frame_accept(ctx, frame->timestamp_ns)) {
+        frame_release(frame);
+        return;
+    }
+
+    if (!wlm_egl_dmabuf_to_texture(ctx, &frame->dmabuf)) {
+        wlm_log_error("mirror-dmabuf::do_upload(): failed to import dmabuf\n");
+        frame_release(frame);
+
+        backend->import_fail_count++;
+        if (backend->import_fail_count >= MIRROR_BACKEND_FATAL_FAILCOUNT) {
+            wlm_mirror_backend_fail(ctx);
+        }
+        return;
     }
 
+    backend->import_fail_count = 0;
+    update_texture_params(ctx, frame->dmabuf.width, frame->dmabuf.height, frame->buffer_flags);
+
+    // imported image keeps the buffer alive
+    frame_release(frame);
 }
 
 static void do_cleanup(ctx_t * ctx) {
@@ -287,6 +414,12 @@ static void do_cleanup(ctx_t * ctx) {
 
     wlm_log_debug(ctx, "mirror-dmabuf::do_cleanup(): destroying mirror-dmabuf objects\n");
     dmabuf_frame_cleanup(backend);
+    wlm_trace_state(ctx, state_names[backend->state], NULL);
+
+    dmabuf_frame_t * frame = wlm_capture_mailbox_take(&backend->mailbox);
+    if (frame != NULL) frame_release(frame);
+
+    wlm_capture_unwrap_proxy(backend->dmabuf_manager, ctx->wl.dmabuf_manager);
 
     free(backend);
     ctx->mirror.backend = NULL;
@@ -299,6 +432,9 @@ void wlm_mirror_dmabuf_init(ctx_t * ctx) {
     if (ctx->wl.dmabuf_manager == NULL) {
         wlm_log_error("mirror-dmabuf::init(): missing wlr_export_dmabuf_manager protocol\n");
         return;
+    } else if (ctx->mirror.current_toplevel != NULL) {
+        wlm_log_error("mirror-dmabuf::init(): toplevel capture not supported\n");
+        return;
     }
 
     // allocate backend context structure
@@ -309,24 +445,43 @@ void wlm_mirror_dmabuf_init(ctx_t * ctx) {
     }
 
     // initialize context structure
+    backend->header.name = "dmabuf";
     backend->header.do_capture = do_capture;
+    backend->header.do_upload = do_upload;
     backend->header.do_cleanup = do_cleanup;
+    backend->header.do_cancel = do_cancel;
     backend->header.fail_count = 0;
+    backend->header.cancel_count = 0;
+    backend->header.capture_in_flight = false;
+    backend->header.waiting_for_damage = false;
 
+    // capture events are dispatched on the capture thread if the manager could be wrapped
+    backend->dmabuf_manager = wlm_capture_wrap_proxy(ctx, ctx->wl.dmabuf_manager);
+    backend->header.capture_thread = backend->dmabuf_manager != ctx->wl.dmabuf_manager;
     backend->dmabuf_frame = NULL;
 
+    for (size_t i = 0; i < DMABUF_FRAME_COUNT; i++) {
+        dmabuf_frame_t * frame = &backend->frames[i];
+        frame->dmabuf.width = 0;
+        frame->dmabuf.height = 0;
+        frame->dmabuf.drm_format = 0;
+        frame->dmabuf.planes = 0;
+        frame->dmabuf.modifier = 0;
+        frame->buffer_flags = 0;
+        frame->timestamp_ns = 0;
+        atomic_init(&frame->in_use, false);
+    }
+    backend->capture_frame = NULL;
+    wlm_capture_mailbox_init(&backend->mailbox);
+    backend->import_fail_count = 0;
+
+    // import thread is optional, frames are imported on the main thread without it
+    if (ctx->opt.import_thread) wlm_import_start(ctx);
+    backend->use_import = wlm_import_running(ctx);
+
     backend->x = 0;
     backend->y = 0;
-    backend->buffer_flags = 0;
     backend->frame_flags = 0;
-    backend->dmabuf.width = 0;
-    backend->dmabuf.height = 0;
-    backend->dmabuf.drm_format = 0;
-    backend->dmabuf.planes = 0;
-    backend->dmabuf.fds = NULL;
-    backend->dmabuf.offsets = NULL;
-    backend->dmabuf.strides = NULL;
-    backend->dmabuf.modifier = 0;
 
     backend->state = STATE_READY;
     backend->processed_objects = 0;
@@ -0,0 +1,860 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlm/context.h>
+#include <wlm/mirror-extcopy.h>
+#include <wlm/allocator.h>
+#include <sys/mman.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+// --- state tracking ---
+
+// waiting states are shown as slices in the trace
+static const char * state_names[] = {
+    [STATE_WAIT_CONSTRAINTS] = "extcopy::wait_constraints",
+    [STATE_WAIT_READY] = "extcopy::wait_ready",
+    [STATE_READY] = NULL,
+    [STATE_CANCELED] = NULL
+};
+
+static void set_state(ctx_t * ctx, extcopy_mirror_backend_t * backend, extcopy_state_t state) {
+    wlm_trace_state(ctx, state_names[backend->state], state_names[state]);
+    atomic_store(&backend->header.capture_in_flight, state != STATE_READY && state != STATE_CANCELED);
+    atomic_store(&backend->header.waiting_for_damage, state == STATE_WAIT_READY);
+    backend->state = state;
+}
+
+// --- buffer management ---
+
+static void destroy_buffers(extcopy_mirror_backend_t * backend) {
+    for (size_t i = 0; i < EXTCOPY_BUFFER_COUNT; i++) {
+        extcopy_buffer_t * buffer = &backend->buffers[i];
+        if (buffer->buffer != NULL) wl_buffer_destroy(buffer->buffer);
+        wlm_allocator_dmabuf_destroy(&buffer->dmabuf);
+
+        buffer->buffer = NULL;
+        buffer->shm_offset = 0;
+        wlm_util_damage_clear(&buffer->stale_damage);
+        buffer->fully_stale = true;
+        buffer->timestamp_ns = 0;
+        buffer->state = BUFFER_FREE;
+    }
+
+    // texture contents no longer match the new buffers
+    backend->texture_valid = false;
+    wlm_util_damage_clear(&backend->upload_damage);
+}
+
+static void destroy_session(ctx_t * ctx, extcopy_mirror_backend_t * backend) {
+    if (backend->capture_frame != NULL) ext_image_copy_capture_frame_v1_destroy(backend->capture_frame);
+    if (backend->capture_session != NULL) ext_image_copy_capture_session_v1_destroy(backend->capture_session);
+    if (backend->capture_source != NULL) ext_image_capture_source_v1_destroy(backend->capture_source);
+
+    backend->capture_frame = NULL;
+    backend->capture_session = NULL;
+    backend->capture_source = NULL;
+    backend->session_target = NULL;
+    backend->session_toplevel = NULL;
+    backend->constraints_valid = false;
+    set_state(ctx, backend, STATE_WAIT_CONSTRAINTS);
+
+    // buffers belong to the session
+    destroy_buffers(backend);
+}
+
+static void frame_abandon(ctx_t * ctx, extcopy_mirror_backend_t * backend) {
+    // destroy capture frame object
+    if (backend->capture_frame != NULL) ext_image_copy_capture_frame_v1_destroy(backend->capture_frame);
+    backend->capture_frame = NULL;
+    set_state(ctx, backend, STATE_CANCELED);
+
+    // damage of the canceled capture is lost, next upload must be complete
+    backend->texture_valid = false;
+
+    // release buffer of the canceled capture, its contents are undefined now
+    extcopy_buffer_t * buffer = &backend->buffers[backend->capture_buffer];
+    if (buffer->state == BUFFER_BUSY) {
+        buffer->state = BUFFER_FREE;
+        buffer->fully_stale = true;
+    }
+}
+
+static void frame_cancel(ctx_t * ctx, extcopy_mirror_backend_t * backend) {
+    wlm_log_error("mirror-extcopy::frame_cancel(): cancelling capture due to error\n");
+
+    frame_abandon(ctx, backend);
+    backend->header.fail_count++;
+    backend->header.cancel_count++;
+}
+
+static bool grow_shm_pool(extcopy_mirror_backend_t * backend, size_t new_size) {
+    if (new_size <= backend->shm_size) {
+        return true;
+    }
+
+    if (ftruncate(backend->shm_fd, new_size) == -1) {
+        wlm_log_error("mirror-extcopy::grow_shm_pool(): failed to grow shm buffer\n");
+        return false;
+    }
+
+#if __linux__
+    void * new_addr = mremap(backend->shm_addr, backend->shm_size, new_size, MREMAP_MAYMOVE);
+    if (new_addr == MAP_FAILED) {
+        wlm_log_error("mirror-extcopy::grow_shm_pool(): failed to remap shm buffer\n");
+        return false;
+    }
+#else
+    void * new_addr = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, backend->shm_fd, 0);
+    if (new_addr == MAP_FAILED) {
+        wlm_log_error("mirror-extcopy::grow_shm_pool(): failed to map new shm buffer\n");
+        return false;
+    } else {
+        munmap(backend->shm_addr, backend->shm_size);
+    }
+#endif
+
+    backend->shm_addr = new_addr;
+    backend->shm_size = new_size;
+
+    wl_shm_pool_resize(backend->shm_pool, new_size);
+    return true;
+}
+
+static bool create_shm_buffer(extcopy_mirror_backend_t * backend, extcopy_buffer_t * buffer) {
+    // carve wl_buffer out of the shared pool
+    size_t frame_size = (size_t)backend->frame_stride * backend->frame_height;
+    if (!grow_shm_pool(backend, frame_size * (backend->capture_buffer + 1))) {
+        return false;
+    }
+
+    buffer->shm_offset = frame_size * backend->capture_buffer;
+    buffer->buffer = wl_shm_pool_create_buffer(
+        backend->shm_pool, buffer->shm_offset,
+        backend->frame_width, backend->frame_height,
+        backend->frame_stride, backend->frame_format
+    );
+    if (buffer->buffer == NULL) {
+        wlm_log_error("mirror-extcopy::create_shm_buffer(): failed to create wl_buffer\n");
+        return false;
+    }
+
+    return true;
+}
+
+static bool create_dmabuf_buffer(ctx_t * ctx, extcopy_mirror_backend_t * backend, extcopy_buffer_t * buffer) {
+    if (!wlm_allocator_dmabuf_create(ctx, &buffer->dmabuf, backend->frame_width, backend->frame_height, backend->frame_format)) {
+        wlm_log_debug(ctx, "mirror-extcopy::create_dmabuf_buffer(): failed to allocate dmabuf\n");
+        return false;
+    }
+
+    // the compositor only accepts modifiers it advertised, our buffers are always linear
+    if (buffer->dmabuf.modifier != DRM_FORMAT_MOD_LINEAR) {
+        wlm_log_debug(ctx, "mirror-extcopy::create_dmabuf_buffer(): allocated dmabuf is not linear\n");
+        wlm_allocator_dmabuf_destroy(&buffer->dmabuf);
+        return false;
+    }
+
+    buffer->buffer = wlm_allocator_dmabuf_to_wl_buffer(ctx, &buffer->dmabuf);
+    if (buffer->buffer == NULL) {
+        wlm_log_debug(ctx, "mirror-extcopy::create_dmabuf_buffer(): failed to create wl_buffer\n");
+        wlm_allocator_dmabuf_destroy(&buffer->dmabuf);
+        return false;
+    }
+
+    return true;
+}
+
+static void select_buffer_type(ctx_t * ctx, extcopy_mirror_backend_t * backend, extcopy_buffer_type_t type) {
+    const extcopy_constraints_t * constraints = &backend->constraints;
+    uint32_t format;
+    uint32_t stride;
+    if (type == BUFFER_TYPE_DMABUF) {
+        format = constraints->dmabuf_format;
+        stride = 0;
+    } else {
+        format = constraints->shm_format;
+        stride = constraints->width * (wlm_egl_shm_format_bpp(format) / 8);
+    }
+
+    bool new_buffers_needed =
+        backend->buffer_type != type ||
+        backend->frame_width != constraints->width ||
+        backend->frame_height != constraints->height ||
+        backend->frame_stride != stride ||
+        backend->frame_format != format;
+
+    // drop all buffers if buffer type or constraints changed
+    if (new_buffers_needed) {
+        wlm_log_debug(ctx, "mirror-extcopy::select_buffer_type(): using %s buffers\n", type == BUFFER_TYPE_DMABUF ? "dmabuf" : "shm");
+        destroy_buffers(backend);
+        backend->buffer_type = type;
+        backend->frame_width = constraints->width;
+        backend->frame_height = constraints->height;
+        backend->frame_stride = stride;
+        backend->frame_format = format;
+    }
+}
+
+static extcopy_buffer_t * prepare_buffer(ctx_t * ctx, extcopy_mirror_backend_t * backend) {
+    // prefer dmabuf buffers, they stay on the GPU and need no upload
+    bool use_dmabuf =
+        backend->constraints.has_dmabuf_format &&
+        ctx->allocator.available &&
+        !backend->dmabuf_failed;
+    if (!use_dmabuf && !backend->constraints.has_shm_format) {
+        wlm_log_error("mirror-extcopy::prepare_buffer(): no supported buffer format\n");
+        return NULL;
+    }
+
+    select_buffer_type(ctx, backend, use_dmabuf ? BUFFER_TYPE_DMABUF : BUFFER_TYPE_SHM);
+
+    // find a buffer that is neither being written, waiting for upload, nor imported
+    extcopy_buffer_t * buffer = NULL;
+    for (size_t i = 0; i < EXTCOPY_BUFFER_COUNT; i++) {
+        if (backend->buffers[i].state == BUFFER_FREE) {
+            backend->capture_buffer = i;
+            buffer = &backend->buffers[i];
+            break;
+        }
+    }
+
+    if (buffer == NULL) {
+        wlm_log_error("mirror-extcopy::prepare_buffer(): no free buffer available\n");
+        return NULL;
+    }
+
+    // buffers persist across frames, only create missing ones
+    if (buffer->buffer == NULL && backend->buffer_type == BUFFER_TYPE_DMABUF) {
+        if (!create_dmabuf_buffer(ctx, backend, buffer)) {
+            wlm_log_debug(ctx, "mirror-extcopy::prepare_buffer(): falling back to shm buffers\n");
+            backend->dmabuf_failed = true;
+            return prepare_buffer(ctx, backend);
+        }
+    } else if (buffer->buffer == NULL) {
+        if (!create_shm_buffer(backend, buffer)) {
+            return NULL;
+        }
+    }
+
+    return buffer;
+}
+
+// --- capture_session event handlers ---
+
+static void on_buffer_size(
+    void * data, struct ext_image_copy_capture_session_v1 * session,
+    uint32_t width, uint32_t height
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_debug(ctx, "mirror-extcopy::on_buffer_size(): buffer size is %dx%d\n", width, height);
+    backend->pending_constraints.width = width;
+    backend->pending_constraints.height = height;
+
+    (void)session;
+}
+
+static void on_shm_format(
+    void * data, struct ext_image_copy_capture_session_v1 * session,
+    uint32_t format
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    // use the first format that can be uploaded
+    if (!backend->pending_constraints.has_shm_format && wlm_egl_shm_format_bpp(format) != 0) {
+        wlm_log_debug(ctx, "mirror-extcopy::on_shm_format(): using shm format %08x\n", format);
+        backend->pending_constraints.has_shm_format = true;
+        backend->pending_constraints.shm_format = format;
+    }
+
+    (void)session;
+}
+
+static void on_dmabuf_device(
+    void * data, struct ext_image_copy_capture_session_v1 * session,
+    struct wl_array * device
+) {
+    (void)data;
+    (void)session;
+    (void)device;
+}
+
+static void on_dmabuf_format(
+    void * data, struct ext_image_copy_capture_session_v1 * session,
+    uint32_t format, struct wl_array * modifiers
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    if (backend->pending_constraints.has_dmabuf_format) {
+        return;
+    }
+
+    // use the first format that supports linear buffers
+    uint64_t * modifier;
+    wl_array_for_each(modifier, modifiers) {
+        if (*modifier == DRM_FORMAT_MOD_LINEAR) {
+            wlm_log_debug(ctx, "mirror-extcopy::on_dmabuf_format(): using dmabuf format %08x\n", format);
+            backend->pending_constraints.has_dmabuf_format = true;
+            backend->pending_constraints.dmabuf_format = format;
+            break;
+        }
+    }
+
+    (void)session;
+}
+
+static void on_session_done(
+    void * data, struct ext_image_copy_capture_session_v1 * session
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_debug(ctx, "mirror-extcopy::on_session_done(): received buffer constraints\n");
+
+    // constraints are always sent as a complete set
+    backend->constraints = backend->pending_constraints;
+    backend->constraints_valid = true;
+    backend->pending_constraints = (extcopy_constraints_t){ 0 };
+
+    if (backend->state == STATE_WAIT_CONSTRAINTS) {
+        set_state(ctx, backend, STATE_READY);
+    }
+
+    (void)session;
+}
+
+static void on_session_stopped(
+    void * data, struct ext_image_copy_capture_session_v1 * session
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_error("mirror-extcopy::on_session_stopped(): capture session stopped\n");
+
+    // session is recreated on the next capture
+    destroy_session(ctx, backend);
+    backend->header.fail_count++;
+
+    (void)session;
+}
+
+static const struct ext_image_copy_capture_session_v1_listener capture_session_listener = {
+    .buffer_size = on_buffer_size,
+    .shm_format = on_shm_format,
+    .dmabuf_device = on_dmabuf_device,
+    .dmabuf_format = on_dmabuf_format,
+    .done = on_session_done,
+    .stopped = on_session_stopped
+};
+
+// --- capture_frame event handlers ---
+
+static void on_transform(
+    void * data, struct ext_image_copy_capture_frame_v1 * frame,
+    uint32_t transform
+) {
+    (void)data;
+    (void)frame;
+    (void)transform;
+}
+
+static void on_damage(
+    void * data, struct ext_image_copy_capture_frame_v1 * frame,
+    int32_t x, int32_t y, int32_t width, int32_t height
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    if (x < 0 || y < 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    // clamp damage to frame bounds
+    region_t rect = { .x = x, .y = y, .width = width, .height = height };
+    region_t bounds = { .x = 0, .y = 0, .width = backend->frame_width, .height = backend->frame_height };
+    if (rect.x >= bounds.width || rect.y >= bounds.height) {
+        return;
+    }
+    wlm_util_region_clamp(&rect, &bounds);
+
+    wlm_util_damage_add(&backend->frame_damage, &rect);
+
+    (void)frame;
+}
+
+static void on_presentation_time(
+    void * data, struct ext_image_copy_capture_frame_v1 * frame,
+    uint32_t sec_hi, uint32_t sec_lo, uint32_t nsec
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_stats_mark(ctx, STATS_MARK_EVENT);
+    backend->frame_timestamp_ns = wlm_mirror_frame_timestamp(sec_hi, sec_lo, nsec);
+
+    (void)frame;
+}
+
+static void on_ready(
+    void * data, struct ext_image_copy_capture_frame_v1 * frame
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_debug(ctx, "mirror-extcopy::on_ready(): frame is ready\n");
+    wlm_stats_mark(ctx, STATS_MARK_READY);
+    if (backend->state != STATE_WAIT_READY) {
+        wlm_log_error("mirror-extcopy::on_ready(): got ready while in state %d\n", backend->state);
+        frame_cancel(ctx, backend);
+        return;
+    }
+
+    // all other buffers are now stale in the damaged regions
+    for (size_t i = 0; i < EXTCOPY_BUFFER_COUNT; i++) {
+        if (i == backend->capture_buffer) continue;
+        wlm_util_damage_merge(&backend->buffers[i].stale_damage, &backend->frame_damage);
+    }
+
+    // drop previous finished frame if it was not uploaded yet
+    for (size_t i = 0; i < EXTCOPY_BUFFER_COUNT; i++) {
+        if (backend->buffers[i].state == BUFFER_READY) {
+            wlm_log_debug(ctx, "mirror-extcopy::on_ready(): dropping frame that was not uploaded\n");
+            wlm_stats_frame_dropped(ctx);
+            backend->buffers[i].state = BUFFER_FREE;
+        }
+    }
+
+    // damage of dropped frames still needs to be uploaded
+    wlm_util_damage_merge(&backend->upload_damage, &backend->frame_damage);
+
+    // mark buffer as finished, upload happens before the next draw
+    backend->buffers[backend->capture_buffer].timestamp_ns = backend->frame_timestamp_ns;
+    backend->buffers[backend->capture_buffer].state = BUFFER_READY;
+
+    ext_image_copy_capture_frame_v1_destroy(backend->capture_frame);
+    backend->capture_frame = NULL;
+    set_state(ctx, backend, STATE_READY);
+    backend->header.fail_count = 0;
+
+    // request next frame without waiting for the next frame callback
+    wlm_mirror_frame_ready(ctx);
+
+    (void)frame;
+}
+
+static void on_failed(
+    void * data, struct ext_image_copy_capture_frame_v1 * frame,
+    uint32_t reason
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    switch (reason) {
+        case EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_BUFFER_CONSTRAINTS:
+            // new constraints arrive with the next session done event
+            wlm_log_debug(ctx, "mirror-extcopy::on_failed(): buffer constraints changed\n");
+            ext_image_copy_capture_frame_v1_destroy(backend->capture_frame);
+            backend->capture_frame = NULL;
+            destroy_buffers(backend);
+            set_state(ctx, backend, STATE_CANCELED);
+            backend->header.cancel_count++;
+            break;
+
+        case EXT_IMAGE_COPY_CAPTURE_FRAME_V1_FAILURE_REASON_STOPPED:
+            // session stopped event follows
+            wlm_log_debug(ctx, "mirror-extcopy::on_failed(): capture session stopped\n");
+            frame_cancel(ctx, backend);
+            break;
+
+        default:
+            // compositor may reject our dmabuf buffers, use shm for the next capture
+            wlm_log_debug(ctx, "mirror-extcopy::on_failed(): capture failed\n");
+            if (backend->buffer_type == BUFFER_TYPE_DMABUF) {
+                wlm_log_debug(ctx, "mirror-extcopy::on_failed(): falling back to shm buffers\n");
+                backend->dmabuf_failed = true;
+            }
+            frame_cancel(ctx, backend);
+            break;
+    }
+
+    (void)frame;
+}
+
+static const struct ext_image_copy_capture_frame_v1_listener capture_frame_listener = {
+    .transform = on_transform,
+    .damage = on_damage,
+    .presentation_time = on_presentation_time,
+    .ready = on_ready,
+    .failed = on_failed
+};
+
+// --- backend event handlers ---
+
+static bool create_session(ctx_t * ctx, extcopy_mirror_backend_t * backend, const mirror_capture_params_t * params) {
+    // create capture source for target toplevel or output
+    if (params->toplevel != NULL) {
+        if (ctx->wl.toplevel_capture_source_manager == NULL) {
+            wlm_log_error("mirror-extcopy::create_session(): missing ext_foreign_toplevel_image_capture_source protocol\n");
+            return false;
+        }
+
+        backend->capture_source = ext_foreign_toplevel_image_capture_source_manager_v1_create_source(
+            ctx->wl.toplevel_capture_source_manager, params->toplevel->handle
+        );
+    } else {
+        if (ctx->wl.output_capture_source_manager == NULL) {
+            wlm_log_error("mirror-extcopy::create_session(): missing ext_output_image_capture_source protocol\n");
+            return false;
+        }
+
+        backend->capture_source = ext_output_image_capture_source_manager_v1_create_source(
+            ctx->wl.output_capture_source_manager, params->target->output
+        );
+    }
+    if (backend->capture_source == NULL) {
+        wlm_log_error("mirror-extcopy::create_session(): failed to create capture source\n");
+        return false;
+    }
+
+    uint32_t options = params->show_cursor ? EXT_IMAGE_COPY_CAPTURE_MANAGER_V1_OPTIONS_PAINT_CURSORS : 0;
+    backend->capture_session = ext_image_copy_capture_manager_v1_create_session(
+        ctx->wl.copy_capture_manager, backend->capture_source, options
+    );
+    if (backend->capture_session == NULL) {
+        wlm_log_error("mirror-extcopy::create_session(): failed to create capture session\n");
+        return false;
+    }
+
+    // add capture_session event listener
+    // - for buffer_size event
+    // - for shm_format event
+    // - for dmabuf_device event
+    // - for dmabuf_format event
+    // - for done event
+    // - for stopped event
+    ext_image_copy_capture_session_v1_add_listener(backend->capture_session, &capture_session_listener, (void *)ctx);
+
+    backend->session_target = params->target;
+    backend->session_toplevel = params->toplevel;
+    backend->session_cursor = params->show_cursor;
+    backend->constraints_valid = false;
+    backend->pending_constraints = (extcopy_constraints_t){ 0 };
+    set_state(ctx, backend, STATE_WAIT_CONSTRAINTS);
+    return true;
+}
+
+static bool do_capture(ctx_t * ctx, const mirror_capture_params_t * params) {
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    // sessions are bound to a capture source and cursor mode, recreate them on change
+    if (
+        backend->capture_session != NULL && (
+            backend->session_target != params->target ||
+            backend->session_toplevel != params->toplevel ||
+            backend->session_cursor != params->show_cursor
+        )
+    ) {
+        wlm_log_debug(ctx, "mirror-extcopy::do_capture(): capture target changed, recreating session\n");
+        destroy_session(ctx, backend);
+    }
+
+    if (backend->capture_session == NULL && !create_session(ctx, backend, params)) {
+        destroy_session(ctx, backend);
+        wlm_mirror_backend_fail(ctx);
+        return false;
+    }
+
+    if (backend->state != STATE_READY && backend->state != STATE_CANCELED) {
+        return false;
+    }
+
+    extcopy_buffer_t * buffer = prepare_buffer(ctx, backend);
+    if (buffer == NULL) {
+        backend->header.fail_count++;
+        return false;
+    }
+
+    // create capture frame
+    backend->capture_frame = ext_image_copy_capture_session_v1_create_frame(backend->capture_session);
+    if (backend->capture_frame == NULL) {
+        wlm_log_error("mirror-extcopy::do_capture(): failed to create capture frame\n");
+        wlm_mirror_backend_fail(ctx);
+        return false;
+    }
+
+    // add capture_frame event listener
+    // - for transform event
+    // - for damage event
+    // - for presentation_time event
+    // - for ready event
+    // - for failed event
+    ext_image_copy_capture_frame_v1_add_listener(backend->capture_frame, &capture_frame_listener, (void *)ctx);
+
+    // tell the compositor which regions of the reused buffer are outdated
+    // - the backend benchmark always damages the full buffer, so every
+    //   backend is measured copying full frames
+    ext_image_copy_capture_frame_v1_attach_buffer(backend->capture_frame, buffer->buffer);
+    if (buffer->fully_stale || ctx->mirror.benchmarking) {
+        ext_image_copy_capture_frame_v1_damage_buffer(backend->capture_frame,
+            0, 0, backend->frame_width, backend->frame_height
+        );
+    } else {
+        for (size_t i = 0; i < buffer->stale_damage.count; i++) {
+            const region_t * rect = &buffer->stale_damage.rects[i];
+            ext_image_copy_capture_frame_v1_damage_buffer(backend->capture_frame,
+                rect->x, rect->y, rect->width, rect->height
+            );
+        }
+    }
+    wlm_util_damage_clear(&buffer->stale_damage);
+    buffer->fully_stale = false;
+
+    ext_image_copy_capture_frame_v1_capture(backend->capture_frame);
+
+    buffer->state = BUFFER_BUSY;
+    wlm_util_damage_clear(&backend->frame_damage);
+    backend->frame_timestamp_ns = 0;
+    set_state(ctx, backend, STATE_WAIT_READY);
+    return true;
+}
+
+static bool do_cancel(ctx_t * ctx) {
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    // constraints are sent right after the session is created
+    // - the session is recreated on the next capture
+    if (backend->state == STATE_WAIT_CONSTRAINTS && backend->capture_session != NULL) {
+        wlm_log_debug(ctx, "mirror-extcopy::do_cancel(): abandoning capture session\n");
+        destroy_session(ctx, backend);
+        return true;
+    }
+
+    // frames wait for damage before they become ready
+    if (backend->state == STATE_WAIT_READY) {
+        wlm_log_debug(ctx, "mirror-extcopy::do_cancel(): abandoning capture\n");
+        frame_abandon(ctx, backend);
+    }
+
+    return false;
+}
+
+static void do_upload(ctx_t * ctx) {
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    // find newest finished frame
+    extcopy_buffer_t * buffer = NULL;
+    for (size_t i = 0; i < EXTCOPY_BUFFER_COUNT; i++) {
+        if (backend->buffers[i].state == BUFFER_READY) {
+            buffer = &backend->buffers[i];
+            break;
+        }
+    }
+
+    if (buffer == NULL) {
+        return;
+    }
+
+    // keep presenting the last frame instead of a stale one
+    // - its damage stays in upload_damage for the next frame
+    if (!wlm_mirror_frame_accept(ctx, buffer->timestamp_ns)) {
+        buffer->state = BUFFER_FREE;
+        return;
+    }
+
+    if (backend->buffer_type == BUFFER_TYPE_DMABUF) {
+        // import dmabuf into texture
+        if (!wlm_egl_dmabuf_to_texture(ctx, &buffer->dmabuf)) {
+            wlm_log_error("mirror-extcopy::do_upload(): failed to import dmabuf, falling back to shm buffers\n");
+            backend->dmabuf_failed = true;
+            buffer->state = BUFFER_FREE;
+            return;
+        }
+
+        // texture no longer holds shm contents
+        backend->texture_valid = false;
+        wlm_util_damage_clear(&backend->upload_damage);
+
+        // previously imported buffer can be reused for capturing
+        // - the texture keeps referencing this buffer until the next import
+        for (size_t i = 0; i < EXTCOPY_BUFFER_COUNT; i++) {
+            if (backend->buffers[i].state == BUFFER_IMPORTED) {
+                backend->buffers[i].state = BUFFER_FREE;
+            }
+        }
+        buffer->state = BUFFER_IMPORTED;
+    } else {
+        // store frame data into texture
+        // - complete upload if texture does not hold a previous frame
+        // - otherwise only upload damaged rectangles
+        const region_t * rects = backend->texture_valid ? backend->upload_damage.rects : NULL;
+        size_t rect_count = backend->texture_valid ? backend->upload_damage.count : 0;
+        if (!wlm_egl_shm_to_texture(ctx,
+            (uint8_t *)backend->shm_addr + buffer->shm_offset,
+            backend->frame_width, backend->frame_height,
+            backend->frame_stride, backend->frame_format,
+            rects, rect_count
+        )) {
+            wlm_log_error("mirror-extcopy::do_upload(): failed to upload shm buffer\n");
+            wlm_mirror_backend_fail(ctx);
+            return;
+        }
+        backend->texture_valid = true;
+        wlm_util_damage_clear(&backend->upload_damage);
+
+        // buffer can be reused for capturing
+        buffer->state = BUFFER_FREE;
+    }
+
+    // captured frames always contain the full output
+    ctx->egl.texture_region_aware = false;
+    ctx->egl.texture_initialized = true;
+
+    // captured frames are never y-inverted
+    if (ctx->mirror.invert_y) {
+        ctx->mirror.invert_y = false;
+        wlm_egl_update_uniforms(ctx);
+    }
+
+    // set texture size and aspect ratio only if changed
+    if (backend->frame_width != ctx->egl.width || backend->frame_height != ctx->egl.height) {
+        ctx->egl.width = backend->frame_width;
+        ctx->egl.height = backend->frame_height;
+        wlm_egl_resize_viewport(ctx);
+    }
+}
+
+static void do_cleanup(ctx_t * ctx) {
+    extcopy_mirror_backend_t * backend = (extcopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_debug(ctx, "mirror-extcopy::do_cleanup(): destroying mirror-extcopy objects\n");
+
+    destroy_session(ctx, backend);
+    wlm_trace_state(ctx, state_names[backend->state], NULL);
+    if (backend->shm_pool != NULL) wl_shm_pool_destroy(backend->shm_pool);
+    if (backend->shm_addr != NULL) munmap(backend->shm_addr, backend->shm_size);
+    if (backend->shm_fd != -1) close(backend->shm_fd);
+
+    free(backend);
+    ctx->mirror.backend = NULL;
+}
+
+// --- init_mirror_extcopy ---
+
+void wlm_mirror_extcopy_init(ctx_t * ctx) {
+    // check for required protocols
+    if (ctx->wl.shm == NULL) {
+        wlm_log_error("mirror-extcopy::init(): missing wl_shm protocol\n");
+        return;
+    } else if (ctx->wl.copy_capture_manager == NULL) {
+        wlm_log_error("mirror-extcopy::init(): missing ext_image_copy_capture protocol\n");
+        return;
+    } else if (ctx->mirror.current_toplevel == NULL && ctx->wl.output_capture_source_manager == NULL) {
+        wlm_log_error("mirror-extcopy::init(): missing ext_output_image_capture_source protocol\n");
+        return;
+    } else if (ctx->mirror.current_toplevel != NULL && ctx->wl.toplevel_capture_source_manager == NULL) {
+        wlm_log_error("mirror-extcopy::init(): missing ext_foreign_toplevel_image_capture_source protocol\n");
+        return;
+    }
+
+    // allocate backend context structure
+    extcopy_mirror_backend_t * backend = calloc(1, sizeof (extcopy_mirror_backend_t));
+    if (backend == NULL) {
+        wlm_log_error("mirror-extcopy::init(): failed to allocate backend state\n");
+        return;
+    }
+
+    // initialize context structure
+    backend->header.name = "extcopy";
+    backend->header.do_capture = do_capture;
+    backend->header.do_upload = do_upload;
+    backend->header.do_cleanup = do_cleanup;
+    backend->header.do_cancel = do_cancel;
+    backend->header.fail_count = 0;
+    backend->header.cancel_count = 0;
+    backend->header.capture_in_flight = false;
+    backend->header.waiting_for_damage = false;
+    // buffer states are shared with uploads, capture events stay on the main queue
+    backend->header.capture_thread = false;
+
+    backend->shm_fd = -1;
+    backend->shm_size = 0;
+    backend->shm_addr = NULL;
+    backend->shm_pool = NULL;
+
+    backend->session_target = NULL;
+    backend->session_toplevel = NULL;
+    backend->session_cursor = false;
+    backend->capture_source = NULL;
+    backend->capture_session = NULL;
+    backend->capture_frame = NULL;
+
+    backend->pending_constraints = (extcopy_constraints_t){ 0 };
+    backend->constraints = (extcopy_constraints_t){ 0 };
+    backend->constraints_valid = false;
+
+    backend->buffer_type = BUFFER_TYPE_SHM;
+    destroy_buffers(backend);
+    backend->capture_buffer = 0;
+    backend->frame_width = 0;
+    backend->frame_height = 0;
+    backend->frame_stride = 0;
+    backend->frame_format = 0;
+    backend->dmabuf_failed = false;
+
+    wlm_util_damage_clear(&backend->frame_damage);
+    wlm_util_damage_clear(&backend->upload_damage);
+    backend->texture_valid = false;
+    backend->frame_timestamp_ns = 0;
+
+    backend->state = STATE_WAIT_CONSTRAINTS;
+
+    // set backend object as current backend
+    ctx->mirror.backend = (mirror_backend_t *)backend;
+
+    // create shm fd
+    backend->shm_fd = memfd_create("wl_shm_buffer", 0);
+    if (backend->shm_fd == -1) {
+        wlm_log_error("mirror-extcopy::init(): failed to create shm buffer\n");
+        wlm_mirror_backend_fail(ctx);
+        return;
+    }
+
+    // resize shm fd to nonempty size
+    backend->shm_size = 1;
+    if (ftruncate(backend->shm_fd, backend->shm_size) == -1) {
+        wlm_log_error("mirror-extcopy::init(): failed to resize shm buffer\n");
+        wlm_mirror_backend_fail(ctx);
+        return;
+    }
+
+    // map shm fd
+    backend->shm_addr = mmap(NULL, backend->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, backend->shm_fd, 0);
+    if (backend->shm_addr == MAP_FAILED) {
+        backend->shm_addr = NULL;
+        wlm_log_error("mirror-extcopy::init(): failed to map shm buffer\n");
+        wlm_mirror_backend_fail(ctx);
+        return;
+    }
+
+    // create shm pool from shm fd
+    backend->shm_pool = wl_shm_create_pool(ctx->wl.shm, backend->shm_fd, backend->shm_size);
+    if (backend->shm_pool == NULL) {
+        wlm_log_error("mirror-extcopy::init(): failed to create shm pool\n");
+        wlm_mirror_backend_fail(ctx);
+        return;
+    }
+
+    // create capture session to receive buffer constraints early
+    mirror_capture_params_t params;
+    wlm_mirror_capture_params(ctx, &params);
+    if (!create_session(ctx, backend, &params)) {
+        destroy_session(ctx, backend);
+        wlm_mirror_backend_fail(ctx);
+        return;
+    }
+}
@@ -10,211 +10,215 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
-static void backend_cancel(screencopy_mirror_backend_t * backend) {
-    wlm_log_error("mirror-screencopy::backend_cancel(): cancelling capture due to error\n");
+// --- state tracking ---
+
+// waiting states are shown as slices in the trace
+static const char * state_names[] = {
+    [STATE_WAIT_BUFFER] = "screencopy::wait_buffer",
+    [STATE_WAIT_BUFFER_DONE] = "screencopy::wait_buffer_done",
+    [STATE_WAIT_FLAGS] = "screencopy::wait_flags",
+    [STATE_WAIT_READY] = "screencopy::wait_ready",
+    [STATE_READY] = NULL,
+    [STATE_CANCELED] = NULL
+};
+
+static void set_state(ctx_t * ctx, screencopy_mirror_backend_t * backend, screencopy_state_t state) {
+    wlm_trace_state(ctx, state_names[backend->state], state_names[state]);
+    atomic_store(&backend->header.capture_in_flight, state != STATE_READY && state != STATE_CANCELED);
+    atomic_store(&backend->header.waiting_for_damage,
+        backend->copy_with_damage && (state == STATE_WAIT_FLAGS || state == STATE_WAIT_READY)
+    );
+    backend->state = state;
+}
+
+// --- buffer management ---
 
+static void frame_abandon(ctx_t * ctx, screencopy_mirror_backend_t * backend) {
     // destroy screencopy frame object
     zwlr_screencopy_frame_v1_destroy(backend->screencopy_frame);
     backend->screencopy_frame = NULL;
-    backend->state = STATE_CANCELED;
-    backend->header.fail_count++;
-}
+    set_state(ctx, backend, STATE_CANCELED);
+
+    // damage of the canceled capture is lost, next upload must be complete
+    backend->texture_valid = false;
 
-typedef struct {
-    uint32_t shm_format;
-    uint32_t bpp;
-    GLint gl_format;
-    GLint gl_type;
-} shm_gl_format_t;
-
-static const shm_gl_format_t shm_gl_formats[] = {
-    {
-        .shm_format = WL_SHM_FORMAT_ARGB8888,
-        .bpp = 32,
-        .gl_format = GL_BGRA_EXT,
-        .gl_type = GL_UNSIGNED_BYTE,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_XRGB8888,
-        .bpp = 32,
-        .gl_format = GL_BGRA_EXT,
-        .gl_type = GL_UNSIGNED_BYTE,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_XBGR8888,
-        .bpp = 32,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_BYTE,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_ABGR8888,
-        .bpp = 32,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_BYTE,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_BGR888,
-        .bpp = 24,
-        .gl_format = GL_RGB,
-        .gl_type = GL_UNSIGNED_BYTE,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_RGBX4444,
-        .bpp = 16,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_SHORT_4_4_4_4,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_RGBA4444,
-        .bpp = 16,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_SHORT_4_4_4_4,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_RGBX5551,
-        .bpp = 16,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_SHORT_5_5_5_1,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_RGBA5551,
-        .bpp = 16,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_SHORT_5_5_5_1,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_RGB565,
-        .bpp = 16,
-        .gl_format = GL_RGB,
-        .gl_type = GL_UNSIGNED_SHORT_5_6_5,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_XBGR2101010,
-        .bpp = 32,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_INT_2_10_10_10_REV_EXT,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_ABGR2101010,
-        .bpp = 32,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_UNSIGNED_INT_2_10_10_10_REV_EXT,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_XBGR16161616F,
-        .bpp = 64,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_HALF_FLOAT_OES,
-    },
-    {
-        .shm_format = WL_SHM_FORMAT_ABGR16161616F,
-        .bpp = 64,
-        .gl_format = GL_RGBA,
-        .gl_type = GL_HALF_FLOAT_OES,
-    },
-    {
-        .shm_format = -1U,
-        .bpp = -1U,
-        .gl_format = -1,
-        .gl_type = -1
+    // release buffer of the canceled capture
+    screencopy_buffer_t * buffer = &backend->buffers[backend->capture_buffer];
+    if (buffer->state == BUFFER_BUSY) {
+        buffer->state = BUFFER_FREE;
     }
-};
+}
 
-static const shm_gl_format_t * shm_gl_format_from_shm(uint32_t shm_format) {
-    const shm_gl_format_t * format = shm_gl_formats;
-    while (format->shm_format != -1U) {
-        if (format->shm_format == shm_format) {
-            return format;
-        }
+static void backend_cancel(ctx_t * ctx, screencopy_mirror_backend_t * backend) {
+    wlm_log_error("mirror-screencopy::backend_cancel(): cancelling capture due to error\n");
+
+    frame_abandon(ctx, backend);
+    backend->header.fail_count++;
+    backend->header.cancel_count++;
+}
 
-        format++;
+static void destroy_buffers(screencopy_mirror_backend_t * backend) {
+    for (size_t i = 0; i < SCREENCOPY_BUFFER_COUNT; i++) {
+        screencopy_buffer_t * buffer = &backend->buffers[i];
+        if (buffer->buffer != NULL) wl_buffer_destroy(buffer->buffer);
+        wlm_allocator_dmabuf_destroy(&buffer->dmabuf);
+
+        buffer->buffer = NULL;
+        buffer->shm_offset = 0;
+        buffer->frame_flags = 0;
+        buffer->timestamp_ns = 0;
+        buffer->state = BUFFER_FREE;
     }
 
-    return NULL;
+    // texture contents no longer match the new buffers
+    backend->texture_valid = false;
+    wlm_util_damage_clear(&backend->upload_damage);
 }
 
-// --- screencopy_frame event handlers ---
-
-static void on_buffer(
-    void * data, struct zwlr_screencopy_frame_v1 * frame,
-    uint32_t format, uint32_t width, uint32_t height, uint32_t stride
-) {
-    ctx_t * ctx = (ctx_t *)data;
-    screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
+// --- buffer preparation ---
 
-    wlm_log_debug(ctx, "mirror-screencopy::on_buffer(): received buffer offer for %dx%d+%d frame\n", width, height, stride);
-    if (backend->state != STATE_WAIT_BUFFER) {
-        wlm_log_error("mirror-screencopy::on_buffer(): got buffer event while in state %d\n", backend->state);
-        backend_cancel(backend);
-        return;
+static bool grow_shm_pool(screencopy_mirror_backend_t * backend, size_t new_size) {
+    if (new_size <= backend->shm_size) {
+        return true;
     }
 
-    size_t new_size = stride * height;
-    if (new_size > backend->shm_size) {
-        if (backend->shm_buffer != NULL) {
-            wl_buffer_destroy(backend->shm_buffer);
-            backend->shm_buffer = NULL;
-        }
-
-        if (ftruncate(backend->shm_fd, new_size) == -1) {
-            wlm_log_error("mirror-screencopy::on_buffer(): failed to grow shm buffer\n");
-            backend_cancel(backend);
-            return;
-        }
+    if (ftruncate(backend->shm_fd, new_size) == -1) {
+        wlm_log_error("mirror-screencopy::grow_shm_pool(): failed to grow shm buffer\n");
+        return false;
+    }
 
 #if __linux__
-        void * new_addr = mremap(backend->shm_addr, backend->shm_size, new_size, MREMAP_MAYMOVE);
-        if (new_addr == MAP_FAILED) {
-            wlm_log_error("mirror-screencopy::on_buffer(): failed to remap shm buffer\n");
-            backend_cancel(backend);
-            return;
-        }
+    void * new_addr = mremap(backend->shm_addr, backend->shm_size, new_size, MREMAP_MAYMOVE);
+    if (new_addr == MAP_FAILED) {
+        wlm_log_error("mirror-screencopy::grow_shm_pool(): failed to remap shm buffer\n");
+        return false;
+    }
 #else
-        void * new_addr = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, backend->shm_fd, 0);
-        if (new_addr == MAP_FAILED) {
-            wlm_log_error("mirror-screencopy::on_buffer(): failed to map new shm buffer\n");
-            backend_cancel(backend);
-            return;
-        } else {
-            munmap(backend->shm_addr, backend->shm_size);
-        }
+    void * new_addr = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, backend->shm_fd, 0);
+    if (new_addr == MAP_FAILED) {
+        wlm_log_error("mirror-screencopy::grow_shm_pool(): failed to map new shm buffer\n");
+        return false;
+    } else {
+        munmap(backend->shm_addr, backend->shm_size);
+    }
 #endif
 
-        backend->shm_addr = new_addr;
-        backend->shm_size = new_size;
+    backend->shm_addr = new_addr;
+    backend->shm_size = new_size;
 
-        wl_shm_pool_resize(backend->shm_pool, new_size);
+    wl_shm_pool_resize(backend->shm_pool, new_size);
+    return true;
+}
+
+static bool create_shm_buffer(screencopy_mirror_backend_t * backend, screencopy_buffer_t * buffer, const screencopy_offer_t * offer) {
+    // carve wl_buffer out of the shared pool
+    size_t frame_size = (size_t)offer->stride * offer->height;
+    if (!grow_shm_pool(backend, frame_size * (backend->capture_buffer + 1))) {
+        return false;
     }
 
-    bool new_buffer_needed =
-        backend->frame_width != width ||
-        backend->frame_height != height ||
-        backend->frame_stride != stride ||
-        backend->frame_format != format;
+    buffer->shm_offset = frame_size * backend->capture_buffer;
+    buffer->buffer = wl_shm_pool_create_buffer(
+        backend->shm_pool, buffer->shm_offset,
+        offer->width, offer->height,
+        offer->stride, offer->format
+    );
+    if (buffer->buffer == NULL) {
+        wlm_log_error("mirror-screencopy::create_shm_buffer(): failed to create wl_buffer\n");
+        return false;
+    }
 
-    if (backend->shm_buffer != NULL && new_buffer_needed) {
-        wl_buffer_destroy(backend->shm_buffer);
-        backend->shm_buffer = NULL;
+    return true;
+}
+
+static bool create_dmabuf_buffer(ctx_t * ctx, screencopy_buffer_t * buffer, const screencopy_offer_t * offer) {
+    if (!wlm_allocator_dmabuf_create(ctx, &buffer->dmabuf, offer->width, offer->height, offer->format)) {
+        wlm_log_debug(ctx, "mirror-screencopy::create_dmabuf_buffer(): failed to allocate dmabuf\n");
+        return false;
     }
 
-    if (backend->shm_buffer == NULL) {
-        backend->shm_buffer = wl_shm_pool_create_buffer(
-            backend->shm_pool, 0,
-            width, height,
-            stride, format
-        );
-        if (backend->shm_buffer == NULL) {
-            wlm_log_error("mirror-screencopy::on_buffer(): failed to create wl_buffer\n");
-            backend_cancel(backend);
-            return;
+    buffer->buffer = wlm_allocator_dmabuf_to_wl_buffer(ctx, &buffer->dmabuf);
+    if (buffer->buffer == NULL) {
+        wlm_log_debug(ctx, "mirror-screencopy::create_dmabuf_buffer(): failed to create wl_buffer\n");
+        wlm_allocator_dmabuf_destroy(&buffer->dmabuf);
+        return false;
+    }
+
+    return true;
+}
+
+static screencopy_buffer_t * prepare_buffer(
+    ctx_t * ctx, screencopy_mirror_backend_t * backend,
+    screencopy_buffer_type_t type, const screencopy_offer_t * offer
+) {
+    bool new_buffers_needed =
+        backend->buffer_type != type ||
+        backend->frame_width != offer->width ||
+        backend->frame_height != offer->height ||
+        backend->frame_stride != offer->stride ||
+        backend->frame_format != offer->format;
+
+    // drop all buffers if buffer type or frame parameters changed
+    // - this also drops a finished frame that was not yet uploaded
+    if (new_buffers_needed) {
+        destroy_buffers(backend);
+        backend->buffer_type = type;
+        backend->frame_width = offer->width;
+        backend->frame_height = offer->height;
+        backend->frame_stride = offer->stride;
+        backend->frame_format = offer->format;
+    }
+
+    // find a buffer that is neither being written, waiting for upload, nor imported
+    screencopy_buffer_t * buffer = NULL;
+    for (size_t i = 0; i < SCREENCOPY_BUFFER_COUNT; i++) {
+        if (backend->buffers[i].state == BUFFER_FREE) {
+            backend->capture_buffer = i;
+            buffer = &backend->buffers[i];
+            break;
+        }
+    }
+
+    if (buffer == NULL) {
+        wlm_log_error("mirror-screencopy::prepare_buffer(): no free buffer available\n");
+        return NULL;
+    }
+
+    if (buffer->buffer == NULL) {
+        bool success = type == BUFFER_TYPE_DMABUF ?
+            create_dmabuf_buffer(ctx, buffer, offer) :
+            create_shm_buffer(backend, buffer, offer);
+        if (!success) {
+            return NULL;
         }
     }
 
-    backend->frame_width = width;
-    backend->frame_height = height;
-    backend->frame_stride = stride;
-    backend->frame_format = format;
-    backend->state = STATE_WAIT_BUFFER_DONE;
+    return buffer;
+}
+
+// --- screencopy_frame event handlers ---
+
+static void on_buffer(
+    void * data, struct zwlr_screencopy_frame_v1 * frame,
+    uint32_t format, uint32_t width, uint32_t height, uint32_t stride
+) {
+    ctx_t * ctx = (ctx_t *)data;
+    screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_debug(ctx, "mirror-screencopy::on_buffer(): received buffer offer for %dx%d+%d frame\n", width, height, stride);
+    if (backend->state != STATE_WAIT_BUFFER && backend->state != STATE_WAIT_BUFFER_DONE) {
+        wlm_log_error("mirror-screencopy::on_buffer(): got buffer event while in state %d\n", backend->state);
+        backend_cancel(ctx, backend);
+        return;
+    }
+
+    wlm_stats_mark(ctx, STATS_MARK_EVENT);
+    backend->shm_offer.offered = true;
+    backend->shm_offer.width = width;
+    backend->shm_offer.height = height;
+    backend->shm_offer.stride = stride;
+    backend->shm_offer.format = format;
+    set_state(ctx, backend, STATE_WAIT_BUFFER_DONE);
 
     (void)frame;
 }
@@ -223,11 +227,25 @@ static void on_linux_dmabuf(
     void * data, struct zwlr_screencopy_frame_v1 * frame,
     uint32_t format, uint32_t width, uint32_t height
 ) {
-    (void)data;
+    ctx_t * ctx = (ctx_t *)data;
+    screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
+
+    wlm_log_debug(ctx, "mirror-screencopy::on_linux_dmabuf(): received dmabuf offer for %dx%d frame\n", width, height);
+    if (backend->state != STATE_WAIT_BUFFER && backend->state != STATE_WAIT_BUFFER_DONE) {
+        wlm_log_error("mirror-screencopy::on_linux_dmabuf(): got linux_dmabuf event while in state %d\n", backend->state);
+        backend_cancel(ctx, backend);
+        return;
+    }
+
+    wlm_stats_mark(ctx, STATS_MARK_EVENT);
+    backend->dmabuf_offer.offered = true;
+    backend->dmabuf_offer.width = width;
+    backend->dmabuf_offer.height = height;
+    backend->dmabuf_offer.stride = 0;
+    backend->dmabuf_offer.format = format;
+    set_state(ctx, backend, STATE_WAIT_BUFFER_DONE);
+
     (void)frame;
-    (void)format;
-    (void)width;
-    (void)height;
 }
 
 static void on_buffer_done(
@@ -239,12 +257,44 @@ static void on_buffer_done(
     wlm_log_debug(ctx, "mirror-screencopy::on_buffer_done(): received buffer done event\n");
     if (backend->state != STATE_WAIT_BUFFER_DONE) {
         wlm_log_error("mirror-screencopy::on_buffer_done(): received buffer_done without supported buffer offer\n");
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
+        return;
+    }
+
+    // prefer dmabuf buffers, they stay on the GPU and need no upload
+    screencopy_buffer_t * buffer = NULL;
+    if (backend->dmabuf_offer.offered && ctx->allocator.available && !backend->dmabuf_failed) {
+        buffer = prepare_buffer(ctx, backend, BUFFER_TYPE_DMABUF, &backend->dmabuf_offer);
+        if (buffer == NULL) {
+            wlm_log_debug(ctx, "mirror-screencopy::on_buffer_done(): falling back to shm buffers\n");
+            backend->dmabuf_failed = true;
+        }
+    }
+
+    if (buffer == NULL && backend->shm_offer.offered) {
+        buffer = prepare_buffer(ctx, backend, BUFFER_TYPE_SHM, &backend->shm_offer);
+    }
+
+    if (buffer == NULL) {
+        wlm_log_error("mirror-screencopy::on_buffer_done(): failed to prepare capture buffer\n");
+        backend_cancel(ctx, backend);
         return;
     }
 
-    backend->state = STATE_WAIT_FLAGS;
-    zwlr_screencopy_frame_v1_copy(backend->screencopy_frame, backend->shm_buffer);
+    buffer->state = BUFFER_BUSY;
+
+    // wait for damage instead of copying unchanged frames
+    // - the backend benchmark copies and uploads full frames, so a static
+    //   screen doesn't make this backend look slower than the others
+    backend->copy_with_damage = !ctx->mirror.benchmarking;
+    set_state(ctx, backend, STATE_WAIT_FLAGS);
+    if (backend->copy_with_damage) {
+        zwlr_screencopy_frame_v1_copy_with_damage(backend->screencopy_frame, buffer->buffer);
+    } else {
+        region_t rect = { .x = 0, .y = 0, .width = backend->frame_width, .height = backend->frame_height };
+        wlm_util_damage_add(&backend->frame_damage, &rect);
+        zwlr_screencopy_frame_v1_copy(backend->screencopy_frame, buffer->buffer);
+    }
 
     (void)frame;
 }
@@ -253,12 +303,26 @@ static void on_damage(
     void * data, struct zwlr_screencopy_frame_v1 * frame,
     uint32_t x, uint32_t y, uint32_t width, uint32_t height
 ) {
-    (void)data;
+    ctx_t * ctx = (ctx_t *)data;
+    screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
+
+    if (backend->state != STATE_WAIT_READY) {
+        wlm_log_error("mirror-screencopy::on_damage(): received unexpected damage event\n");
+        backend_cancel(ctx, backend);
+        return;
+    }
+
+    // clamp damage to frame bounds
+    region_t rect = { .x = x, .y = y, .width = width, .height = height };
+    region_t bounds = { .x = 0, .y = 0, .width = backend->frame_width, .height = backend->frame_height };
+    if (rect.x >= bounds.width || rect.y >= bounds.height) {
+        return;
+    }
+    wlm_util_region_clamp(&rect, &bounds);
+
+    wlm_util_damage_add(&backend->frame_damage, &rect);
+
     (void)frame;
-    (void)x;
-    (void)y;
-    (void)width;
-    (void)height;
 }
 
 static void on_flags(
@@ -271,12 +335,12 @@ static void on_flags(
     wlm_log_debug(ctx, "mirror-screencopy::on_flags(): received flags event\n");
     if (backend->state != STATE_WAIT_FLAGS) {
         wlm_log_error("mirror-screencopy::on_flags(): received unexpected flags event\n");
-        backend_cancel(backend);
+        backend_cancel(ctx, backend);
         return;
     }
 
     backend->frame_flags = flags;
-    backend->state = STATE_WAIT_READY;
+    set_state(ctx, backend, STATE_WAIT_READY);
 
     (void)frame;
 }
@@ -288,6 +352,7 @@ static void on_ready(
     ctx_t * ctx = (ctx_t *)data;
     screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
 
+    wlm_stats_mark(ctx, STATS_MARK_READY);
     if (ctx->opt.verbose) {
         wlm_log_debug(ctx, "mirror-screencopy::on_ready(): received ready event with width: %d, height: %d, stride: %d, format: %c%c%c%c\n",
             backend->frame_width, backend->frame_height,
@@ -299,48 +364,33 @@ static void on_ready(
         );
     }
 
-    // find correct texture format
-    const shm_gl_format_t * format = shm_gl_format_from_shm(backend->frame_format);
-    if (format == NULL) {
-        wlm_log_error("mirror-screencopy::on_ready(): failed to find GL format for shm format\n");
-        wlm_mirror_backend_fail(ctx);
-        return;
+    // drop previous finished frame if it was not uploaded yet
+    for (size_t i = 0; i < SCREENCOPY_BUFFER_COUNT; i++) {
+        if (backend->buffers[i].state == BUFFER_READY) {
+            wlm_log_debug(ctx, "mirror-screencopy::on_ready(): dropping frame that was not uploaded\n");
+            wlm_stats_frame_dropped(ctx);
+            backend->buffers[i].state = BUFFER_FREE;
+        }
     }
 
-    // store frame data into texture
-    glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, backend->frame_stride / (format->bpp / 8));
-    glTexImage2D(GL_TEXTURE_2D,
-        0, format->gl_format, backend->frame_width, backend->frame_height,
-        0, format->gl_format, format->gl_type, backend->shm_addr
-    );
-    glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
-    ctx->egl.format = format->gl_format;
-    ctx->egl.texture_region_aware = true;
-    ctx->egl.texture_initialized = true;
-
-    // set buffer flags
-    bool invert_y = backend->frame_flags & ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT;
-    if (ctx->mirror.invert_y != invert_y) {
-        ctx->mirror.invert_y = invert_y;
-        wlm_egl_update_uniforms(ctx);
-    }
+    // damage of dropped frames still needs to be uploaded
+    wlm_util_damage_merge(&backend->upload_damage, &backend->frame_damage);
 
-    // set texture size and aspect ratio only if changed
-    if (backend->frame_width != ctx->egl.width || backend->frame_height != ctx->egl.height) {
-        ctx->egl.width = backend->frame_width;
-        ctx->egl.height = backend->frame_height;
-        wlm_egl_resize_viewport(ctx);
-    }
+    // mark buffer as finished, upload happens before the next draw
+    screencopy_buffer_t * buffer = &backend->buffers[backend->capture_buffer];
+    buffer->frame_flags = backend->frame_flags;
+    buffer->timestamp_ns = wlm_mirror_frame_timestamp(sec_hi, sec_lo, nsec);
+    buffer->state = BUFFER_READY;
 
     zwlr_screencopy_frame_v1_destroy(backend->screencopy_frame);
     backend->screencopy_frame = NULL;
-    backend->state = STATE_READY;
+    set_state(ctx, backend, STATE_READY);
     backend->header.fail_count = 0;
 
+    // request next frame without waiting for the next frame callback
+    wlm_mirror_frame_ready(ctx);
+
     (void)frame;
-    (void)sec_hi;
-    (void)sec_lo;
-    (void)nsec;
 }
 
 static void on_failed(
@@ -351,7 +401,13 @@ static void on_failed(
 
     wlm_log_debug(ctx, "mirror-screencopy::on_failed(): received cancel event\n");
 
-    backend_cancel(backend);
+    // compositor may reject our dmabuf buffers, use shm for the next capture
+    if (backend->buffer_type == BUFFER_TYPE_DMABUF) {
+        wlm_log_debug(ctx, "mirror-screencopy::on_failed(): falling back to shm buffers\n");
+        backend->dmabuf_failed = true;
+    }
+
+    backend_cancel(ctx, backend);
 
     (void)frame;
 }
@@ -368,31 +424,42 @@ static const struct zwlr_screencopy_frame_v1_listener screencopy_frame_listener
 
 // --- backend event handlers ---
 
-static void do_capture(ctx_t * ctx) {
+static bool do_capture(ctx_t * ctx, const mirror_capture_params_t * params) {
     screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
 
+    // target may have been switched to a toplevel in stream mode
+    if (params->target == NULL) {
+        wlm_log_error("mirror-screencopy::do_capture(): toplevel capture not supported\n");
+        wlm_mirror_backend_fail(ctx);
+        return false;
+    }
+
     if (backend->state == STATE_READY || backend->state == STATE_CANCELED) {
         // clear frame state for next frame
         backend->frame_flags = 0;
-        backend->state = STATE_WAIT_BUFFER;
+        wlm_util_damage_clear(&backend->frame_damage);
+        backend->shm_offer.offered = false;
+        backend->dmabuf_offer.offered = false;
+        set_state(ctx, backend, STATE_WAIT_BUFFER);
 
         // create screencopy_frame
-        if (ctx->opt.has_region) {
+        if (params->has_region) {
             backend->screencopy_frame = zwlr_screencopy_manager_v1_capture_output_region(
-                ctx->wl.screencopy_manager, ctx->opt.show_cursor, ctx->mirror.current_target->output,
-                ctx->mirror.current_target->x + ctx->mirror.current_region.x,
-                ctx->mirror.current_target->y + ctx->mirror.current_region.y,
-                ctx->mirror.current_region.width,
-                ctx->mirror.current_region.height
+                ctx->wl.screencopy_manager, params->show_cursor, params->target->output,
+                params->target->x + params->region.x,
+                params->target->y + params->region.y,
+                params->region.width,
+                params->region.height
             );
         } else {
             backend->screencopy_frame = zwlr_screencopy_manager_v1_capture_output(
-                ctx->wl.screencopy_manager, ctx->opt.show_cursor, ctx->mirror.current_target->output
+                ctx->wl.screencopy_manager, params->show_cursor, params->target->output
             );
         }
         if (backend->screencopy_frame == NULL) {
             wlm_log_error("do_capture: failed to create wlr_screencopy_frame\n");
             wlm_mirror_backend_fail(ctx);
+            return false;
         }
 
         // add screencopy_frame event listener
@@ -402,6 +469,113 @@ static void do_capture(ctx_t * ctx) {
         // - for ready event
         // - for failed event
         zwlr_screencopy_frame_v1_add_listener(backend->screencopy_frame, &screencopy_frame_listener, (void *)ctx);
+        return true;
+    }
+
+    return false;
+}
+
+static bool do_cancel(ctx_t * ctx) {
+    screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
+
+    if (backend->state == STATE_READY || backend->state == STATE_CANCELED) {
+        return false;
+    }
+
+    // buffer events are sent right away, copy_with_damage waits for damage
+    bool stuck = backend->state == STATE_WAIT_BUFFER || backend->state == STATE_WAIT_BUFFER_DONE;
+
+    wlm_log_debug(ctx, "mirror-screencopy::do_cancel(): abandoning capture\n");
+
+    frame_abandon(ctx, backend);
+    return stuck;
+}
+
+static void do_upload(ctx_t * ctx) {
+    screencopy_mirror_backend_t * backend = (screencopy_mirror_backend_t *)ctx->mirror.backend;
+
+    // find newest finished frame
+    screencopy_buffer_t * buffer = NULL;
+    for (size_t i = 0; i < SCREENCOPY_BUFFER_COUNT; i++) {
+        if (backend->buffers[i].state == BUFFER_READY) {
+            buffer = &backend->buffers[i];
+            break;
+        }
+    }
+
+    if (buffer == NULL) {
+        return;
+    }
+
+    // keep presenting the last frame instead of a stale one
+    // - its damage stays in upload_damage for the next frame
+    if (!wlm_mirror_frame_accept(ctx, buffer->timestamp_ns)) {
+        buffer->state = BUFFER_FREE;
+        return;
+    }
+
+    if (backend->buffer_type == BUFFER_TYPE_DMABUF) {
+        // import dmabuf into texture
+        if (!wlm_egl_dmabuf_to_texture(ctx, &buffer->dmabuf)) {
+            wlm_log_error("mirror-screencopy::do_upload(): failed to import dmabuf, falling back to shm buffers\n");
+            backend->dmabuf_failed = true;
+            buffer->state = BUFFER_FREE;
+            return;
+        }
+
+        // texture no longer holds shm contents
+        backend->texture_valid = false;
+        wlm_util_damage_clear(&backend->upload_damage);
+
+        ctx->egl.texture_region_aware = true;
+        ctx->egl.texture_initialized = true;
+
+        // previously imported buffer can be reused for capturing
+        // - the texture keeps referencing this buffer until the next import
+        for (size_t i = 0; i < SCREENCOPY_BUFFER_COUNT; i++) {
+            if (backend->buffers[i].state == BUFFER_IMPORTED) {
+                backend->buffers[i].state = BUFFER_FREE;
+            }
+        }
+        buffer->state = BUFFER_IMPORTED;
+    } else {
+        // store frame data into texture
+        // - complete upload if texture does not hold a previous frame
+        // - otherwise only upload damaged rectangles
+        const region_t * rects = backend->texture_valid ? backend->upload_damage.rects : NULL;
+        size_t rect_count = backend->texture_valid ? backend->upload_damage.count : 0;
+        if (!wlm_egl_shm_to_texture(ctx,
+            (uint8_t *)backend->shm_addr + buffer->shm_offset,
+            backend->frame_width, backend->frame_height,
+            backend->frame_stride, backend->frame_format,
+            rects, rect_count
+        )) {
+            wlm_log_error("mirror-screencopy::do_upload(): failed to upload shm buffer\n");
+            wlm_mirror_backend_fail(ctx);
+            return;
+        }
+        backend->texture_valid = true;
+        wlm_util_damage_clear(&backend->upload_damage);
+
+        ctx->egl.texture_region_aware = true;
+        ctx->egl.texture_initialized = true;
+
+        // buffer can be reused for capturing
+        buffer->state = BUFFER_FREE;
+    }
+
+    // set buffer flags
+    bool invert_y = buffer->frame_flags & ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT;
+    if (ctx->mirror.invert_y != invert_y) {
+        ctx->mirror.invert_y = invert_y;
+        wlm_egl_update_uniforms(ctx);
+    }
+
+    // set texture size and aspect ratio only if changed
+    if (backend->frame_width != ctx->egl.width || backend->frame_height != ctx->egl.height) {
+        ctx->egl.width = backend->frame_width;
+        ctx->egl.height = backend->frame_height;
+        wlm_egl_resize_viewport(ctx);
     }
 }
 
@@ -411,7 +585,8 @@ static void do_cleanup(ctx_t * ctx) {
     wlm_log_debug(ctx, "mirror-screencopy::do_cleanup(): destroying mirror-screencopy objects\n");
 
     if (backend->screencopy_frame != NULL) zwlr_screencopy_frame_v1_destroy(backend->screencopy_frame);
-    if (backend->shm_buffer != NULL) wl_buffer_destroy(backend->shm_buffer);
+    wlm_trace_state(ctx, state_names[backend->state], NULL);
+    destroy_buffers(backend);
     if (backend->shm_pool != NULL) wl_shm_pool_destroy(backend->shm_pool);
     if (backend->shm_addr != NULL) munmap(backend->shm_addr, backend->shm_size);
     if (backend->shm_fd != -1) close(backend->shm_fd);
@@ -430,6 +605,9 @@ void wlm_mirror_screencopy_init(ctx_t * ctx) {
     } else if (ctx->wl.screencopy_manager == NULL) {
         wlm_log_error("mirror-screencopy::init(): missing wlr_screencopy protocol\n");
         return;
+    } else if (ctx->mirror.current_toplevel != NULL) {
+        wlm_log_error("mirror-screencopy::init(): toplevel capture not supported\n");
+        return;
     }
 
     // allocate backend context structure
@@ -440,15 +618,34 @@ void wlm_mirror_screencopy_init(ctx_t * ctx) {
     }
 
     // initialize context structure
+    backend->header.name = "screencopy";
     backend->header.do_capture = do_capture;
+    backend->header.do_upload = do_upload;
     backend->header.do_cleanup = do_cleanup;
+    backend->header.do_cancel = do_cancel;
     backend->header.fail_count = 0;
+    backend->header.cancel_count = 0;
+    backend->header.capture_in_flight = false;
+    backend->header.waiting_for_damage = false;
+    // buffer states are shared with uploads, capture events stay on the main queue
+    backend->header.capture_thread = false;
 
     backend->shm_fd = -1;
     backend->shm_size = 0;
     backend->shm_addr = NULL;
     backend->shm_pool = NULL;
-    backend->shm_buffer = NULL;
+    backend->buffer_type = BUFFER_TYPE_SHM;
+    backend->copy_with_damage = true;
+    destroy_buffers(backend);
+    backend->capture_buffer = 0;
+
+    backend->shm_offer.offered = false;
+    backend->dmabuf_offer.offered = false;
+    backend->dmabuf_failed = false;
+
+    wlm_util_damage_clear(&backend->frame_damage);
+    wlm_util_damage_clear(&backend->upload_damage);
+    backend->texture_valid = false;
 
     backend->screencopy_frame = NULL;
 
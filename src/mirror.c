@@ -6,11 +6,370 @@
 #include <wlm/context.h>
 #include <EGL/eglext.h>
 #include <wlm/mirror-backends.h>
+#include <wlm/util.h>
 #include <wlm/proto/linux-dmabuf-unstable-v1.h>
 
+// --- capture scheduling ---
+
+static void arm_capture_timer(ctx_t * ctx, uint64_t deadline_ns) {
+    if (ctx->mirror.capture_timer.armed) return;
+
+    wlm_event_timer_arm(ctx, &ctx->mirror.capture_timer, deadline_ns);
+}
+
+static void arm_capture_watchdog(ctx_t * ctx, uint64_t now_ns) {
+    if (ctx->opt.capture_timeout_ms == 0) return;
+
+    // deadline counts from the first request of the capture in flight
+    if (ctx->mirror.capture_watchdog.armed) return;
+
+    wlm_event_timer_arm(ctx, &ctx->mirror.capture_watchdog, now_ns + (uint64_t)ctx->opt.capture_timeout_ms * 1000000);
+}
+
+static void reset_capture_watchdog(ctx_t * ctx) {
+    wlm_event_timer_disarm(ctx, &ctx->mirror.capture_watchdog);
+    ctx->mirror.consecutive_stalls = 0;
+}
+
+// start captures slightly early to absorb jitter in the capture duration
+#define JIT_CAPTURE_MARGIN_NS 1000000
+// start captures right away if the deadline is this close
+#define JIT_CAPTURE_TOLERANCE_NS 500000
+// ignore capture durations of captures that were canceled and retried
+#define JIT_CAPTURE_MAX_DURATION_NS 50000000
+
+static bool jit_capture_active(ctx_t * ctx) {
+    // present times must be comparable with our own timestamps
+    return ctx->opt.jit_capture && ctx->mirror.refresh_ns > 0 && ctx->wl.presentation_clock == CLOCK_MONOTONIC;
+}
+
+static uint64_t predict_vblank(ctx_t * ctx, uint64_t after_ns) {
+    // extrapolate first present time after the given time from the last present
+    uint64_t last = ctx->mirror.last_present_ns;
+    uint64_t refresh = ctx->mirror.refresh_ns;
+    if (after_ns < last) return last;
+
+    return last + ((after_ns - last) / refresh + 1) * refresh;
+}
+
+static void request_capture(ctx_t * ctx) {
+    if (ctx->mirror.backend == NULL) return;
+    if (ctx->opt.freeze) return;
+
+    // only capture on every nth frame callback
+    // - with a divider of 1, captures are also pipelined from frame_ready
+    if (ctx->opt.capture_divider > 1 && ctx->mirror.frames_since_capture < ctx->opt.capture_divider) {
+        return;
+    }
+
+    // delay capture until the frame interval has passed
+    // - the last texture keeps being presented in the meantime
+    uint64_t now = wlm_event_now_ns();
+    uint64_t deadline = 0;
+    if (ctx->opt.max_fps > 0) {
+        deadline = ctx->mirror.next_capture_ns;
+    }
+
+    // delay capture so it finishes just before the next vblank
+    // - skip vblanks that are too close to be reached in time
+    if (jit_capture_active(ctx)) {
+        uint64_t lead = ctx->mirror.capture_duration_ns + JIT_CAPTURE_MARGIN_NS;
+        uint64_t vblank = predict_vblank(ctx, now + lead - JIT_CAPTURE_TOLERANCE_NS);
+        if (vblank - lead > deadline) deadline = vblank - lead;
+    }
+
+    if (now + JIT_CAPTURE_TOLERANCE_NS < deadline) {
+        arm_capture_timer(ctx, deadline);
+        return;
+    }
+
+    // request new screen capture from backend
+    // - the capture thread starts the capture itself if it is running
+    // - the interval only restarts once a capture was actually issued,
+    //   requests while one is in flight must not push the next capture back
+    mirror_capture_params_t params;
+    wlm_mirror_capture_params(ctx, &params);
+    if (wlm_capture_running(ctx)) {
+        if (atomic_load(&ctx->mirror.backend->capture_in_flight)) return;
+        wlm_capture_request(ctx, &params);
+    } else {
+        wlm_perf_begin(ctx, PERF_STAGE_BACKEND);
+        bool started = ctx->mirror.backend->do_capture(ctx, &params);
+        wlm_perf_end(ctx, PERF_STAGE_BACKEND);
+        if (!started) return;
+    }
+
+    if (ctx->mirror.capture_start_ns == 0) {
+        ctx->mirror.capture_start_ns = now;
+    }
+    arm_capture_watchdog(ctx, now);
+    ctx->mirror.frames_since_capture = 0;
+    if (ctx->opt.max_fps > 0) {
+        ctx->mirror.next_capture_ns = now + 1000000000 / ctx->opt.max_fps;
+    }
+}
+
+static void on_capture_timer(ctx_t * ctx) {
+    request_capture(ctx);
+}
+
+// --- capture watchdog ---
+
+static void on_capture_watchdog(ctx_t * ctx) {
+    if (ctx->mirror.backend == NULL) return;
+
+    // nothing changed on screen, the capture completes with the next damage
+    // - canceling would only force a full upload of an unchanged frame
+    // - the watchdog is armed again by the next capture request
+    if (atomic_load(&ctx->mirror.backend->waiting_for_damage)) {
+        wlm_log_debug(ctx, "mirror::on_capture_watchdog(): capture waiting for damage\n");
+        return;
+    }
+
+    ctx->mirror.capture_timeouts++;
+
+    // backend state belongs to the capture thread while it is running
+    bool restart_thread = wlm_capture_running(ctx);
+    wlm_capture_stop(ctx);
+    if (ctx->wl.closing) return;
+
+    bool stuck = ctx->mirror.backend->do_cancel(ctx);
+    if (stuck) {
+        ctx->mirror.capture_stalls++;
+        ctx->mirror.consecutive_stalls++;
+        wlm_log_warn("mirror::on_capture_watchdog(): capture not answered after %u ms (%lu stalls, %lu timeouts)\n",
+            ctx->opt.capture_timeout_ms,
+            (unsigned long)ctx->mirror.capture_stalls, (unsigned long)ctx->mirror.capture_timeouts
+        );
+    } else {
+        wlm_log_debug(ctx, "mirror::on_capture_watchdog(): capture not finished after %u ms, retrying\n",
+            ctx->opt.capture_timeout_ms
+        );
+    }
+
+    // compositor keeps ignoring this backend, try the next one
+    // - a fixed backend keeps retrying instead of exiting
+    if (ctx->mirror.consecutive_stalls >= MIRROR_BACKEND_FATAL_STALLCOUNT && ctx->opt.backend == BACKEND_AUTO) {
+        wlm_mirror_backend_fail(ctx);
+    } else if (restart_thread) {
+        wlm_capture_start(ctx);
+    }
+
+    // duration of the abandoned capture is meaningless for scheduling
+    ctx->mirror.capture_start_ns = 0;
+    request_capture(ctx);
+}
+
+// --- presentation_feedback event handlers ---
+
+static void on_presentation_sync_output(
+    void * data, struct wp_presentation_feedback * feedback,
+    struct wl_output * output
+) {
+    (void)data;
+    (void)feedback;
+    (void)output;
+}
+
+static void on_presentation_presented(
+    void * data, struct wp_presentation_feedback * feedback,
+    uint32_t tv_sec_hi, uint32_t tv_sec_lo, uint32_t tv_nsec,
+    uint32_t refresh, uint32_t seq_hi, uint32_t seq_lo, uint32_t flags
+) {
+    ctx_t * ctx = (ctx_t *)data;
+
+    uint64_t present_ns = (((uint64_t)tv_sec_hi << 32) | tv_sec_lo) * 1000000000 + tv_nsec;
+    uint64_t present_seq = ((uint64_t)seq_hi << 32) | seq_lo;
+
+    // estimate refresh interval from the vblank counter if the compositor does not know it
+    uint64_t refresh_ns = refresh;
+    uint64_t last_present_ns = ctx->mirror.last_present_ns;
+    uint64_t last_present_seq = ctx->mirror.last_present_seq;
+    if (refresh_ns == 0 && last_present_ns != 0 && present_ns > last_present_ns && present_seq > last_present_seq) {
+        refresh_ns = (present_ns - last_present_ns) / (present_seq - last_present_seq);
+    }
+
+    if (refresh_ns != 0 && refresh_ns != ctx->mirror.refresh_ns) {
+        wlm_log_debug(ctx, "mirror::on_presentation_presented(): refresh interval is %lu ns\n", (unsigned long)refresh_ns);
+        ctx->mirror.refresh_ns = refresh_ns;
+    }
+    ctx->mirror.last_present_ns = present_ns;
+    ctx->mirror.last_present_seq = present_seq;
+
+    wp_presentation_feedback_destroy(ctx->mirror.presentation_feedback);
+    ctx->mirror.presentation_feedback = NULL;
+
+    (void)feedback;
+    (void)flags;
+}
+
+static void on_presentation_discarded(
+    void * data, struct wp_presentation_feedback * feedback
+) {
+    ctx_t * ctx = (ctx_t *)data;
+
+    wp_presentation_feedback_destroy(ctx->mirror.presentation_feedback);
+    ctx->mirror.presentation_feedback = NULL;
+
+    (void)feedback;
+}
+
+static const struct wp_presentation_feedback_listener presentation_feedback_listener = {
+    .sync_output = on_presentation_sync_output,
+    .presented = on_presentation_presented,
+    .discarded = on_presentation_discarded
+};
+
+// --- present synchronization ---
+
+// report present cost once per interval
+#define MEASURE_INTERVAL_NS 1000000000
+
+static void measure_present(ctx_t * ctx, uint64_t wait_ns) {
+    uint64_t now = wlm_event_now_ns();
+    if (ctx->mirror.measure_start_ns == 0) ctx->mirror.measure_start_ns = now;
+
+    ctx->mirror.measure_frames++;
+    ctx->mirror.measure_wait_ns += wait_ns;
+    if (wait_ns > ctx->mirror.measure_max_wait_ns) ctx->mirror.measure_max_wait_ns = wait_ns;
+    if (now - ctx->mirror.measure_start_ns < MEASURE_INTERVAL_NS) return;
+
+    wlm_log_info("mirror::measure_present(): %u frames, %u deferred, cpu time in draw and swap avg %.3f ms, max %.3f ms (gpu fences %s)\n",
+        ctx->mirror.measure_frames, ctx->mirror.measure_deferred,
+        ctx->mirror.measure_wait_ns / 1e6 / ctx->mirror.measure_frames,
+        ctx->mirror.measure_max_wait_ns / 1e6,
+        ctx->opt.gpu_fences && ctx->egl.fence_sync ? "on" : "off"
+    );
+
+    ctx->mirror.measure_start_ns = now;
+    ctx->mirror.measure_wait_ns = 0;
+    ctx->mirror.measure_max_wait_ns = 0;
+    ctx->mirror.measure_frames = 0;
+    ctx->mirror.measure_deferred = 0;
+}
+
+static void defer_present(ctx_t * ctx) {
+    // commit anyway so the new frame callback is not lost
+    ctx->mirror.present_skipped = true;
+    ctx->mirror.measure_deferred++;
+    wl_surface_commit(ctx->wl.surface);
+
+    // present as soon as the GPU is done if the fence can be polled
+    // - otherwise the next frame callback or finished capture presents
+    if (ctx->mirror.draw_fence_handler.fd == -1) {
+        int fd = wlm_egl_draw_fence_fd(ctx);
+        if (fd != -1) {
+            ctx->mirror.draw_fence_handler.fd = fd;
+            wlm_event_add_fd(ctx, &ctx->mirror.draw_fence_handler);
+        }
+    }
+}
+
 // --- frame_callback event handlers ---
 
 static const struct wl_callback_listener frame_callback_listener;
+static void benchmark_count_frame(ctx_t * ctx, uint64_t now_ns, uint64_t timestamp_ns);
+
+static void present_frame(ctx_t * ctx) {
+    // upload newest finished frame if the backend defers uploads
+    if (ctx->mirror.backend != NULL && ctx->mirror.backend->do_upload != NULL) {
+        uint64_t uploaded_frames = ctx->stats.uploaded_frames;
+        uint64_t upload_start_ns = wlm_event_now_ns();
+        wlm_trace_begin(ctx, "upload");
+        wlm_perf_begin(ctx, PERF_STAGE_UPLOAD);
+        ctx->mirror.backend->do_upload(ctx);
+        wlm_perf_end(ctx, PERF_STAGE_UPLOAD);
+        wlm_trace_end(ctx, "upload");
+        if (ctx->stats.uploaded_frames != uploaded_frames) {
+            wlm_stats_record(ctx, STATS_STAGE_UPLOAD, wlm_event_now_ns() - upload_start_ns);
+        }
+    }
+
+    // skip drawing and swapping if nothing changed since the last swap
+    // - commit anyway so the new frame callback is not lost
+    if (ctx->opt.present_on_change && !ctx->egl.dirty) {
+        ctx->mirror.present_skipped = true;
+        wl_surface_commit(ctx->wl.surface);
+        return;
+    }
+
+    // defer drawing while the GPU is still busy with the previous frame
+    // - drawing and swapping now would block the CPU in the driver
+    // - captures keep being issued in the meantime
+    if (ctx->opt.gpu_fences && !ctx->opt.freeze && wlm_egl_draw_pending(ctx)) {
+        defer_present(ctx);
+        return;
+    }
+
+    // request present time of the next commit for capture scheduling
+    // - one feedback at a time is enough to follow the vblank phase
+    if (ctx->opt.jit_capture && ctx->wl.presentation != NULL && ctx->mirror.presentation_feedback == NULL) {
+        ctx->mirror.presentation_feedback = wp_presentation_feedback(ctx->wl.presentation, ctx->wl.surface);
+
+        // add presentation_feedback event listener
+        // - for sync_output event
+        // - for presented event
+        // - for discarded event
+        wp_presentation_feedback_add_listener(ctx->mirror.presentation_feedback, &presentation_feedback_listener, (void *)ctx);
+    }
+
+    // state the intended present time of this frame
+    // - half a refresh early so a drifting prediction never delays the frame
+    if (jit_capture_active(ctx) && ctx->mirror.commit_timer != NULL) {
+        uint64_t target_ns = predict_vblank(ctx, wlm_event_now_ns()) - ctx->mirror.refresh_ns / 2;
+        uint64_t target_sec = target_ns / 1000000000;
+        wp_commit_timer_v1_set_timestamp(ctx->mirror.commit_timer,
+            (uint32_t)(target_sec >> 32), (uint32_t)target_sec, (uint32_t)(target_ns % 1000000000)
+        );
+    }
+
+    // render newest frame, set swap interval to 0 to ensure nonblocking buffer swap
+    // - don't wait for captures still in flight, they will be drawn on a later frame
+    uint64_t draw_start_ns = wlm_event_now_ns();
+    wlm_trace_begin(ctx, "draw");
+    wlm_perf_begin(ctx, PERF_STAGE_DRAW);
+    wlm_egl_draw_texture(ctx);
+    wlm_perf_end(ctx, PERF_STAGE_DRAW);
+    wlm_trace_end(ctx, "draw");
+    uint64_t swap_start_ns = wlm_event_now_ns();
+    wlm_trace_begin(ctx, "swap");
+    wlm_perf_begin(ctx, PERF_STAGE_SWAP);
+    eglSwapInterval(ctx->egl.display, 0);
+    if (eglSwapBuffers(ctx->egl.display, ctx->egl.surface) != EGL_TRUE) {
+        wlm_log_error("mirror::present_frame(): failed to swap buffers\n");
+        wlm_exit_fail(ctx);
+    }
+    wlm_perf_end(ctx, PERF_STAGE_SWAP);
+    wlm_trace_end(ctx, "swap");
+    uint64_t swap_end_ns = wlm_event_now_ns();
+    wlm_stats_frame_drawn(ctx, draw_start_ns, swap_start_ns, swap_end_ns);
+
+    // only frames that made it to the screen count for the backend benchmark
+    if (ctx->mirror.benchmark_frame_pending) {
+        benchmark_count_frame(ctx, swap_end_ns, ctx->mirror.frame_timestamp_ns);
+        ctx->mirror.benchmark_frame_pending = false;
+    }
+
+    // fence this frame so the next present can check if the GPU caught up
+    // - imported textures are only reused once their last draw finished
+    if (ctx->opt.gpu_fences) wlm_egl_fence_draw(ctx);
+    wlm_import_fence_draw(ctx);
+    if (ctx->opt.measure_sync) measure_present(ctx, swap_end_ns - draw_start_ns);
+
+    ctx->mirror.present_skipped = false;
+    ctx->egl.dirty = false;
+}
+
+static void on_draw_fence(ctx_t * ctx) {
+    wlm_event_remove_fd(ctx, &ctx->mirror.draw_fence_handler);
+    close(ctx->mirror.draw_fence_handler.fd);
+    ctx->mirror.draw_fence_handler.fd = -1;
+
+    // present frame deferred while the GPU was busy
+    if (ctx->mirror.present_skipped && !ctx->wl.closing) {
+        present_frame(ctx);
+    }
+}
 
 static void on_frame(
     void * data, struct wl_callback * frame_callback, uint32_t msec
@@ -26,6 +385,8 @@ static void on_frame(
         return;
     }
 
+    wlm_trace_begin(ctx, "on_frame");
+
     // add new frame callback listener
     // the wayland spec says you cannot reuse the old frame callback
     ctx->mirror.frame_callback = wl_surface_frame(ctx->wl.surface);
@@ -37,23 +398,14 @@ static void on_frame(
             wlm_mirror_backend_fail(ctx);
         }
 
-        if (!ctx->opt.freeze) {
-            // request new screen capture from backend
-            ctx->mirror.backend->do_capture(ctx);
-        }
+        // request new screen capture if allowed by the capture rate limits
+        // - captures are otherwise pipelined from wlm_mirror_frame_ready
+        ctx->mirror.frames_since_capture++;
+        request_capture(ctx);
     }
 
-    // wait for events
-    // - screencapture events from backend
-    wl_display_roundtrip(ctx->wl.display);
-
-    // render frame, set swap interval to 0 to ensure nonblocking buffer swap
-    wlm_egl_draw_texture(ctx);
-    eglSwapInterval(ctx->egl.display, 0);
-    if (eglSwapBuffers(ctx->egl.display, ctx->egl.surface) != EGL_TRUE) {
-        wlm_log_error("mirror::on_frame(): failed to swap buffers\n");
-        wlm_exit_fail(ctx);
-    }
+    present_frame(ctx);
+    wlm_trace_end(ctx, "on_frame");
 
     (void)frame_callback;
     (void)msec;
@@ -65,20 +417,71 @@ static const struct wl_callback_listener frame_callback_listener = {
 
 // --- init_mirror ---
 
+static void on_benchmark_timer(ctx_t * ctx);
+
 void wlm_mirror_init(ctx_t * ctx) {
     // initialize context structure
     ctx->mirror.current_target = NULL;
+    ctx->mirror.current_toplevel = NULL;
     ctx->mirror.frame_callback = NULL;
     ctx->mirror.current_region = (region_t){ .x = 0, .y = 0, .width = 0, .height = 0 };
     ctx->mirror.invert_y = false;
+    ctx->mirror.present_skipped = false;
+
+    wlm_event_timer_init(&ctx->mirror.capture_timer, EVENT_PRIORITY_WAYLAND, on_capture_timer);
+    ctx->mirror.next_capture_ns = 0;
+    ctx->mirror.frames_since_capture = 0;
+
+    ctx->mirror.presentation_feedback = NULL;
+    ctx->mirror.commit_timer = NULL;
+    ctx->mirror.last_present_ns = 0;
+    ctx->mirror.last_present_seq = 0;
+    ctx->mirror.refresh_ns = 0;
+    ctx->mirror.capture_start_ns = 0;
+    ctx->mirror.capture_duration_ns = 0;
+
+    wlm_event_timer_init(&ctx->mirror.capture_watchdog, EVENT_PRIORITY_WAYLAND, on_capture_watchdog);
+    ctx->mirror.capture_timeouts = 0;
+    ctx->mirror.capture_stalls = 0;
+    ctx->mirror.consecutive_stalls = 0;
+
+    ctx->mirror.frame_timestamp_ns = 0;
+    ctx->mirror.stale_frames = 0;
+
+    wlm_event_timer_init(&ctx->mirror.benchmark_timer, EVENT_PRIORITY_WAYLAND, on_benchmark_timer);
+    for (size_t i = 0; i < MIRROR_AUTO_BACKEND_COUNT; i++) {
+        ctx->mirror.benchmark[i] = (mirror_benchmark_t){ 0 };
+    }
+    ctx->mirror.benchmark_current = NULL;
+    ctx->mirror.benchmark_measuring = false;
+    ctx->mirror.benchmark_frame_pending = false;
+    ctx->mirror.benchmarking = false;
+
+    ctx->mirror.draw_fence_handler.next = NULL;
+    ctx->mirror.draw_fence_handler.fd = -1;
+    ctx->mirror.draw_fence_handler.events = EPOLLIN;
+    ctx->mirror.draw_fence_handler.priority = EVENT_PRIORITY_RENDER;
+    ctx->mirror.draw_fence_handler.on_event = on_draw_fence;
+    ctx->mirror.draw_fence_handler.on_each = NULL;
+
+    ctx->mirror.measure_start_ns = 0;
+    ctx->mirror.measure_wait_ns = 0;
+    ctx->mirror.measure_max_wait_ns = 0;
+    ctx->mirror.measure_frames = 0;
+    ctx->mirror.measure_deferred = 0;
 
     ctx->mirror.backend = NULL;
     ctx->mirror.auto_backend_index = 0;
 
     ctx->mirror.initialized = true;
 
-    // finding target output
-    if (!wlm_opt_find_output(ctx, &ctx->mirror.current_target, &ctx->mirror.current_region)) {
+    // finding target toplevel or output
+    if (ctx->opt.toplevel != NULL) {
+        if (!wlm_opt_find_toplevel(ctx, &ctx->mirror.current_toplevel)) {
+            wlm_log_error("mirror::init(): failed to find toplevel\n");
+            wlm_exit_fail(ctx);
+        }
+    } else if (!wlm_opt_find_output(ctx, &ctx->mirror.current_target, &ctx->mirror.current_region)) {
         wlm_log_error("mirror::init(): failed to find output\n");
         wlm_exit_fail(ctx);
     }
@@ -86,6 +489,11 @@ void wlm_mirror_init(ctx_t * ctx) {
     // update window title
     wlm_mirror_update_title(ctx);
 
+    // create commit timer for --jit-capture if supported
+    if (ctx->wl.commit_timing_manager != NULL) {
+        ctx->mirror.commit_timer = wp_commit_timing_manager_v1_get_timer(ctx->wl.commit_timing_manager, ctx->wl.surface);
+    }
+
     // add frame callback listener
     ctx->mirror.frame_callback = wl_surface_frame(ctx->wl.surface);
     wl_callback_add_listener(ctx->mirror.frame_callback, &frame_callback_listener, (void *)ctx);
@@ -100,28 +508,51 @@ typedef struct {
 
 static fallback_backend_t auto_fallback_backends[] = {
     { "dmabuf", wlm_mirror_dmabuf_init },
+    { "extcopy", wlm_mirror_extcopy_init },
     { "screencopy", wlm_mirror_screencopy_init },
     { NULL, NULL }
 };
 
-static void auto_backend_fallback(ctx_t * ctx) {
+// screencopy captures only the region into GPU buffers
+// - the other backends export the full output and crop in the shader
+static fallback_backend_t auto_region_fallback_backends[] = {
+    { "screencopy", wlm_mirror_screencopy_init },
+    { "dmabuf", wlm_mirror_dmabuf_init },
+    { "extcopy", wlm_mirror_extcopy_init },
+    { NULL, NULL }
+};
+
+// benchmark results are indexed like the fallback lists, without the terminator
+_Static_assert(ARRAY_LENGTH(auto_fallback_backends) == MIRROR_AUTO_BACKEND_COUNT + 1, "auto_fallback_backends has incorrect length");
+_Static_assert(ARRAY_LENGTH(auto_region_fallback_backends) == MIRROR_AUTO_BACKEND_COUNT + 1, "auto_region_fallback_backends has incorrect length");
+
+static fallback_backend_t * auto_backends(ctx_t * ctx) {
+    if (ctx->opt.has_region && ctx->allocator.available) {
+        return auto_region_fallback_backends;
+    } else {
+        return auto_fallback_backends;
+    }
+}
+
+static bool auto_backend_load_next(ctx_t * ctx) {
     while (true) {
         // get next backend
         size_t index = ctx->mirror.auto_backend_index;
-        fallback_backend_t * next_backend = &auto_fallback_backends[index];
+        fallback_backend_t * next_backend = &auto_backends(ctx)[index];
         if (next_backend->name == NULL) {
-            wlm_log_error("mirror::auto_backend_fallback(): no working backend found, exiting\n");
-            wlm_exit_fail(ctx);
+            return false;
         }
 
-        if (index > 0) {
+        if (index > 0 && !ctx->mirror.benchmarking) {
             wlm_log_warn("mirror::auto_backend_fallback(): falling back to backend %s\n", next_backend->name);
         } else {
             wlm_log_debug(ctx, "mirror::auto_backend_fallback(): selecting backend %s\n", next_backend->name);
         }
 
         // uninitialize previous backend
+        wlm_capture_stop(ctx);
         if (ctx->mirror.backend != NULL) ctx->mirror.backend->do_cleanup(ctx);
+        reset_capture_watchdog(ctx);
 
         // initialize next backend
         next_backend->init(ctx);
@@ -130,7 +561,156 @@ static void auto_backend_fallback(ctx_t * ctx) {
         ctx->mirror.auto_backend_index++;
 
         // break if backend loading succeeded
-        if (ctx->mirror.backend != NULL) break;
+        if (ctx->mirror.backend != NULL) return true;
+    }
+}
+
+static void auto_backend_fallback(ctx_t * ctx) {
+    if (!auto_backend_load_next(ctx)) {
+        wlm_log_error("mirror::auto_backend_fallback(): no working backend found, exiting\n");
+        wlm_exit_fail(ctx);
+    }
+
+    wlm_capture_start(ctx);
+}
+
+// --- auto backend benchmark ---
+
+// ignore frames while buffers are allocated and caches are filled
+#define BENCHMARK_WARMUP_NS 250000000
+#define BENCHMARK_DURATION_NS 1000000000
+// backends within this fraction of the best frame rate are compared by latency
+#define BENCHMARK_FPS_TOLERANCE 0.05
+
+static double benchmark_fps(const mirror_benchmark_t * result) {
+    if (result->duration_ns == 0) return 0;
+    return result->frames * 1e9 / result->duration_ns;
+}
+
+static double benchmark_latency_ms(const mirror_benchmark_t * result) {
+    if (result->latency_samples == 0) return 0;
+    return result->latency_ns / 1e6 / result->latency_samples;
+}
+
+static bool benchmark_better(const mirror_benchmark_t * a, const mirror_benchmark_t * b) {
+    double fps_a = benchmark_fps(a);
+    double fps_b = benchmark_fps(b);
+    if (fps_a > fps_b * (1 + BENCHMARK_FPS_TOLERANCE)) return true;
+    if (fps_b > fps_a * (1 + BENCHMARK_FPS_TOLERANCE)) return false;
+
+    // similar frame rate, keep the earlier backend unless latency is known to be lower
+    if (a->latency_samples == 0 || b->latency_samples == 0) return false;
+    return benchmark_latency_ms(a) < benchmark_latency_ms(b);
+}
+
+static void benchmark_finish(ctx_t * ctx) {
+    ctx->mirror.benchmark_current = NULL;
+    wlm_event_timer_disarm(ctx, &ctx->mirror.benchmark_timer);
+
+    // report results and find the fastest backend
+    size_t best = MIRROR_AUTO_BACKEND_COUNT;
+    for (size_t i = 0; i < MIRROR_AUTO_BACKEND_COUNT; i++) {
+        mirror_benchmark_t * result = &ctx->mirror.benchmark[i];
+        if (result->name == NULL) continue;
+
+        if (result->failed || !result->measured) {
+            wlm_log_info("mirror::benchmark(): backend %-10s failed\n", result->name);
+            continue;
+        } else if (result->latency_samples == 0) {
+            wlm_log_info("mirror::benchmark(): backend %-10s %6.1f fps, latency unknown\n",
+                result->name, benchmark_fps(result)
+            );
+        } else {
+            wlm_log_info("mirror::benchmark(): backend %-10s %6.1f fps, latency avg %.2f ms\n",
+                result->name, benchmark_fps(result), benchmark_latency_ms(result)
+            );
+        }
+
+        if (result->frames == 0) continue;
+        if (best == MIRROR_AUTO_BACKEND_COUNT || benchmark_better(result, &ctx->mirror.benchmark[best])) {
+            best = i;
+        }
+    }
+
+    // continue with the fastest backend
+    // - later failures fall back to the backends after it
+    if (best == MIRROR_AUTO_BACKEND_COUNT) {
+        wlm_log_warn("mirror::benchmark(): no backend produced frames, using default backend order\n");
+        ctx->mirror.auto_backend_index = 0;
+    } else {
+        wlm_log_info("mirror::benchmark(): using backend %s\n", ctx->mirror.benchmark[best].name);
+        ctx->mirror.auto_backend_index = best;
+    }
+
+    if (!auto_backend_load_next(ctx)) {
+        wlm_log_error("mirror::benchmark(): no working backend found, exiting\n");
+        wlm_exit_fail(ctx);
+    }
+
+    ctx->mirror.benchmarking = false;
+    wlm_capture_start(ctx);
+}
+
+static void benchmark_next_backend(ctx_t * ctx) {
+    wlm_event_timer_disarm(ctx, &ctx->mirror.benchmark_timer);
+
+    if (!auto_backend_load_next(ctx)) {
+        benchmark_finish(ctx);
+        return;
+    }
+
+    size_t index = ctx->mirror.auto_backend_index - 1;
+    mirror_benchmark_t * result = &ctx->mirror.benchmark[index];
+    result->name = auto_backends(ctx)[index].name;
+    ctx->mirror.benchmark_current = result;
+    ctx->mirror.benchmark_measuring = false;
+
+    wlm_log_debug(ctx, "mirror::benchmark(): measuring backend %s\n", result->name);
+    wlm_event_timer_arm(ctx, &ctx->mirror.benchmark_timer, wlm_event_now_ns() + BENCHMARK_WARMUP_NS);
+    wlm_capture_start(ctx);
+}
+
+static void benchmark_start(ctx_t * ctx) {
+    for (size_t i = 0; i < MIRROR_AUTO_BACKEND_COUNT; i++) {
+        ctx->mirror.benchmark[i] = (mirror_benchmark_t){ 0 };
+    }
+
+    ctx->mirror.benchmarking = true;
+    ctx->mirror.auto_backend_index = 0;
+    benchmark_next_backend(ctx);
+}
+
+static void on_benchmark_timer(ctx_t * ctx) {
+    mirror_benchmark_t * result = ctx->mirror.benchmark_current;
+    if (result == NULL) return;
+
+    uint64_t now = wlm_event_now_ns();
+    if (!ctx->mirror.benchmark_measuring) {
+        // warmup done, start counting frames
+        result->start_ns = now;
+        result->frames = 0;
+        result->latency_ns = 0;
+        result->latency_samples = 0;
+        ctx->mirror.benchmark_measuring = true;
+        wlm_event_timer_arm(ctx, &ctx->mirror.benchmark_timer, now + BENCHMARK_DURATION_NS);
+        return;
+    }
+
+    result->duration_ns = now - result->start_ns;
+    result->measured = true;
+    benchmark_next_backend(ctx);
+}
+
+static void benchmark_count_frame(ctx_t * ctx, uint64_t now_ns, uint64_t timestamp_ns) {
+    mirror_benchmark_t * result = ctx->mirror.benchmark_current;
+    if (!ctx->mirror.benchmarking || !ctx->mirror.benchmark_measuring || result == NULL) return;
+
+    result->frames++;
+
+    // latency from the capture timestamp to the swap that presents the frame
+    if (timestamp_ns != 0 && ctx->wl.presentation_clock == CLOCK_MONOTONIC && timestamp_ns < now_ns) {
+        result->latency_ns += now_ns - timestamp_ns;
+        result->latency_samples++;
     }
 }
 
@@ -138,10 +718,25 @@ static void auto_backend_fallback(ctx_t * ctx) {
 // --- init_mirror_backend ---
 
 void wlm_mirror_backend_init(ctx_t * ctx) {
+    wlm_capture_stop(ctx);
     if (ctx->mirror.backend != NULL) ctx->mirror.backend->do_cleanup(ctx);
+    reset_capture_watchdog(ctx);
+
+    // import thread is only started by backends that use it
+    if (!ctx->opt.import_thread) wlm_import_stop(ctx);
+
+    // a running benchmark is restarted or abandoned
+    ctx->mirror.benchmarking = false;
+    ctx->mirror.benchmark_current = NULL;
+    wlm_event_timer_disarm(ctx, &ctx->mirror.benchmark_timer);
 
     switch (ctx->opt.backend) {
         case BACKEND_AUTO:
+            if (ctx->opt.benchmark_backends) {
+                benchmark_start(ctx);
+                return;
+            }
+
             auto_backend_fallback(ctx);
             break;
 
@@ -152,9 +747,15 @@ void wlm_mirror_backend_init(ctx_t * ctx) {
         case BACKEND_SCREENCOPY:
             wlm_mirror_screencopy_init(ctx);
             break;
+
+        case BACKEND_EXTCOPY:
+            wlm_mirror_extcopy_init(ctx);
+            break;
     }
 
     if (ctx->mirror.backend == NULL) wlm_exit_fail(ctx);
+
+    wlm_capture_start(ctx);
 }
 
 // --- output_removed ---
@@ -168,11 +769,29 @@ void wlm_mirror_output_removed(ctx_t * ctx, output_list_node_t * node) {
     wlm_exit_fail(ctx);
 }
 
+// --- toplevel_removed ---
+
+void wlm_mirror_toplevel_removed(ctx_t * ctx, toplevel_list_node_t * node) {
+    if (!ctx->mirror.initialized) return;
+    if (ctx->mirror.current_toplevel == NULL) return;
+    if (ctx->mirror.current_toplevel != node) return;
+
+    wlm_log_error("mirror::toplevel_removed(): toplevel closed, closing\n");
+    wlm_exit_fail(ctx);
+}
+
 // --- update_options_mirror ---
 
 void wlm_mirror_update_title(ctx_t * ctx) {
     char * title = NULL;
-    int status = asprintf(&title, "Wayland Output Mirror for %s", ctx->mirror.current_target->name);
+    int status;
+    if (ctx->mirror.current_toplevel != NULL) {
+        toplevel_list_node_t * toplevel = ctx->mirror.current_toplevel;
+        const char * name = toplevel->title != NULL ? toplevel->title : toplevel->app_id;
+        status = asprintf(&title, "Wayland Window Mirror for %s", name != NULL ? name : "toplevel");
+    } else {
+        status = asprintf(&title, "Wayland Output Mirror for %s", ctx->mirror.current_target->name);
+    }
     if (status == -1) {
         wlm_log_error("mirror::update_title(): failed to format window title\n");
         wlm_exit_fail(ctx);
@@ -182,10 +801,103 @@ void wlm_mirror_update_title(ctx_t * ctx) {
     free(title);
 }
 
+// --- frame_ready ---
+
+void wlm_mirror_frame_ready(ctx_t * ctx) {
+    if (ctx->mirror.backend == NULL) return;
+
+    // mirror state is only touched on the main thread
+    if (wlm_capture_on_thread(ctx)) {
+        wlm_capture_notify(ctx, CAPTURE_NOTIFY_FRAME_READY);
+        return;
+    }
+
+    uint64_t now = wlm_event_now_ns();
+    wlm_stats_capture_done(ctx, ctx->mirror.capture_start_ns, now);
+
+    // track capture duration for just-in-time capture scheduling
+    if (ctx->mirror.capture_start_ns != 0) {
+        int64_t duration = now - ctx->mirror.capture_start_ns;
+        if (duration > JIT_CAPTURE_MAX_DURATION_NS) duration = JIT_CAPTURE_MAX_DURATION_NS;
+
+        int64_t average = ctx->mirror.capture_duration_ns;
+        ctx->mirror.capture_duration_ns = average == 0 ? duration : average + (duration - average) / 8;
+        ctx->mirror.capture_start_ns = 0;
+    }
+
+    // capture finished in time, compositor is answering
+    reset_capture_watchdog(ctx);
+
+    // present right away if the last frame callback had nothing to present
+    // - an empty commit does not damage the surface, so the compositor may
+    //   not send another frame callback until something else changes
+    if (ctx->mirror.present_skipped && !ctx->wl.closing) {
+        present_frame(ctx);
+    }
+
+    // request next frame as soon as the previous frame is ready
+    // - the newest frame is drawn on the next frame callback
+    request_capture(ctx);
+}
+
+// --- capture_params ---
+
+void wlm_mirror_capture_params(ctx_t * ctx, mirror_capture_params_t * params) {
+    params->target = ctx->mirror.current_target;
+    params->toplevel = ctx->mirror.current_toplevel;
+    params->region = ctx->mirror.current_region;
+    params->has_region = ctx->opt.has_region;
+    params->show_cursor = ctx->opt.show_cursor;
+}
+
+// --- frame_timestamp ---
+
+uint64_t wlm_mirror_frame_timestamp(uint32_t sec_hi, uint32_t sec_lo, uint32_t nsec) {
+    uint64_t sec = ((uint64_t)sec_hi << 32) | sec_lo;
+    return sec * 1000000000 + nsec;
+}
+
+// --- frame_accept ---
+
+bool wlm_mirror_frame_accept(ctx_t * ctx, uint64_t timestamp_ns) {
+    // capture timestamps are in the presentation clock domain
+    // - without a timestamp or a comparable clock every frame is accepted
+    uint64_t now = wlm_event_now_ns();
+    if (
+        ctx->opt.max_frame_age_ms > 0 && timestamp_ns != 0 &&
+        ctx->wl.presentation_clock == CLOCK_MONOTONIC && timestamp_ns < now
+    ) {
+        uint64_t age_ns = now - timestamp_ns;
+        if (age_ns > (uint64_t)ctx->opt.max_frame_age_ms * 1000000) {
+            wlm_log_debug(ctx, "mirror::frame_accept(): dropping frame captured %lu ms ago\n",
+                (unsigned long)(age_ns / 1000000)
+            );
+            ctx->mirror.stale_frames++;
+            wlm_stats_frame_dropped(ctx);
+            return false;
+        }
+    }
+
+    ctx->mirror.frame_timestamp_ns = timestamp_ns;
+    wlm_stats_frame_uploaded(ctx);
+    ctx->mirror.benchmark_frame_pending = ctx->mirror.benchmarking;
+    return true;
+}
+
 // --- backend_fail ---
 
 void wlm_mirror_backend_fail(ctx_t * ctx) {
-    if (ctx->opt.backend == BACKEND_AUTO) {
+    // backends are only switched on the main thread
+    if (wlm_capture_on_thread(ctx)) {
+        wlm_capture_notify(ctx, CAPTURE_NOTIFY_BACKEND_FAIL);
+        return;
+    }
+
+    if (ctx->mirror.benchmarking && ctx->mirror.benchmark_current != NULL) {
+        wlm_log_debug(ctx, "mirror::backend_fail(): backend failed during benchmark\n");
+        ctx->mirror.benchmark_current->failed = true;
+        benchmark_next_backend(ctx);
+    } else if (ctx->opt.backend == BACKEND_AUTO) {
         auto_backend_fallback(ctx);
     } else {
         wlm_exit_fail(ctx);
@@ -199,8 +911,18 @@ void wlm_mirror_cleanup(ctx_t * ctx) {
 
     wlm_log_debug(ctx, "mirror::cleanup(): destroying mirror objects\n");
 
+    wlm_capture_stop(ctx);
     if (ctx->mirror.backend != NULL) ctx->mirror.backend->do_cleanup(ctx);
     if (ctx->mirror.frame_callback != NULL) wl_callback_destroy(ctx->mirror.frame_callback);
+    if (ctx->mirror.presentation_feedback != NULL) wp_presentation_feedback_destroy(ctx->mirror.presentation_feedback);
+    if (ctx->mirror.commit_timer != NULL) wp_commit_timer_v1_destroy(ctx->mirror.commit_timer);
+    wlm_event_timer_disarm(ctx, &ctx->mirror.capture_timer);
+    wlm_event_timer_disarm(ctx, &ctx->mirror.capture_watchdog);
+    wlm_event_timer_disarm(ctx, &ctx->mirror.benchmark_timer);
+    if (ctx->mirror.draw_fence_handler.fd != -1) {
+        wlm_event_remove_fd(ctx, &ctx->mirror.draw_fence_handler);
+        close(ctx->mirror.draw_fence_handler.fd);
+    }
 
     ctx->mirror.initialized = false;
 }
@@ -12,18 +12,35 @@ void wlm_opt_init(ctx_t * ctx) {
     ctx->opt.freeze = false;
     ctx->opt.has_region = false;
     ctx->opt.fullscreen = false;
+    ctx->opt.present_on_change = false;
+    ctx->opt.jit_capture = false;
+    ctx->opt.capture_thread = false;
+    ctx->opt.import_thread = false;
+    ctx->opt.gpu_fences = false;
+    ctx->opt.measure_sync = false;
+    ctx->opt.benchmark_backends = false;
+    ctx->opt.hud = false;
+    ctx->opt.perf_counters = false;
+    ctx->opt.max_fps = 0;
+    ctx->opt.capture_divider = 1;
+    ctx->opt.capture_timeout_ms = 1000;
+    ctx->opt.max_frame_age_ms = 0;
     ctx->opt.scaling = SCALE_FIT;
     ctx->opt.scaling_filter = SCALE_FILTER_LINEAR;
     ctx->opt.backend = BACKEND_AUTO;
     ctx->opt.transform = (transform_t){ .rotation = ROT_NORMAL, .flip_x = false, .flip_y = false };
     ctx->opt.region = (region_t){ .x = 0, .y = 0, .width = 0, .height = 0 };
     ctx->opt.output = NULL;
+    ctx->opt.toplevel = NULL;
     ctx->opt.fullscreen_output = NULL;
+    ctx->opt.trace_file = NULL;
 }
 
 void wlm_cleanup_opt(ctx_t * ctx) {
     if (ctx->opt.output != NULL) free(ctx->opt.output);
+    if (ctx->opt.toplevel != NULL) free(ctx->opt.toplevel);
     if (ctx->opt.fullscreen_output != NULL) free(ctx ->opt.fullscreen_output);
+    if (ctx->opt.trace_file != NULL) free(ctx->opt.trace_file);
 }
 
 bool wlm_opt_parse_scaling(scale_t * scaling, scale_filter_t * scaling_filter, const char * scaling_arg) {
@@ -57,11 +74,27 @@ bool wlm_opt_parse_backend(backend_t * backend, const char * backend_arg) {
     } else if (strcmp(backend_arg, "screencopy") == 0) {
         *backend = BACKEND_SCREENCOPY;
         return true;
+    } else if (strcmp(backend_arg, "extcopy") == 0) {
+        *backend = BACKEND_EXTCOPY;
+        return true;
     } else {
         return false;
     }
 }
 
+bool wlm_opt_parse_uint(uint32_t * value, const char * value_arg, bool nonzero) {
+    char * end = NULL;
+    unsigned long local_value = strtoul(value_arg, &end, 10);
+    if (*value_arg == '\0' || *value_arg == '-' || *end != '\0' || local_value > UINT32_MAX) {
+        return false;
+    } else if (nonzero && local_value == 0) {
+        return false;
+    }
+
+    *value = local_value;
+    return true;
+}
+
 bool wlm_opt_parse_transform(transform_t * transform, const char * transform_arg) {
     transform_t local_transform = { .rotation = ROT_NORMAL, .flip_x = false, .flip_y = false };
 
@@ -336,6 +369,44 @@ bool wlm_opt_find_output(ctx_t * ctx, output_list_node_t ** output_handle, regio
     return true;
 }
 
+bool wlm_opt_find_toplevel(ctx_t * ctx, toplevel_list_node_t ** toplevel_handle) {
+    if (ctx->wl.toplevel_list == NULL) {
+        wlm_log_error("options::find_toplevel(): missing ext_foreign_toplevel_list protocol\n");
+        return false;
+    }
+
+    // prefer exact identifier matches, then app ids, then titles
+    wlm_log_debug(ctx, "options::find_toplevel(): searching for toplevel %s\n", ctx->opt.toplevel);
+    toplevel_list_node_t * local_toplevel_handle = NULL;
+    for (toplevel_list_node_t * cur = ctx->wl.toplevels; cur != NULL; cur = cur->next) {
+        if (cur->identifier != NULL && strcmp(cur->identifier, ctx->opt.toplevel) == 0) {
+            local_toplevel_handle = cur;
+            break;
+        }
+    }
+
+    for (toplevel_list_node_t * cur = ctx->wl.toplevels; local_toplevel_handle == NULL && cur != NULL; cur = cur->next) {
+        if (cur->app_id != NULL && strcmp(cur->app_id, ctx->opt.toplevel) == 0) {
+            local_toplevel_handle = cur;
+        }
+    }
+
+    for (toplevel_list_node_t * cur = ctx->wl.toplevels; local_toplevel_handle == NULL && cur != NULL; cur = cur->next) {
+        if (cur->title != NULL && strcmp(cur->title, ctx->opt.toplevel) == 0) {
+            local_toplevel_handle = cur;
+        }
+    }
+
+    if (local_toplevel_handle == NULL) {
+        wlm_log_error("options::find_toplevel(): toplevel %s not found\n", ctx->opt.toplevel);
+        return false;
+    }
+
+    wlm_log_debug(ctx, "options::find_toplevel(): found toplevel with identifier %s\n", local_toplevel_handle->identifier);
+    *toplevel_handle = local_toplevel_handle;
+    return true;
+}
+
 void wlm_opt_usage(ctx_t * ctx) {
     printf("usage: wl-mirror [options] <output>\n");
     printf("\n");
@@ -351,6 +422,9 @@ void wlm_opt_usage(ctx_t * ctx) {
     printf("  -f,   --freeze                freeze the current image on the screen\n");
     printf("        --unfreeze              resume the screen capture after a freeze\n");
     printf("        --toggle-freeze         toggle freeze state of screen capture\n");
+    printf("        --hud                   show capture and present rates, latency, and frame times\n");
+    printf("        --no-hud                hide the performance HUD (default)\n");
+    printf("        --toggle-hud            toggle the performance HUD\n");
     printf("  -F,   --fullscreen            open wl-mirror as fullscreen\n");
     printf("        --no-fullscreen         open wl-mirror as a window (default)\n");
     printf("        --fullscreen-output O   open wl-mirror as fullscreen on output O\n");
@@ -364,12 +438,40 @@ void wlm_opt_usage(ctx_t * ctx) {
     printf("  -t T, --transform T           apply custom transform T\n");
     printf("  -r R, --region R              capture custom region R\n");
     printf("        --no-region             capture the entire output (default)\n");
+    printf("        --toplevel T            capture toplevel window T instead of an output\n");
+    printf("        --present-on-change     only draw and present frames when the image changed\n");
+    printf("        --no-present-on-change  draw and present on every frame callback (default)\n");
+    printf("        --max-fps F             capture at most F frames per second\n");
+    printf("        --no-max-fps            don't limit the capture rate (default)\n");
+    printf("        --capture-divider N     only capture on every Nth frame callback (default 1)\n");
+    printf("        --capture-timeout MS    retry captures not finished after MS milliseconds (default 1000)\n");
+    printf("        --no-capture-timeout    wait for captures indefinitely\n");
+    printf("        --max-frame-age MS      drop captured frames older than MS milliseconds\n");
+    printf("        --no-max-frame-age      present captured frames regardless of their age (default)\n");
+    printf("        --jit-capture           time captures to finish just before the next vblank\n");
+    printf("        --no-jit-capture        capture as soon as the previous capture finished (default)\n");
+    printf("        --capture-thread        receive captured frames on a dedicated thread\n");
+    printf("        --no-capture-thread     receive captured frames on the main thread (default)\n");
+    printf("        --import-thread         import captured frames on a dedicated thread\n");
+    printf("        --no-import-thread      import captured frames on the main thread (default)\n");
+    printf("        --gpu-fences            skip drawing while the GPU is still busy with the last frame\n");
+    printf("        --no-gpu-fences         draw without checking if the GPU is busy (default)\n");
+    printf("        --measure-sync          periodically log the CPU time spent drawing and swapping\n");
+    printf("        --no-measure-sync       don't log draw and swap timings (default)\n");
+    printf("        --benchmark-backends    measure all auto backends at startup and use the fastest\n");
+    printf("        --no-benchmark-backends use the first working auto backend (default)\n");
+    printf("        --trace FILE            record a trace of the frame path, written to FILE on exit or SIGUSR2\n");
+    printf("        --no-trace              don't record a trace (default)\n");
+    printf("        --perf-counters         count cycles, instructions, cache misses, and context switches per stage\n");
+    printf("        --no-perf-counters      don't read hardware performance counters (default)\n");
     printf("  -S,   --stream                accept a stream of additional options on stdin\n");
+    printf("        --stats                 print frame timing stats as a JSON line on stdout (stream mode only)\n");
     printf("\n");
     printf("backends:\n");
     printf("  - auto        automatically try the backends in order and use the first that works (default)\n");
     printf("  - dmabuf      use the wlr-export-dmabuf-unstable-v1 protocol to capture outputs\n");
     printf("  - screencopy  use the wlr-screencopy-unstable-v1 protocol to capture outputs\n");
+    printf("  - extcopy     use the ext-image-copy-capture-v1 protocol to capture outputs\n");
     printf("\n");
     printf("transforms:\n");
     printf("  transforms are specified as a dash-separated list of flips followed by a rotation\n");
@@ -389,12 +491,18 @@ void wlm_opt_usage(ctx_t * ctx) {
     printf("  when the output moves, the captured region moves with it\n");
     printf("  when a region is specified, the <output> argument is optional\n");
     printf("\n");
+    printf("toplevels:\n");
+    printf("  toplevels are matched by their identifier, app id, or title, in that order\n");
+    printf("  capturing toplevels requires the extcopy backend\n");
+    printf("  when a toplevel is specified, the <output> argument must be omitted\n");
+    printf("\n");
     printf("stream mode:\n");
     printf("  in stream mode, wl-mirror interprets lines on stdin as additional command line options\n");
     printf("  - arguments can be quoted with single or double quotes, but every argument must be fully\n");
     printf("    quoted or fully unquoted\n");
     printf("  - unquoted arguments are split on whitespace\n");
     printf("  - no escape sequences are implemented\n");
+    printf("  - frame timing stats are also printed on SIGUSR1\n");
     wlm_cleanup(ctx);
     exit(0);
 }
@@ -409,12 +517,20 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
     bool is_cli_args = !ctx->opt.stream;
     bool was_frozen = ctx->opt.freeze;
     bool was_fullscreen = ctx->opt.fullscreen;
+    bool had_region = ctx->opt.has_region;
+    bool had_capture_thread = ctx->opt.capture_thread;
+    bool had_import_thread = ctx->opt.import_thread;
+    bool had_benchmark = ctx->opt.benchmark_backends;
+    bool had_hud = ctx->opt.hud;
     bool new_backend = false;
     bool new_region = false;
     bool new_output = false;
+    bool new_toplevel = false;
     bool new_fullscreen_output = false;
+    bool new_trace = false;
     char * region_output = NULL;
     char * arg_output = NULL;
+    char * arg_toplevel = NULL;
 
     while (argc > 0 && argv[0][0] == '-') {
         if (is_cli_args && (strcmp(argv[0], "-h") == 0 || strcmp(argv[0], "--help") == 0)) {
@@ -442,6 +558,12 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
             ctx->opt.freeze = false;
         } else if (strcmp(argv[0], "--toggle-freeze") == 0) {
             ctx->opt.freeze ^= 1;
+        } else if (strcmp(argv[0], "--hud") == 0) {
+            ctx->opt.hud = true;
+        } else if (strcmp(argv[0], "--no-hud") == 0) {
+            ctx->opt.hud = false;
+        } else if (strcmp(argv[0], "--toggle-hud") == 0) {
+            ctx->opt.hud ^= 1;
         } else if (strcmp(argv[0], "-F") == 0 || strcmp(argv[0], "--fullscreen") == 0) {
             ctx->opt.fullscreen = true;
         } else if (strcmp(argv[0], "--no-fullscreen") == 0) {
@@ -524,8 +646,145 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
         } else if (strcmp(argv[0], "--no-region") == 0) {
             ctx->opt.has_region = false;
             ctx->opt.region = (region_t){ .x = 0, .y = 0, .width = 0, .height = 0 };
+        } else if (strcmp(argv[0], "--toplevel") == 0) {
+            if (argc < 2) {
+                wlm_log_error("options::parse(): option %s requires an argument\n", argv[0]);
+                if (is_cli_args) wlm_exit_fail(ctx);
+            } else {
+                free(arg_toplevel);
+                arg_toplevel = strdup(argv[1]);
+                if (arg_toplevel == NULL) {
+                    wlm_log_error("options::parse(): failed to allocate copy of toplevel name\n");
+                    if (is_cli_args) wlm_exit_fail(ctx);
+                } else {
+                    new_toplevel = true;
+                }
+
+                argv++;
+                argc--;
+            }
+        } else if (strcmp(argv[0], "--present-on-change") == 0) {
+            ctx->opt.present_on_change = true;
+        } else if (strcmp(argv[0], "--no-present-on-change") == 0) {
+            ctx->opt.present_on_change = false;
+        } else if (strcmp(argv[0], "--jit-capture") == 0) {
+            ctx->opt.jit_capture = true;
+        } else if (strcmp(argv[0], "--no-jit-capture") == 0) {
+            ctx->opt.jit_capture = false;
+        } else if (strcmp(argv[0], "--capture-thread") == 0) {
+            ctx->opt.capture_thread = true;
+        } else if (strcmp(argv[0], "--no-capture-thread") == 0) {
+            ctx->opt.capture_thread = false;
+        } else if (strcmp(argv[0], "--import-thread") == 0) {
+            ctx->opt.import_thread = true;
+        } else if (strcmp(argv[0], "--no-import-thread") == 0) {
+            ctx->opt.import_thread = false;
+        } else if (strcmp(argv[0], "--gpu-fences") == 0) {
+            ctx->opt.gpu_fences = true;
+        } else if (strcmp(argv[0], "--no-gpu-fences") == 0) {
+            ctx->opt.gpu_fences = false;
+        } else if (strcmp(argv[0], "--measure-sync") == 0) {
+            ctx->opt.measure_sync = true;
+        } else if (strcmp(argv[0], "--no-measure-sync") == 0) {
+            ctx->opt.measure_sync = false;
+        } else if (strcmp(argv[0], "--benchmark-backends") == 0) {
+            ctx->opt.benchmark_backends = true;
+        } else if (strcmp(argv[0], "--no-benchmark-backends") == 0) {
+            ctx->opt.benchmark_backends = false;
+        } else if (strcmp(argv[0], "--max-fps") == 0) {
+            if (argc < 2) {
+                wlm_log_error("options::parse(): option %s requires an argument\n", argv[0]);
+                if (is_cli_args) wlm_exit_fail(ctx);
+            } else {
+                if (!wlm_opt_parse_uint(&ctx->opt.max_fps, argv[1], false)) {
+                    wlm_log_error("options::parse(): invalid frame rate %s\n", argv[1]);
+                    if (is_cli_args) wlm_exit_fail(ctx);
+                }
+
+                argv++;
+                argc--;
+            }
+        } else if (strcmp(argv[0], "--no-max-fps") == 0) {
+            ctx->opt.max_fps = 0;
+        } else if (strcmp(argv[0], "--capture-divider") == 0) {
+            if (argc < 2) {
+                wlm_log_error("options::parse(): option %s requires an argument\n", argv[0]);
+                if (is_cli_args) wlm_exit_fail(ctx);
+            } else {
+                if (!wlm_opt_parse_uint(&ctx->opt.capture_divider, argv[1], true)) {
+                    wlm_log_error("options::parse(): invalid capture divider %s\n", argv[1]);
+                    if (is_cli_args) wlm_exit_fail(ctx);
+                }
+
+                argv++;
+                argc--;
+            }
+        } else if (strcmp(argv[0], "--capture-timeout") == 0) {
+            if (argc < 2) {
+                wlm_log_error("options::parse(): option %s requires an argument\n", argv[0]);
+                if (is_cli_args) wlm_exit_fail(ctx);
+            } else {
+                if (!wlm_opt_parse_uint(&ctx->opt.capture_timeout_ms, argv[1], true)) {
+                    wlm_log_error("options::parse(): invalid capture timeout %s\n", argv[1]);
+                    if (is_cli_args) wlm_exit_fail(ctx);
+                }
+
+                argv++;
+                argc--;
+            }
+        } else if (strcmp(argv[0], "--no-capture-timeout") == 0) {
+            ctx->opt.capture_timeout_ms = 0;
+        } else if (strcmp(argv[0], "--max-frame-age") == 0) {
+            if (argc < 2) {
+                wlm_log_error("options::parse(): option %s requires an argument\n", argv[0]);
+                if (is_cli_args) wlm_exit_fail(ctx);
+            } else {
+                if (!wlm_opt_parse_uint(&ctx->opt.max_frame_age_ms, argv[1], true)) {
+                    wlm_log_error("options::parse(): invalid frame age %s\n", argv[1]);
+                    if (is_cli_args) wlm_exit_fail(ctx);
+                }
+
+                argv++;
+                argc--;
+            }
+        } else if (strcmp(argv[0], "--no-max-frame-age") == 0) {
+            ctx->opt.max_frame_age_ms = 0;
         } else if (strcmp(argv[0], "-S") == 0 || strcmp(argv[0], "--stream") == 0) {
             ctx->opt.stream = true;
+        } else if (strcmp(argv[0], "--stats") == 0) {
+            if (is_cli_args) {
+                wlm_log_error("options::parse(): option %s is only supported in stream mode\n", argv[0]);
+                wlm_exit_fail(ctx);
+            } else {
+                wlm_stats_print(ctx);
+            }
+        } else if (strcmp(argv[0], "--trace") == 0) {
+            if (argc < 2) {
+                wlm_log_error("options::parse(): option %s requires an argument\n", argv[0]);
+                if (is_cli_args) wlm_exit_fail(ctx);
+            } else {
+                // write out the running trace before starting a new one
+                if (!is_cli_args) wlm_trace_flush(ctx);
+                free(ctx->opt.trace_file);
+                ctx->opt.trace_file = strdup(argv[1]);
+                if (ctx->opt.trace_file == NULL) {
+                    wlm_log_error("options::parse(): failed to allocate copy of trace file name\n");
+                    if (is_cli_args) wlm_exit_fail(ctx);
+                }
+
+                new_trace = true;
+                argv++;
+                argc--;
+            }
+        } else if (strcmp(argv[0], "--no-trace") == 0) {
+            if (!is_cli_args) wlm_trace_flush(ctx);
+            free(ctx->opt.trace_file);
+            ctx->opt.trace_file = NULL;
+            new_trace = true;
+        } else if (strcmp(argv[0], "--perf-counters") == 0) {
+            ctx->opt.perf_counters = true;
+        } else if (strcmp(argv[0], "--no-perf-counters") == 0) {
+            ctx->opt.perf_counters = false;
         } else if (strcmp(argv[0], "--") == 0) {
             argv++;
             argc--;
@@ -549,6 +808,28 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
         }
     }
 
+    if (new_toplevel && (new_output || new_region)) {
+        wlm_log_error("options::parse(): toplevel cannot be combined with an output or region\n");
+        if (is_cli_args) wlm_exit_fail(ctx);
+        free(arg_toplevel);
+        arg_toplevel = NULL;
+        new_toplevel = false;
+    }
+
+    if (new_toplevel) {
+        // toplevel replaces output and region
+        free(ctx->opt.output);
+        ctx->opt.output = NULL;
+        ctx->opt.has_region = false;
+        ctx->opt.region = (region_t){ .x = 0, .y = 0, .width = 0, .height = 0 };
+        free(ctx->opt.toplevel);
+        ctx->opt.toplevel = arg_toplevel;
+    } else if (new_output || new_region) {
+        // output or region replaces toplevel
+        free(ctx->opt.toplevel);
+        ctx->opt.toplevel = NULL;
+    }
+
     if (new_output || new_region) {
         free(ctx->opt.output);
         ctx->opt.output = NULL;
@@ -581,8 +862,8 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
     } else if (new_output && !new_region) {
         // output defined by argument
         ctx->opt.output = arg_output;
-    } else if (!new_output && !new_region && is_cli_args) {
-        // no output or region specified
+    } else if (!new_output && !new_region && !new_toplevel && is_cli_args) {
+        // no output, region, or toplevel specified
         wlm_opt_usage(ctx);
     }
 
@@ -599,17 +880,52 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
         if (is_cli_args) wlm_exit_fail(ctx);
     }
 
+    if (new_trace) {
+        wlm_trace_update(ctx);
+    }
+
     if (!is_cli_args && ctx->opt.fullscreen && (!was_fullscreen || new_fullscreen_output)) {
         wlm_wayland_window_set_fullscreen(ctx);
     } else if (!is_cli_args && !ctx->opt.fullscreen && was_fullscreen) {
         wlm_wayland_window_unset_fullscreen(ctx);
     }
 
+    bool was_toplevel = ctx->mirror.current_toplevel != NULL;
     output_list_node_t * target_output = NULL;
     region_t target_region = (region_t){ .x = 0, .y = 0, .width = 0, .height = 0 };
-    if (!is_cli_args && wlm_opt_find_output(ctx, &target_output, &target_region)) {
+    toplevel_list_node_t * target_toplevel = NULL;
+    if (!is_cli_args && ctx->opt.toplevel != NULL) {
+        if (wlm_opt_find_toplevel(ctx, &target_toplevel)) {
+            ctx->mirror.current_target = NULL;
+            ctx->mirror.current_region = target_region;
+            ctx->mirror.current_toplevel = target_toplevel;
+        }
+    } else if (!is_cli_args && wlm_opt_find_output(ctx, &target_output, &target_region)) {
         ctx->mirror.current_target = target_output;
         ctx->mirror.current_region = target_region;
+        ctx->mirror.current_toplevel = NULL;
+    }
+
+    // backend order depends on the kind of target, retry all backends when switching
+    // - not every backend can capture toplevels
+    // - regions are preferably captured by region-aware backends
+    bool is_toplevel = ctx->mirror.current_toplevel != NULL;
+    bool target_kind_changed = was_toplevel != is_toplevel || had_region != ctx->opt.has_region;
+    if (!is_cli_args && ctx->opt.backend == BACKEND_AUTO && target_kind_changed) {
+        ctx->mirror.auto_backend_index = 0;
+        new_backend = true;
+    }
+
+    // capture and import threads are only set up when the backend is created
+    bool threads_changed = had_capture_thread != ctx->opt.capture_thread || had_import_thread != ctx->opt.import_thread;
+    if (!is_cli_args && threads_changed) {
+        if (ctx->opt.backend == BACKEND_AUTO) ctx->mirror.auto_backend_index = 0;
+        new_backend = true;
+    }
+
+    // rerun the backend benchmark when it is requested again
+    if (!is_cli_args && ctx->opt.backend == BACKEND_AUTO && !had_benchmark && ctx->opt.benchmark_backends) {
+        new_backend = true;
     }
 
     if (!is_cli_args && new_backend) {
@@ -620,6 +936,10 @@ void wlm_opt_parse(ctx_t * ctx, int argc, char ** argv) {
         wlm_egl_freeze_framebuffer(ctx);
     }
 
+    if (!is_cli_args && had_hud != ctx->opt.hud) {
+        wlm_hud_update(ctx);
+    }
+
     if (!is_cli_args) {
         wlm_egl_update_uniforms(ctx);
         wlm_mirror_update_title(ctx);
@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <wlm/context.h>
+#include <wlm/perf.h>
+#if __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char * stage_names[PERF_STAGE_COUNT] = {
+    [PERF_STAGE_BACKEND] = "backend",
+    [PERF_STAGE_UPLOAD] = "upload",
+    [PERF_STAGE_DRAW] = "draw",
+    [PERF_STAGE_SWAP] = "swap",
+    [PERF_STAGE_STREAM] = "stream"
+};
+
+static const char * counter_names[PERF_COUNTER_COUNT] = {
+    [PERF_COUNTER_CYCLES] = "cycles",
+    [PERF_COUNTER_INSTRUCTIONS] = "instructions",
+    [PERF_COUNTER_CACHE_MISSES] = "cache_misses",
+    [PERF_COUNTER_CONTEXT_SWITCHES] = "context_switches"
+};
+
+// --- counter groups ---
+
+static int open_counter(perf_counter_t counter, int group_fd) {
+#if __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_hv = 1;
+
+    switch (counter) {
+        case PERF_COUNTER_CYCLES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PERF_COUNTER_INSTRUCTIONS:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PERF_COUNTER_CACHE_MISSES:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        default:
+            attr.type = PERF_TYPE_SOFTWARE;
+            attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+            break;
+    }
+
+    // count kernel time if allowed, driver work partially runs in the kernel
+    // - context switches only happen in the kernel and can't be counted otherwise
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    if (fd == -1 && (errno == EACCES || errno == EPERM) && attr.type == PERF_TYPE_HARDWARE) {
+        attr.exclude_kernel = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+    }
+
+    return fd;
+#else
+    (void)counter;
+    (void)group_fd;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+static void destroy_group(void * data) {
+    perf_group_t * group = (perf_group_t *)data;
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (group->fds[i] != -1) close(group->fds[i]);
+    }
+    free(group);
+}
+
+static perf_group_t * get_group(ctx_t * ctx) {
+    perf_group_t * group = pthread_getspecific(ctx->perf.group_key);
+    if (group != NULL) return group;
+
+    group = malloc(sizeof (perf_group_t));
+    if (group == NULL) {
+        wlm_log_error("perf::get_group(): failed to allocate counter group\n");
+        return NULL;
+    }
+
+    group->leader_fd = -1;
+    group->open_count = 0;
+    for (size_t i = 0; i < PERF_STAGE_COUNT; i++) {
+        group->active[i] = false;
+    }
+
+    // unavailable counters are left out of the group
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        group->fds[i] = open_counter(i, group->leader_fd);
+        group->slot[i] = -1;
+        if (group->fds[i] == -1) {
+            wlm_log_debug(ctx, "perf::get_group(): counter %s unavailable: %s\n", counter_names[i], strerror(errno));
+            continue;
+        }
+
+        if (group->leader_fd == -1) group->leader_fd = group->fds[i];
+        group->slot[i] = group->open_count++;
+    }
+
+    // group is kept even without counters, so they are not reopened on every stage
+    if (group->leader_fd == -1) {
+        wlm_log_warn("perf::get_group(): no performance counters available on this thread\n");
+    }
+
+    if (pthread_setspecific(ctx->perf.group_key, group) != 0) {
+        wlm_log_error("perf::get_group(): failed to store counter group\n");
+        destroy_group(group);
+        return NULL;
+    }
+
+    return group;
+}
+
+static bool read_group(perf_group_t * group, uint64_t values[PERF_COUNTER_COUNT]) {
+    // PERF_FORMAT_GROUP reads the number of counters followed by their values
+    uint64_t buffer[1 + PERF_COUNTER_COUNT];
+    ssize_t size = (1 + group->open_count) * sizeof (uint64_t);
+    if (read(group->leader_fd, buffer, sizeof buffer) != size) return false;
+
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        values[i] = group->slot[i] == -1 ? 0 : buffer[1 + group->slot[i]];
+    }
+
+    return true;
+}
+
+// --- init_perf ---
+
+void wlm_perf_init(ctx_t * ctx) {
+    // initialize context structure
+    for (size_t i = 0; i < PERF_STAGE_COUNT; i++) {
+        perf_stage_stats_t * stats = &ctx->perf.stages[i];
+        atomic_init(&stats->samples, 0);
+        for (size_t j = 0; j < PERF_COUNTER_COUNT; j++) {
+            atomic_init(&stats->total[j], 0);
+            atomic_init(&stats->last[j], 0);
+        }
+    }
+
+    if (pthread_key_create(&ctx->perf.group_key, destroy_group) != 0) {
+        wlm_log_error("perf::init(): failed to create thread key\n");
+        wlm_exit_fail(ctx);
+    }
+
+    ctx->perf.initialized = true;
+}
+
+// --- begin ---
+
+void wlm_perf_begin(ctx_t * ctx, perf_stage_t stage) {
+    if (!ctx->opt.perf_counters || !ctx->perf.initialized) return;
+
+    perf_group_t * group = get_group(ctx);
+    if (group == NULL || group->leader_fd == -1) return;
+
+    group->active[stage] = read_group(group, group->begin[stage]);
+}
+
+// --- end ---
+
+void wlm_perf_end(ctx_t * ctx, perf_stage_t stage) {
+    if (!ctx->opt.perf_counters || !ctx->perf.initialized) return;
+
+    // stages begun before counters were enabled are not counted
+    perf_group_t * group = pthread_getspecific(ctx->perf.group_key);
+    if (group == NULL || !group->active[stage]) return;
+    group->active[stage] = false;
+
+    uint64_t values[PERF_COUNTER_COUNT];
+    if (!read_group(group, values)) return;
+
+    // readers may see counts of different samples, which is fine for stats
+    perf_stage_stats_t * stats = &ctx->perf.stages[stage];
+    for (size_t i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t count = values[i] - group->begin[stage][i];
+        atomic_fetch_add_explicit(&stats->total[i], count, memory_order_relaxed);
+        atomic_store_explicit(&stats->last[i], count, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&stats->samples, 1, memory_order_relaxed);
+}
+
+// --- print ---
+
+void wlm_perf_print(ctx_t * ctx) {
+    printf("{");
+    for (size_t i = 0; i < PERF_STAGE_COUNT; i++) {
+        perf_stage_stats_t * stats = &ctx->perf.stages[i];
+        uint64_t samples = atomic_load(&stats->samples);
+
+        printf("%s\"%s\":{\"samples\":%llu", i > 0 ? "," : "", stage_names[i], (unsigned long long)samples);
+        for (size_t j = 0; j < PERF_COUNTER_COUNT; j++) {
+            uint64_t total = atomic_load(&stats->total[j]);
+            printf(",\"%s\":{\"last\":%llu,\"total\":%llu,\"mean\":%.1f}",
+                counter_names[j],
+                (unsigned long long)atomic_load(&stats->last[j]),
+                (unsigned long long)total,
+                samples > 0 ? (double)total / samples : 0.0
+            );
+        }
+        printf("}");
+    }
+    printf("}");
+}
+
+// --- cleanup_perf ---
+
+void wlm_perf_cleanup(ctx_t * ctx) {
+    if (!ctx->perf.initialized) return;
+
+    wlm_log_debug(ctx, "perf::cleanup(): destroying perf objects\n");
+
+    // other threads close their counters when they exit
+    perf_group_t * group = pthread_getspecific(ctx->perf.group_key);
+    if (group != NULL) destroy_group(group);
+    pthread_setspecific(ctx->perf.group_key, NULL);
+    pthread_key_delete(ctx->perf.group_key);
+
+    ctx->perf.initialized = false;
+}
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <wlm/context.h>
+#include <wlm/stats.h>
+
+static const char * stage_names[STATS_STAGE_COUNT] = {
+    [STATS_STAGE_ANSWER] = "answer",
+    [STATS_STAGE_CAPTURE] = "capture",
+    [STATS_STAGE_DELIVER] = "deliver",
+    [STATS_STAGE_UPLOAD] = "upload",
+    [STATS_STAGE_DRAW] = "draw",
+    [STATS_STAGE_SWAP] = "swap",
+    [STATS_STAGE_TOTAL] = "total",
+    [STATS_STAGE_GPU_IMPORT] = "gpu_import",
+    [STATS_STAGE_GPU_UPLOAD] = "gpu_upload",
+    [STATS_STAGE_GPU_DRAW] = "gpu_draw"
+};
+
+// --- signal event handlers ---
+
+static void on_signal(ctx_t * ctx) {
+    struct signalfd_siginfo info;
+    bool print = false;
+    while (read(ctx->stats.signal_handler.fd, &info, sizeof info) == sizeof info) {
+        if (info.ssi_signo == SIGUSR1) print = true;
+    }
+
+    // signals received in the same wakeup only print once
+    if (print) wlm_stats_print(ctx);
+}
+
+// --- init_stats ---
+
+void wlm_stats_init(ctx_t * ctx) {
+    // initialize context structure
+    for (size_t i = 0; i < STATS_STAGE_COUNT; i++) {
+        ctx->stats.stages[i].next = 0;
+        ctx->stats.stages[i].len = 0;
+        ctx->stats.stages[i].count = 0;
+    }
+    for (size_t i = 0; i < STATS_MARK_COUNT; i++) {
+        atomic_init(&ctx->stats.marks[i], 0);
+    }
+
+    ctx->stats.ready_request_ns = 0;
+    ctx->stats.uploaded_frames = 0;
+    ctx->stats.drawn_frames = 0;
+    ctx->stats.last_drawn_upload = 0;
+    atomic_init(&ctx->stats.dropped_frames, 0);
+
+    ctx->stats.signal_handler.next = NULL;
+    ctx->stats.signal_handler.fd = -1;
+    ctx->stats.signal_handler.events = EPOLLIN;
+    ctx->stats.signal_handler.priority = EVENT_PRIORITY_CONTROL;
+    ctx->stats.signal_handler.on_event = on_signal;
+    ctx->stats.signal_handler.on_each = NULL;
+
+    ctx->stats.initialized = true;
+
+    // receive SIGUSR1 through a signalfd instead of a signal handler
+    // - blocked before any thread is created, so every thread inherits the mask
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+        wlm_log_error("stats::init(): failed to block SIGUSR1\n");
+        wlm_exit_fail(ctx);
+    }
+
+    ctx->stats.signal_handler.fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (ctx->stats.signal_handler.fd == -1) {
+        wlm_log_error("stats::init(): failed to create signalfd\n");
+        wlm_exit_fail(ctx);
+    }
+
+    wlm_event_add_fd(ctx, &ctx->stats.signal_handler);
+}
+
+// --- mark ---
+
+void wlm_stats_mark(ctx_t * ctx, stats_mark_t mark) {
+    // first backend event of a capture wins
+    uint64_t expected = 0;
+    if (mark == STATS_MARK_EVENT) {
+        atomic_compare_exchange_strong(&ctx->stats.marks[mark], &expected, wlm_event_now_ns());
+    } else {
+        atomic_store(&ctx->stats.marks[mark], wlm_event_now_ns());
+    }
+}
+
+// --- frame_dropped ---
+
+void wlm_stats_frame_dropped(ctx_t * ctx) {
+    atomic_fetch_add(&ctx->stats.dropped_frames, 1);
+}
+
+// --- frame_uploaded ---
+
+void wlm_stats_frame_uploaded(ctx_t * ctx) {
+    ctx->stats.uploaded_frames++;
+}
+
+// --- frame_drawn ---
+
+void wlm_stats_frame_drawn(ctx_t * ctx, uint64_t draw_start_ns, uint64_t swap_start_ns, uint64_t swap_end_ns) {
+    wlm_stats_record(ctx, STATS_STAGE_DRAW, swap_start_ns - draw_start_ns);
+    wlm_stats_record(ctx, STATS_STAGE_SWAP, swap_end_ns - swap_start_ns);
+
+    // redraws of the same frame don't count towards the frame path
+    if (ctx->stats.uploaded_frames == ctx->stats.last_drawn_upload) return;
+    ctx->stats.last_drawn_upload = ctx->stats.uploaded_frames;
+    ctx->stats.drawn_frames++;
+
+    uint64_t request_ns = ctx->stats.ready_request_ns;
+    if (request_ns != 0 && swap_end_ns >= request_ns) {
+        wlm_stats_record(ctx, STATS_STAGE_TOTAL, swap_end_ns - request_ns);
+    }
+}
+
+// --- capture_done ---
+
+void wlm_stats_capture_done(ctx_t * ctx, uint64_t request_ns, uint64_t now_ns) {
+    uint64_t event_ns = atomic_exchange(&ctx->stats.marks[STATS_MARK_EVENT], 0);
+    uint64_t ready_ns = atomic_exchange(&ctx->stats.marks[STATS_MARK_READY], 0);
+    if (request_ns == 0) return;
+
+    // marks left over from an abandoned capture are older than the request
+    if (event_ns >= request_ns) wlm_stats_record(ctx, STATS_STAGE_ANSWER, event_ns - request_ns);
+    if (ready_ns >= request_ns) {
+        wlm_stats_record(ctx, STATS_STAGE_CAPTURE, ready_ns - request_ns);
+        if (now_ns >= ready_ns) wlm_stats_record(ctx, STATS_STAGE_DELIVER, now_ns - ready_ns);
+    }
+
+    ctx->stats.ready_request_ns = request_ns;
+}
+
+// --- record ---
+
+void wlm_stats_record(ctx_t * ctx, stats_stage_t stage, uint64_t duration_ns) {
+    stats_histogram_t * histogram = &ctx->stats.stages[stage];
+
+    uint64_t duration_us = duration_ns / 1000;
+    if (duration_us > UINT32_MAX) duration_us = UINT32_MAX;
+
+    histogram->samples_us[histogram->next] = duration_us;
+    histogram->next = (histogram->next + 1) % STATS_WINDOW;
+    if (histogram->len < STATS_WINDOW) histogram->len++;
+    histogram->count++;
+}
+
+// --- print ---
+
+static int compare_samples(const void * a, const void * b) {
+    uint32_t sample_a = *(const uint32_t *)a;
+    uint32_t sample_b = *(const uint32_t *)b;
+    return (sample_a > sample_b) - (sample_a < sample_b);
+}
+
+static double percentile_ms(const uint32_t * sorted, size_t len, size_t permille) {
+    if (len == 0) return 0;
+
+    // nearest rank
+    size_t rank = (len * permille + 999) / 1000;
+    if (rank == 0) rank = 1;
+    return sorted[rank - 1] / 1000.0;
+}
+
+void wlm_stats_print(ctx_t * ctx) {
+    mirror_backend_t * backend = ctx->mirror.backend;
+    size_t cancel_count = backend != NULL ? atomic_load(&backend->cancel_count) : 0;
+    size_t fail_count = backend != NULL ? atomic_load(&backend->fail_count) : 0;
+
+    printf("{\"timestamp_ns\":%llu", (unsigned long long)wlm_event_now_ns());
+    printf(",\"frames\":{\"drawn\":%llu,\"dropped\":%llu,\"stale\":%llu}",
+        (unsigned long long)ctx->stats.drawn_frames,
+        (unsigned long long)atomic_load(&ctx->stats.dropped_frames),
+        (unsigned long long)ctx->mirror.stale_frames
+    );
+    printf(",\"captures\":{\"timeouts\":%llu,\"stalls\":%llu,\"cancels\":%zu,\"fail_count\":%zu}",
+        (unsigned long long)ctx->mirror.capture_timeouts,
+        (unsigned long long)ctx->mirror.capture_stalls,
+        cancel_count, fail_count
+    );
+
+    printf(",\"stages\":{");
+    for (size_t i = 0; i < STATS_STAGE_COUNT; i++) {
+        stats_histogram_t * histogram = &ctx->stats.stages[i];
+
+        uint32_t sorted[STATS_WINDOW];
+        memcpy(sorted, histogram->samples_us, histogram->len * sizeof (uint32_t));
+        qsort(sorted, histogram->len, sizeof (uint32_t), compare_samples);
+
+        printf("%s\"%s\":{\"count\":%llu,\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f}",
+            i > 0 ? "," : "", stage_names[i],
+            (unsigned long long)histogram->count,
+            percentile_ms(sorted, histogram->len, 500),
+            percentile_ms(sorted, histogram->len, 950),
+            percentile_ms(sorted, histogram->len, 990),
+            percentile_ms(sorted, histogram->len, 1000)
+        );
+    }
+    printf("}");
+
+    if (ctx->opt.perf_counters) {
+        printf(",\"perf\":");
+        wlm_perf_print(ctx);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+// --- cleanup_stats ---
+
+void wlm_stats_cleanup(ctx_t * ctx) {
+    if (!ctx->stats.initialized) return;
+
+    wlm_log_debug(ctx, "stats::cleanup(): destroying stats objects\n");
+
+    if (ctx->stats.signal_handler.fd != -1) {
+        wlm_event_remove_fd(ctx, &ctx->stats.signal_handler);
+        close(ctx->stats.signal_handler.fd);
+    }
+
+    ctx->stats.initialized = false;
+}
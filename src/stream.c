@@ -54,6 +54,7 @@ static void on_line(ctx_t * ctx, char * line) {
 
     wlm_log_debug(ctx, "event::on_line(): got line '%s'\n", line);
 
+    wlm_perf_begin(ctx, PERF_STAGE_STREAM);
     ctx->stream.args_len = 0;
 
     enum parse_state state = BEFORE_ARG;
@@ -114,7 +115,10 @@ static void on_line(ctx_t * ctx, char * line) {
 
     wlm_log_debug(ctx, "event::on_line(): parsed %zd arguments\n", ctx->stream.args_len);
 
+    // the capture thread is only restarted if the backend or threading changes
+    // - captures get their target and options through the capture request
     wlm_opt_parse(ctx, ctx->stream.args_len, ctx->stream.args);
+    wlm_perf_end(ctx, PERF_STAGE_STREAM);
 }
 
 static void on_stream_data(ctx_t * ctx) {
@@ -162,7 +166,7 @@ void wlm_stream_init(ctx_t * ctx) {
     ctx->stream.event_handler.next = NULL;
     ctx->stream.event_handler.fd = STDIN_FILENO;
     ctx->stream.event_handler.events = EPOLLIN;
-    ctx->stream.event_handler.timeout_ms = -1;
+    ctx->stream.event_handler.priority = EVENT_PRIORITY_CONTROL;
     ctx->stream.event_handler.on_event = on_stream_data;
     ctx->stream.event_handler.on_each = NULL;
 
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/signalfd.h>
+#include <wlm/context.h>
+#include <wlm/trace.h>
+
+static const char * track_names[TRACE_TRACK_COUNT] = {
+    [TRACE_TRACK_MAIN] = "main thread",
+    [TRACE_TRACK_CAPTURE] = "capture thread",
+    [TRACE_TRACK_IMPORT] = "import thread",
+    [TRACE_TRACK_BACKEND_STATE] = "backend state"
+};
+
+static _Thread_local trace_track_t current_track = TRACE_TRACK_MAIN;
+
+// --- signal event handlers ---
+
+static void on_signal(ctx_t * ctx) {
+    struct signalfd_siginfo info;
+    bool flush = false;
+    while (read(ctx->trace.signal_handler.fd, &info, sizeof info) == sizeof info) {
+        if (info.ssi_signo == SIGUSR2) flush = true;
+    }
+
+    if (flush) wlm_trace_flush(ctx);
+}
+
+// --- init_trace ---
+
+void wlm_trace_init(ctx_t * ctx) {
+    // initialize context structure
+    ctx->trace.ring = NULL;
+    atomic_init(&ctx->trace.head, 0);
+    ctx->trace.start = 0;
+    atomic_init(&ctx->trace.enabled, false);
+
+    ctx->trace.signal_handler.next = NULL;
+    ctx->trace.signal_handler.fd = -1;
+    ctx->trace.signal_handler.events = EPOLLIN;
+    ctx->trace.signal_handler.priority = EVENT_PRIORITY_CONTROL;
+    ctx->trace.signal_handler.on_event = on_signal;
+    ctx->trace.signal_handler.on_each = NULL;
+
+    ctx->trace.initialized = true;
+
+    // receive SIGUSR2 through a signalfd instead of a signal handler
+    // - blocked before any thread is created, so every thread inherits the mask
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR2);
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) {
+        wlm_log_error("trace::init(): failed to block SIGUSR2\n");
+        wlm_exit_fail(ctx);
+    }
+
+    ctx->trace.signal_handler.fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (ctx->trace.signal_handler.fd == -1) {
+        wlm_log_error("trace::init(): failed to create signalfd\n");
+        wlm_exit_fail(ctx);
+    }
+
+    wlm_event_add_fd(ctx, &ctx->trace.signal_handler);
+}
+
+// --- update ---
+
+void wlm_trace_update(ctx_t * ctx) {
+    if (ctx->opt.trace_file == NULL) {
+        atomic_store(&ctx->trace.enabled, false);
+        return;
+    }
+
+    // preallocate the whole ring so recording never allocates
+    if (ctx->trace.ring == NULL) {
+        ctx->trace.ring = calloc(TRACE_RING_SIZE, sizeof (trace_event_t));
+        if (ctx->trace.ring == NULL) {
+            wlm_log_error("trace::update(): failed to allocate trace buffer\n");
+            wlm_exit_fail(ctx);
+        }
+    }
+
+    // start a new trace, events from before are not written to the new file
+    ctx->trace.start = atomic_load(&ctx->trace.head);
+    atomic_store(&ctx->trace.enabled, true);
+}
+
+// --- set_thread ---
+
+void wlm_trace_set_thread(trace_track_t track) {
+    current_track = track;
+}
+
+// --- record ---
+
+static void record(ctx_t * ctx, trace_track_t track, char phase, const char * name) {
+    if (name == NULL || !atomic_load_explicit(&ctx->trace.enabled, memory_order_relaxed)) return;
+
+    uint64_t index = atomic_fetch_add_explicit(&ctx->trace.head, 1, memory_order_relaxed);
+    trace_event_t * event = &ctx->trace.ring[index % TRACE_RING_SIZE];
+
+    // invalidate the slot while it is rewritten
+    atomic_store_explicit(&event->sequence, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    event->timestamp_ns = wlm_event_now_ns();
+    event->name = name;
+    event->track = track;
+    event->phase = phase;
+
+    atomic_store_explicit(&event->sequence, index + 1, memory_order_release);
+}
+
+void wlm_trace_begin(ctx_t * ctx, const char * name) {
+    record(ctx, current_track, 'B', name);
+}
+
+void wlm_trace_end(ctx_t * ctx, const char * name) {
+    record(ctx, current_track, 'E', name);
+}
+
+void wlm_trace_state(ctx_t * ctx, const char * old_state, const char * new_state) {
+    // states without a name are not shown
+    record(ctx, TRACE_TRACK_BACKEND_STATE, 'E', old_state);
+    record(ctx, TRACE_TRACK_BACKEND_STATE, 'B', new_state);
+}
+
+// --- flush ---
+
+void wlm_trace_flush(ctx_t * ctx) {
+    if (ctx->trace.ring == NULL || ctx->opt.trace_file == NULL) return;
+
+    FILE * file = fopen(ctx->opt.trace_file, "w");
+    if (file == NULL) {
+        wlm_log_error("trace::flush(): failed to open trace file %s\n", ctx->opt.trace_file);
+        return;
+    }
+
+    int pid = (int)getpid();
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"wl-mirror\"}}", pid);
+    for (size_t i = 0; i < TRACE_TRACK_COUNT; i++) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+            pid, i, track_names[i]
+        );
+    }
+
+    // only the newest TRACE_RING_SIZE events are still in the ring
+    uint64_t end = atomic_load(&ctx->trace.head);
+    uint64_t begin = ctx->trace.start;
+    if (end - begin > TRACE_RING_SIZE) begin = end - TRACE_RING_SIZE;
+
+    size_t written = 0;
+    for (uint64_t index = begin; index < end; index++) {
+        trace_event_t * slot = &ctx->trace.ring[index % TRACE_RING_SIZE];
+
+        // skip events still being written or already overwritten
+        uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        trace_event_t event = {
+            .timestamp_ns = slot->timestamp_ns,
+            .name = slot->name,
+            .track = slot->track,
+            .phase = slot->phase
+        };
+        atomic_thread_fence(memory_order_acquire);
+        if (sequence != index + 1 || atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence) continue;
+
+        fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03llu,\"pid\":%d,\"tid\":%d}",
+            event.name, event.phase,
+            (unsigned long long)(event.timestamp_ns / 1000), (unsigned long long)(event.timestamp_ns % 1000),
+            pid, (int)event.track
+        );
+        written++;
+    }
+
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        wlm_log_error("trace::flush(): failed to write trace file %s\n", ctx->opt.trace_file);
+        return;
+    }
+
+    wlm_log_debug(ctx, "trace::flush(): wrote %zu events to %s\n", written, ctx->opt.trace_file);
+}
+
+// --- cleanup_trace ---
+
+void wlm_trace_cleanup(ctx_t * ctx) {
+    if (!ctx->trace.initialized) return;
+
+    wlm_log_debug(ctx, "trace::cleanup(): destroying trace objects\n");
+
+    if (atomic_load(&ctx->trace.enabled)) wlm_trace_flush(ctx);
+    atomic_store(&ctx->trace.enabled, false);
+
+    if (ctx->trace.ring != NULL) free(ctx->trace.ring);
+    ctx->trace.ring = NULL;
+
+    if (ctx->trace.signal_handler.fd != -1) {
+        wlm_event_remove_fd(ctx, &ctx->trace.signal_handler);
+        close(ctx->trace.signal_handler.fd);
+    }
+
+    ctx->trace.initialized = false;
+}
@@ -208,3 +208,46 @@ void wlm_util_region_clamp(region_t * region, const region_t * output) {
         region->height = output->height - region->y;
     }
 }
+
+void wlm_util_region_union(region_t * region, const region_t * other) {
+    // grow region to the bounding box of both regions
+    uint32_t x1 = region->x < other->x ? region->x : other->x;
+    uint32_t y1 = region->y < other->y ? region->y : other->y;
+    uint32_t x2 = region->x + region->width > other->x + other->width ?
+        region->x + region->width : other->x + other->width;
+    uint32_t y2 = region->y + region->height > other->y + other->height ?
+        region->y + region->height : other->y + other->height;
+
+    region->x = x1;
+    region->y = y1;
+    region->width = x2 - x1;
+    region->height = y2 - y1;
+}
+
+void wlm_util_damage_clear(damage_t * damage) {
+    damage->count = 0;
+}
+
+void wlm_util_damage_add(damage_t * damage, const region_t * rect) {
+    if (rect->width == 0 || rect->height == 0) {
+        return;
+    }
+
+    // merge into a single bounding box when out of rectangles
+    if (damage->count == MAX_DAMAGE_RECTS) {
+        for (size_t i = 1; i < damage->count; i++) {
+            wlm_util_region_union(&damage->rects[0], &damage->rects[i]);
+        }
+        wlm_util_region_union(&damage->rects[0], rect);
+        damage->count = 1;
+        return;
+    }
+
+    damage->rects[damage->count++] = *rect;
+}
+
+void wlm_util_damage_merge(damage_t * damage, const damage_t * other) {
+    for (size_t i = 0; i < other->count; i++) {
+        wlm_util_damage_add(damage, &other->rects[i]);
+    }
+}
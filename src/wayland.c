@@ -52,7 +52,7 @@ static void on_output_geometry(
         node->transform = transform;
 
         // update egl viewport only if this is the target output
-        if (ctx->mirror.initialized && ctx->mirror.current_target->output == output) {
+        if (ctx->mirror.initialized && ctx->mirror.current_target != NULL && ctx->mirror.current_target->output == output) {
             wlm_egl_resize_viewport(ctx);
         }
     }
@@ -198,6 +198,177 @@ static const struct zxdg_output_v1_listener xdg_output_listener = {
     .done = on_xdg_output_done
 };
 
+// --- presentation event handlers ---
+
+static void on_presentation_clock_id(
+    void * data, struct wp_presentation * presentation,
+    uint32_t clock_id
+) {
+    ctx_t * ctx = (ctx_t *)data;
+
+    wlm_log_debug(ctx, "wayland::on_presentation_clock_id(): presentation clock is %d\n", clock_id);
+    ctx->wl.presentation_clock = clock_id;
+
+    (void)presentation;
+}
+
+static const struct wp_presentation_listener presentation_listener = {
+    .clock_id = on_presentation_clock_id
+};
+
+// --- toplevel_handle event handlers ---
+
+static void update_toplevel_string(toplevel_list_node_t * node, char ** field, const char * value) {
+    ctx_t * ctx = node->ctx;
+
+    // allocate copy of value since value is owned by libwayland
+    free(*field);
+    *field = strdup(value);
+    if (*field == NULL) {
+        wlm_log_error("wayland::update_toplevel_string(): failed to allocate toplevel string\n");
+        wlm_exit_fail(ctx);
+    }
+}
+
+static void on_toplevel_closed(
+    void * data, struct ext_foreign_toplevel_handle_v1 * handle
+) {
+    toplevel_list_node_t * node = (toplevel_list_node_t *)data;
+    ctx_t * ctx = node->ctx;
+
+    wlm_log_debug(ctx, "wayland::on_toplevel_closed(): toplevel %s closed\n", node->identifier);
+
+    // notify mirror code of closed toplevels
+    // - triggers exit if the target toplevel disappears
+    wlm_mirror_toplevel_removed(ctx, node);
+
+    // remove toplevel node from linked list
+    toplevel_list_node_t ** link = &ctx->wl.toplevels;
+    while (*link != NULL && *link != node) {
+        link = &(*link)->next;
+    }
+    if (*link != NULL) {
+        *link = node->next;
+    }
+
+    // deallocate toplevel node
+    ext_foreign_toplevel_handle_v1_destroy(node->handle);
+    free(node->title);
+    free(node->app_id);
+    free(node->identifier);
+    free(node);
+
+    (void)handle;
+}
+
+static void on_toplevel_done(
+    void * data, struct ext_foreign_toplevel_handle_v1 * handle
+) {
+    toplevel_list_node_t * node = (toplevel_list_node_t *)data;
+    ctx_t * ctx = node->ctx;
+
+    wlm_log_debug(ctx, "wayland::on_toplevel_done(): updated toplevel %s (app_id = %s, title = %s)\n",
+        node->identifier, node->app_id, node->title
+    );
+
+    // update window title if this is the target toplevel
+    if (ctx->mirror.initialized && ctx->mirror.current_toplevel == node) {
+        wlm_mirror_update_title(ctx);
+    }
+
+    (void)handle;
+}
+
+static void on_toplevel_title(
+    void * data, struct ext_foreign_toplevel_handle_v1 * handle,
+    const char * title
+) {
+    toplevel_list_node_t * node = (toplevel_list_node_t *)data;
+    update_toplevel_string(node, &node->title, title);
+
+    (void)handle;
+}
+
+static void on_toplevel_app_id(
+    void * data, struct ext_foreign_toplevel_handle_v1 * handle,
+    const char * app_id
+) {
+    toplevel_list_node_t * node = (toplevel_list_node_t *)data;
+    update_toplevel_string(node, &node->app_id, app_id);
+
+    (void)handle;
+}
+
+static void on_toplevel_identifier(
+    void * data, struct ext_foreign_toplevel_handle_v1 * handle,
+    const char * identifier
+) {
+    toplevel_list_node_t * node = (toplevel_list_node_t *)data;
+    update_toplevel_string(node, &node->identifier, identifier);
+
+    (void)handle;
+}
+
+static const struct ext_foreign_toplevel_handle_v1_listener toplevel_handle_listener = {
+    .closed = on_toplevel_closed,
+    .done = on_toplevel_done,
+    .title = on_toplevel_title,
+    .app_id = on_toplevel_app_id,
+    .identifier = on_toplevel_identifier
+};
+
+// --- toplevel_list event handlers ---
+
+static void on_toplevel_list_toplevel(
+    void * data, struct ext_foreign_toplevel_list_v1 * toplevel_list,
+    struct ext_foreign_toplevel_handle_v1 * handle
+) {
+    ctx_t * ctx = (ctx_t *)data;
+
+    // allocate toplevel node
+    toplevel_list_node_t * node = malloc(sizeof (toplevel_list_node_t));
+    if (node == NULL) {
+        wlm_log_error("wayland::on_toplevel_list_toplevel(): failed to allocate toplevel node\n");
+        wlm_exit_fail(ctx);
+    }
+
+    // initialize toplevel node
+    node->ctx = ctx;
+    node->handle = handle;
+    node->title = NULL;
+    node->app_id = NULL;
+    node->identifier = NULL;
+
+    // prepend toplevel node to toplevel list
+    node->next = ctx->wl.toplevels;
+    ctx->wl.toplevels = node;
+
+    // add toplevel handle event listener
+    // - for closed event
+    // - for done event
+    // - for title event
+    // - for app_id event
+    // - for identifier event
+    ext_foreign_toplevel_handle_v1_add_listener(node->handle, &toplevel_handle_listener, (void *)node);
+
+    (void)toplevel_list;
+}
+
+static void on_toplevel_list_finished(
+    void * data, struct ext_foreign_toplevel_list_v1 * toplevel_list
+) {
+    ctx_t * ctx = (ctx_t *)data;
+
+    wlm_log_debug(ctx, "wayland::on_toplevel_list_finished(): toplevel list finished\n");
+
+    (void)toplevel_list;
+}
+
+static const struct ext_foreign_toplevel_list_v1_listener toplevel_list_listener = {
+    .toplevel = on_toplevel_list_toplevel,
+    .finished = on_toplevel_list_finished
+};
+
 // --- registry event handlers ---
 
 static void on_registry_add(
@@ -241,6 +412,34 @@ static void on_registry_add(
         ctx->wl.fractional_scale_manager = (struct wp_fractional_scale_manager_v1 *)wl_registry_bind(
             registry, id, &wp_fractional_scale_manager_v1_interface, 1
         );
+    } else if (strcmp(interface, wp_presentation_interface.name) == 0) {
+        if (ctx->wl.presentation != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate wp_presentation\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind wp_presentation object
+        // - for just-in-time capture scheduling
+        ctx->wl.presentation = (struct wp_presentation *)wl_registry_bind(
+            registry, id, &wp_presentation_interface, 1
+        );
+        ctx->wl.presentation_id = id;
+
+        // add presentation event listener
+        // - for clock_id event
+        wp_presentation_add_listener(ctx->wl.presentation, &presentation_listener, (void *)ctx);
+    } else if (strcmp(interface, wp_commit_timing_manager_v1_interface.name) == 0) {
+        if (ctx->wl.commit_timing_manager != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate wp_commit_timing_manager\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind wp_commit_timing_manager_v1 object
+        // - for just-in-time capture scheduling
+        ctx->wl.commit_timing_manager = (struct wp_commit_timing_manager_v1 *)wl_registry_bind(
+            registry, id, &wp_commit_timing_manager_v1_interface, 1
+        );
+        ctx->wl.commit_timing_manager_id = id;
     } else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
         if (ctx->wl.wm_base != NULL) {
             wlm_log_error("wayland::on_registry_add(): duplicate wm_base\n");
@@ -299,6 +498,71 @@ static void on_registry_add(
             registry, id, &wl_shm_interface, 1
         );
         ctx->wl.shm_id = id;
+    } else if (strcmp(interface, zwp_linux_dmabuf_v1_interface.name) == 0) {
+        if (ctx->wl.linux_dmabuf != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate linux_dmabuf\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind linux_dmabuf object
+        // - for dmabuf buffers in mirror-screencopy backend
+        ctx->wl.linux_dmabuf = (struct zwp_linux_dmabuf_v1 *)wl_registry_bind(
+            registry, id, &zwp_linux_dmabuf_v1_interface, 3
+        );
+        ctx->wl.linux_dmabuf_id = id;
+    } else if (strcmp(interface, ext_image_copy_capture_manager_v1_interface.name) == 0) {
+        if (ctx->wl.copy_capture_manager != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate copy_capture_manager\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind copy_capture_manager object
+        // - for mirror-extcopy backend
+        ctx->wl.copy_capture_manager = (struct ext_image_copy_capture_manager_v1 *)wl_registry_bind(
+            registry, id, &ext_image_copy_capture_manager_v1_interface, 1
+        );
+        ctx->wl.copy_capture_manager_id = id;
+    } else if (strcmp(interface, ext_output_image_capture_source_manager_v1_interface.name) == 0) {
+        if (ctx->wl.output_capture_source_manager != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate output_capture_source_manager\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind output_capture_source_manager object
+        // - for mirror-extcopy backend
+        ctx->wl.output_capture_source_manager = (struct ext_output_image_capture_source_manager_v1 *)wl_registry_bind(
+            registry, id, &ext_output_image_capture_source_manager_v1_interface, 1
+        );
+        ctx->wl.output_capture_source_manager_id = id;
+    } else if (strcmp(interface, ext_foreign_toplevel_image_capture_source_manager_v1_interface.name) == 0) {
+        if (ctx->wl.toplevel_capture_source_manager != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate toplevel_capture_source_manager\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind toplevel_capture_source_manager object
+        // - for toplevel capture in mirror-extcopy backend
+        ctx->wl.toplevel_capture_source_manager = (struct ext_foreign_toplevel_image_capture_source_manager_v1 *)wl_registry_bind(
+            registry, id, &ext_foreign_toplevel_image_capture_source_manager_v1_interface, 1
+        );
+        ctx->wl.toplevel_capture_source_manager_id = id;
+    } else if (strcmp(interface, ext_foreign_toplevel_list_v1_interface.name) == 0) {
+        if (ctx->wl.toplevel_list != NULL) {
+            wlm_log_error("wayland::on_registry_add(): duplicate toplevel_list\n");
+            wlm_exit_fail(ctx);
+        }
+
+        // bind toplevel_list object
+        // - for finding toplevels to capture
+        ctx->wl.toplevel_list = (struct ext_foreign_toplevel_list_v1 *)wl_registry_bind(
+            registry, id, &ext_foreign_toplevel_list_v1_interface, 1
+        );
+        ctx->wl.toplevel_list_id = id;
+
+        // add toplevel_list event listener
+        // - for toplevel event
+        // - for finished event
+        ext_foreign_toplevel_list_v1_add_listener(ctx->wl.toplevel_list, &toplevel_list_listener, (void *)ctx);
     } else if (strcmp(interface, wl_output_interface.name) == 0) {
         // allocate output node
         output_list_node_t * node = malloc(sizeof (output_list_node_t));
@@ -848,9 +1112,25 @@ void wlm_wayland_init(ctx_t * ctx) {
     ctx->wl.shm_id = 0;
     ctx->wl.screencopy_manager = NULL;
     ctx->wl.screencopy_manager_id = 0;
+    ctx->wl.linux_dmabuf = NULL;
+    ctx->wl.linux_dmabuf_id = 0;
+    ctx->wl.copy_capture_manager = NULL;
+    ctx->wl.copy_capture_manager_id = 0;
+    ctx->wl.output_capture_source_manager = NULL;
+    ctx->wl.output_capture_source_manager_id = 0;
+    ctx->wl.toplevel_list = NULL;
+    ctx->wl.toplevel_list_id = 0;
+    ctx->wl.toplevel_capture_source_manager = NULL;
+    ctx->wl.toplevel_capture_source_manager_id = 0;
+    ctx->wl.presentation = NULL;
+    ctx->wl.commit_timing_manager = NULL;
+    ctx->wl.presentation_id = 0;
+    ctx->wl.commit_timing_manager_id = 0;
+    ctx->wl.presentation_clock = -1;
 
     ctx->wl.outputs = NULL;
     ctx->wl.seats = NULL;
+    ctx->wl.toplevels = NULL;
 
     ctx->wl.surface = NULL;
     ctx->wl.viewport = NULL;
@@ -871,7 +1151,7 @@ void wlm_wayland_init(ctx_t * ctx) {
     ctx->wl.event_handler.next = NULL;
     ctx->wl.event_handler.fd = -1;
     ctx->wl.event_handler.events = EPOLLIN;
-    ctx->wl.event_handler.timeout_ms = -1;
+    ctx->wl.event_handler.priority = EVENT_PRIORITY_WAYLAND;
     ctx->wl.event_handler.on_event = on_wayland_event;
     ctx->wl.event_handler.on_each = on_wayland_each;
 
@@ -1129,9 +1409,32 @@ void wlm_wayland_cleanup(ctx_t *ctx) {
         ctx->wl.seats = NULL;
     }
 
+    {
+        // free every toplevel in toplevel list
+        toplevel_list_node_t * cur = ctx->wl.toplevels;
+        toplevel_list_node_t * prev = NULL;
+        while (cur != NULL) {
+            prev = cur;
+            cur = cur->next;
+
+            // deallocate toplevel node
+            ext_foreign_toplevel_handle_v1_destroy(prev->handle);
+            free(prev->title);
+            free(prev->app_id);
+            free(prev->identifier);
+            free(prev);
+        }
+        ctx->wl.toplevels = NULL;
+    }
+
     if (ctx->wl.dmabuf_manager != NULL) zwlr_export_dmabuf_manager_v1_destroy(ctx->wl.dmabuf_manager);
     if (ctx->wl.screencopy_manager != NULL) zwlr_screencopy_manager_v1_destroy(ctx->wl.screencopy_manager);
     if (ctx->wl.shm != NULL) wl_shm_destroy(ctx->wl.shm);
+    if (ctx->wl.linux_dmabuf != NULL) zwp_linux_dmabuf_v1_destroy(ctx->wl.linux_dmabuf);
+    if (ctx->wl.copy_capture_manager != NULL) ext_image_copy_capture_manager_v1_destroy(ctx->wl.copy_capture_manager);
+    if (ctx->wl.output_capture_source_manager != NULL) ext_output_image_capture_source_manager_v1_destroy(ctx->wl.output_capture_source_manager);
+    if (ctx->wl.toplevel_capture_source_manager != NULL) ext_foreign_toplevel_image_capture_source_manager_v1_destroy(ctx->wl.toplevel_capture_source_manager);
+    if (ctx->wl.toplevel_list != NULL) ext_foreign_toplevel_list_v1_destroy(ctx->wl.toplevel_list);
 #ifdef WITH_LIBDECOR
     if (ctx->wl.libdecor_frame != NULL) libdecor_frame_unref(ctx->wl.libdecor_frame);
     if (ctx->wl.libdecor_context != NULL) libdecor_unref(ctx->wl.libdecor_context);
@@ -1145,6 +1448,8 @@ void wlm_wayland_cleanup(ctx_t *ctx) {
     if (ctx->wl.output_manager != NULL) zxdg_output_manager_v1_destroy(ctx->wl.output_manager);
     if (ctx->wl.wm_base != NULL) xdg_wm_base_destroy(ctx->wl.wm_base);
     if (ctx->wl.fractional_scale_manager != NULL) wp_fractional_scale_manager_v1_destroy(ctx->wl.fractional_scale_manager);
+    if (ctx->wl.commit_timing_manager != NULL) wp_commit_timing_manager_v1_destroy(ctx->wl.commit_timing_manager);
+    if (ctx->wl.presentation != NULL) wp_presentation_destroy(ctx->wl.presentation);
     if (ctx->wl.viewporter != NULL) wp_viewporter_destroy(ctx->wl.viewporter);
     if (ctx->wl.compositor != NULL) wl_compositor_destroy(ctx->wl.compositor);
     if (ctx->wl.registry != NULL) wl_registry_destroy(ctx->wl.registry);
@@ -0,0 +1,10 @@
+// stand-in for libEGL, lets the frame budget checker be tested without a GPU
+typedef unsigned int EGLBoolean;
+typedef void * EGLDisplay;
+typedef void * EGLSurface;
+
+EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+    (void)display;
+    (void)surface;
+    return 1;
+}
@@ -0,0 +1,34 @@
+// checks that the frame budget checker catches allocations in a frame loop
+// - usage: frame-budget-selftest ALLOCATIONS_PER_FRAME
+// - exits through the preloaded checker, returning normally means it did not work
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef unsigned int EGLBoolean;
+typedef void * EGLDisplay;
+typedef void * EGLSurface;
+
+EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface);
+
+// keeps the compiler from eliding malloc and free pairs
+static void * volatile sink;
+
+int main(int argc, char ** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: frame-budget-selftest ALLOCATIONS_PER_FRAME\n");
+        return 2;
+    }
+
+    int allocations = atoi(argv[1]);
+    for (int frame = 0; frame < 100000; frame++) {
+        for (int i = 0; i < allocations; i++) {
+            sink = malloc(64);
+            free(sink);
+        }
+
+        eglSwapBuffers(NULL, NULL);
+    }
+
+    fprintf(stderr, "frame-budget-selftest: checker did not exit, is it preloaded?\n");
+    return 2;
+}
@@ -0,0 +1,227 @@
+// frame budget checker, preloaded into wl-mirror with LD_PRELOAD
+// - counts allocations made directly by the main executable and calls to
+//   common syscall wrappers from any caller
+// - eglSwapBuffers marks the end of a frame
+// - fails the process as soon as a frame after the warmup exceeds its budget
+//
+// environment:
+// - WLM_BUDGET_MALLOC: allocations allowed per frame (default 0)
+// - WLM_BUDGET_SYSCALLS: syscalls allowed per frame (default 64)
+// - WLM_BUDGET_WARMUP: frames ignored at startup (default 120)
+// - WLM_BUDGET_FRAMES: frames checked before exiting successfully (default 600)
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+typedef unsigned int EGLBoolean;
+typedef void * EGLDisplay;
+typedef void * EGLSurface;
+
+// glibc allocator entry points, dlsym itself may allocate
+extern void * __libc_malloc(size_t size);
+extern void * __libc_calloc(size_t count, size_t size);
+extern void * __libc_realloc(void * ptr, size_t size);
+extern void * __libc_memalign(size_t alignment, size_t size);
+
+static uintptr_t exe_start;
+static uintptr_t exe_end;
+
+static atomic_uint_fast64_t malloc_count;
+static atomic_uint_fast64_t syscall_count;
+
+static uint64_t budget_malloc = 0;
+static uint64_t budget_syscalls = 64;
+static uint64_t warmup_frames = 120;
+static uint64_t check_frames = 600;
+static uint64_t frames;
+
+static EGLBoolean (*real_eglSwapBuffers)(EGLDisplay, EGLSurface);
+static int (*real_ioctl)(int, unsigned long, void *);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_write)(int, const void *, size_t);
+static ssize_t (*real_recvmsg)(int, struct msghdr *, int);
+static ssize_t (*real_sendmsg)(int, const struct msghdr *, int);
+static int (*real_poll)(struct pollfd *, nfds_t, int);
+static int (*real_epoll_wait)(int, struct epoll_event *, int, int);
+static void * (*real_mmap)(void *, size_t, int, int, int, off_t);
+static int (*real_munmap)(void *, size_t);
+static int (*real_close)(int);
+
+// resolved on first use, other libraries may call these before our constructor
+#define RESOLVE(name) if (real_##name == NULL) real_##name = dlsym(RTLD_NEXT, #name)
+
+// --- setup ---
+
+static int find_executable(struct dl_phdr_info * info, size_t size, void * data) {
+    // the main executable is always reported first
+    for (size_t i = 0; i < info->dlpi_phnum; i++) {
+        const ElfW(Phdr) * phdr = &info->dlpi_phdr[i];
+        if (phdr->p_type != PT_LOAD) continue;
+
+        uintptr_t start = info->dlpi_addr + phdr->p_vaddr;
+        uintptr_t end = start + phdr->p_memsz;
+        if (exe_start == 0 || start < exe_start) exe_start = start;
+        if (end > exe_end) exe_end = end;
+    }
+
+    (void)size;
+    (void)data;
+    return 1;
+}
+
+static uint64_t env_uint(const char * name, uint64_t fallback) {
+    const char * value = getenv(name);
+    if (value == NULL || *value == '\0') return fallback;
+    return strtoull(value, NULL, 10);
+}
+
+__attribute__((constructor))
+static void init(void) {
+    dl_iterate_phdr(find_executable, NULL);
+
+    budget_malloc = env_uint("WLM_BUDGET_MALLOC", budget_malloc);
+    budget_syscalls = env_uint("WLM_BUDGET_SYSCALLS", budget_syscalls);
+    warmup_frames = env_uint("WLM_BUDGET_WARMUP", warmup_frames);
+    check_frames = env_uint("WLM_BUDGET_FRAMES", check_frames);
+}
+
+// --- allocations ---
+
+static void count_malloc(void * caller) {
+    uintptr_t address = (uintptr_t)caller;
+    if (address >= exe_start && address < exe_end) {
+        atomic_fetch_add_explicit(&malloc_count, 1, memory_order_relaxed);
+    }
+}
+
+void * malloc(size_t size) {
+    count_malloc(__builtin_return_address(0));
+    return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size) {
+    count_malloc(__builtin_return_address(0));
+    return __libc_calloc(count, size);
+}
+
+void * realloc(void * ptr, size_t size) {
+    count_malloc(__builtin_return_address(0));
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void ** ptr, size_t alignment, size_t size) {
+    count_malloc(__builtin_return_address(0));
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr == NULL ? ENOMEM : 0;
+}
+
+// --- syscalls ---
+
+#define COUNT_SYSCALL() atomic_fetch_add_explicit(&syscall_count, 1, memory_order_relaxed)
+
+int ioctl(int fd, unsigned long request, ...) {
+    va_list args;
+    va_start(args, request);
+    void * arg = va_arg(args, void *);
+    va_end(args);
+
+    RESOLVE(ioctl);
+    COUNT_SYSCALL();
+    return real_ioctl(fd, request, arg);
+}
+
+ssize_t read(int fd, void * buf, size_t count) {
+    RESOLVE(read);
+    COUNT_SYSCALL();
+    return real_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void * buf, size_t count) {
+    RESOLVE(write);
+    COUNT_SYSCALL();
+    return real_write(fd, buf, count);
+}
+
+ssize_t recvmsg(int fd, struct msghdr * msg, int flags) {
+    RESOLVE(recvmsg);
+    COUNT_SYSCALL();
+    return real_recvmsg(fd, msg, flags);
+}
+
+ssize_t sendmsg(int fd, const struct msghdr * msg, int flags) {
+    RESOLVE(sendmsg);
+    COUNT_SYSCALL();
+    return real_sendmsg(fd, msg, flags);
+}
+
+int poll(struct pollfd * fds, nfds_t nfds, int timeout) {
+    RESOLVE(poll);
+    COUNT_SYSCALL();
+    return real_poll(fds, nfds, timeout);
+}
+
+int epoll_wait(int epfd, struct epoll_event * events, int maxevents, int timeout) {
+    RESOLVE(epoll_wait);
+    COUNT_SYSCALL();
+    return real_epoll_wait(epfd, events, maxevents, timeout);
+}
+
+void * mmap(void * addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    RESOLVE(mmap);
+    COUNT_SYSCALL();
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void * addr, size_t length) {
+    RESOLVE(munmap);
+    COUNT_SYSCALL();
+    return real_munmap(addr, length);
+}
+
+int close(int fd) {
+    RESOLVE(close);
+    COUNT_SYSCALL();
+    return real_close(fd);
+}
+
+// --- frame boundary ---
+
+EGLBoolean eglSwapBuffers(EGLDisplay display, EGLSurface surface) {
+    RESOLVE(eglSwapBuffers);
+    EGLBoolean result = real_eglSwapBuffers(display, surface);
+
+    // counts include the swap itself, it is part of the frame
+    uint64_t mallocs = atomic_exchange(&malloc_count, 0);
+    uint64_t syscalls = atomic_exchange(&syscall_count, 0);
+
+    frames++;
+    if (frames <= warmup_frames) return result;
+
+    uint64_t frame = frames - warmup_frames;
+    if (mallocs > budget_malloc || syscalls > budget_syscalls) {
+        fprintf(stderr, "frame-budget: frame %llu exceeded budget: %llu allocations (budget %llu), %llu syscalls (budget %llu)\n",
+            (unsigned long long)frame,
+            (unsigned long long)mallocs, (unsigned long long)budget_malloc,
+            (unsigned long long)syscalls, (unsigned long long)budget_syscalls
+        );
+        _exit(1);
+    }
+
+    if (frame >= check_frames) {
+        fprintf(stderr, "frame-budget: %llu frames within budget\n", (unsigned long long)frame);
+        _exit(0);
+    }
+
+    return result;
+}
@@ -0,0 +1,15 @@
+#!/bin/sh
+# runs wl-mirror with the frame budget checker preloaded
+# - needs a running compositor and WLM_TEST_OUTPUT naming the output to mirror
+# - WLM_TEST_ARGS overrides the options (default --backend dmabuf)
+# - budgets are set with the WLM_BUDGET_* variables, see frame-budget.c
+
+wl_mirror="$1"
+checker="$2"
+
+if [ -z "$WAYLAND_DISPLAY" ] || [ -z "$WLM_TEST_OUTPUT" ]; then
+    echo "frame-budget: skipped, needs WAYLAND_DISPLAY and WLM_TEST_OUTPUT"
+    exit 77
+fi
+
+LD_PRELOAD="$checker" exec "$wl_mirror" ${WLM_TEST_ARGS:---backend dmabuf} "$WLM_TEST_OUTPUT"